@@ -23,6 +23,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -33,6 +35,12 @@ void register_system(void);
 // Register common system functions: "version", "restart", "free", "heap", "tasks"
 void register_system_common(void);
 
+// Prints memory a component manages itself, after the heap figures of "free" (high_water false) and "heap" (true)
+typedef void (*system_mem_report_t)(bool high_water);
+
+// Set the report "free" and "heap" call, replaces an earlier one
+void register_system_mem_report(system_mem_report_t report);
+
 // Register deep and light sleep functions
 void register_system_deep_sleep(void);
 void register_system_light_sleep(void);
@@ -158,6 +158,16 @@ static void register_restart(void)
     ESP_ERROR_CHECK( esp_console_cmd_register(&cmd) );
 }
 
+//-------------------------------------------------------------------------------------------------------------------------
+// memory outside the heap that another component reports through 'free' and 'heap'
+//-------------------------------------------------------------------------------------------------------------------------
+static system_mem_report_t mem_report;
+
+void register_system_mem_report(system_mem_report_t report)
+{
+    mem_report = report;
+}
+
 //-------------------------------------------------------------------------------------------------------------------------
 // 'free' command prints available heap memory
 //-------------------------------------------------------------------------------------------------------------------------
@@ -165,6 +175,9 @@ static void register_restart(void)
 static int free_mem(int argc, char **argv)
 {
     printf("%"PRIu32"\n", esp_get_free_heap_size());
+    if (mem_report != NULL) {
+        mem_report(false);
+    }
     return 0;
 }
 
@@ -185,6 +198,9 @@ static int heap_size(int argc, char **argv)
 {
     uint32_t heap_size = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
     printf("min heap size: %"PRIu32"\n", heap_size);
+    if (mem_report != NULL) {
+        mem_report(true);
+    }
     return 0;
 }
 
@@ -291,7 +307,7 @@ static int log_level(int argc, char **argv)
 static void register_log_level(void)
 {
     log_level_args.tag = arg_str1(NULL, NULL, "<tag|*>", "Log tag to set the level for, or * to set for all tags");
-    log_level_args.level = arg_str1(NULL, NULL, "<none|error|warn|debug|verbose>", "Log level to set. Abbreviated words are accepted.");
+    log_level_args.level = arg_str1(NULL, NULL, "<none|error|warn|info|debug|verbose>", "Log level to set. Abbreviated words are accepted.");
     log_level_args.end = arg_end(2);
 
     const esp_console_cmd_t cmd = {
@@ -25,7 +25,9 @@
 // standard c libraries
 //-------------------------------------------------------------------------------------------------------------------------
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 //-------------------------------------------------------------------------------------------------------------------------
 // esp32 wifi libraries
@@ -37,6 +39,7 @@
 #include "esp_wifi.h"
 #include "esp_netif.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "cmd_wifi.h"
 
 //-------------------------------------------------------------------------------------------------------------------------
@@ -48,58 +51,78 @@
 // freeRTOS libraries
 //-------------------------------------------------------------------------------------------------------------------------
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 
 //-------------------------------------------------------------------------------------------------------------------------
 // cli libraries
 //-------------------------------------------------------------------------------------------------------------------------
 #include "cmd_wifi.h"
+#include "cmd_wifi_ring.h"
+#include "cmd_wifi_pool.h"
+#include "cmd_system.h"
+#include "cmd_wifi_pcap.h"
+#include "cmd_wifi_mac.h"
+#include "cmd_wifi_maclist.h"
+#include "cmd_wifi_bpf.h"
+#include "cmd_wifi_hop.h"
+#include "cmd_wifi_channel.h"
+#include "cmd_wifi_devices.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_aps.h"
+#include "cmd_wifi_record.h"
+#include "cmd_wifi_compact.h"
+#include "cmd_wifi_batch.h"
+#include "cmd_wifi_perf.h"
+#include "cmd_wifi_pipeline.h"
+#include "cmd_wifi_led.h"
+#include "cmd_wifi_survey.h"
+#include "cmd_wifi_detect.h"
+#include "cmd_wifi_eapol.h"
+#include "cmd_wifi_profile.h"
 
 //-------------------------------------------------------------------------------------------------------------------------
-// gpio libraries
+// consumer task, runs below the wifi task so formatting never preempts the driver
 //-------------------------------------------------------------------------------------------------------------------------
-#include "driver/gpio.h"
+#define CONSUMER_TASK_STACK 4096
+#define CONSUMER_TASK_PRIORITY 5
 
 //-------------------------------------------------------------------------------------------------------------------------
-// ESP32 LED PIN
+// start returns to the REPL right away, give it time to print its prompt before the pcap header goes out
 //-------------------------------------------------------------------------------------------------------------------------
-#define LED_PIN 7
+#define PCAP_HEADER_DELAY_MS 50
+#define STOP_TIMEOUT_MS 500
+
+// closing a recording waits on flash
+#define RECORD_STOP_TIMEOUT_MS 5000
+
+// the survey counts frames in the rx callback, the consumer collects them at least this often
+#define SURVEY_COLLECT_MS 1000
 
 //-------------------------------------------------------------------------------------------------------------------------
 // this is supported using esp_wifi_remote
 //-------------------------------------------------------------------------------------------------------------------------
 #if CONFIG_SOC_WIFI_SUPPORTED
 
-//-------------------------------------------------------------------------------------------------------------------------
-//
-// IEEE 802.11 Wifi Structures from ESP32-Sniffer example
-// Source: https://github.com/lpodkalicki/blog/blob/master/esp32/016_wifi_sniffer/main/main.c#L22
-// 
-// I'm not sure if you would consider this an easter egg but this was also included in the Minigotchi!
-// Link: https://github.com/dj1ch/minigotchi/blob/main/minigotchi/structs.h#L141
-//
-//-------------------------------------------------------------------------------------------------------------------------
-typedef struct {
-	unsigned frame_ctrl:16;
-	unsigned duration_id:16;
-	uint8_t addr1[6]; /* receiver address */
-	uint8_t addr2[6]; /* sender address */
-	uint8_t addr3[6]; /* filtering address */
-	unsigned sequence_ctrl:16;
-	uint8_t addr4[6]; /* optional */
-} wifi_ieee80211_mac_hdr_t;
-
-typedef struct {
-	wifi_ieee80211_mac_hdr_t hdr;
-	uint8_t payload[0]; /* network data ended with 4 bytes csum (CRC32) */
-} wifi_ieee80211_packet_t;
-
 //-------------------------------------------------------------------------------------------------------------------------
 // arguments for start command
 //-------------------------------------------------------------------------------------------------------------------------
 static struct {
     struct arg_str *mac;
+    struct arg_str *macfile;
+    struct arg_str *macnvs;
+    struct arg_str *match;
     struct arg_str *type;
+    struct arg_str *ctrl;
+    struct arg_str *format;
+    struct arg_str *filter;
+    struct arg_int *rotatesize;
+    struct arg_int *rotatetime;
+    struct arg_lit *compact;
+    struct arg_int *snaplen;
+    struct arg_int *batch;
+    struct arg_int *flush;
     struct arg_end *end;
 } start_args;
 
@@ -110,15 +133,207 @@ typedef enum {
     MANAGEMENT_PACKET,
     DATA_PACKET,
     MISC_PACKET,
+    CONTROL_PACKET,
     UNKNOWN_PACKET
 } sniffer_packet_type_t;
 
 const char *sniffer_packet_type[] = {
     "management",
     "data",
-    "misc"
+    "misc",
+    "control"
+};
+
+//-------------------------------------------------------------------------------------------------------------------------
+// driver filter masks, indexed like sniffer_packet_type
+//-------------------------------------------------------------------------------------------------------------------------
+static const uint32_t sniffer_packet_mask[] = {
+    WIFI_PROMIS_FILTER_MASK_MGMT,
+    WIFI_PROMIS_FILTER_MASK_DATA,
+    WIFI_PROMIS_FILTER_MASK_MISC,
+    WIFI_PROMIS_FILTER_MASK_CTRL
+};
+
+//-------------------------------------------------------------------------------------------------------------------------
+// control frame subtypes the driver can filter on
+//-------------------------------------------------------------------------------------------------------------------------
+const char *sniffer_ctrl_subtype[] = {
+    "wrapper",
+    "bar",
+    "ba",
+    "pspoll",
+    "rts",
+    "cts",
+    "ack",
+    "cfend",
+    "cfendack"
+};
+
+static const uint32_t sniffer_ctrl_mask[] = {
+    WIFI_PROMIS_CTRL_FILTER_MASK_WRAPPER,
+    WIFI_PROMIS_CTRL_FILTER_MASK_BAR,
+    WIFI_PROMIS_CTRL_FILTER_MASK_BA,
+    WIFI_PROMIS_CTRL_FILTER_MASK_PSPOLL,
+    WIFI_PROMIS_CTRL_FILTER_MASK_RTS,
+    WIFI_PROMIS_CTRL_FILTER_MASK_CTS,
+    WIFI_PROMIS_CTRL_FILTER_MASK_ACK,
+    WIFI_PROMIS_CTRL_FILTER_MASK_CFEND,
+    WIFI_PROMIS_CTRL_FILTER_MASK_CFENDACK
+};
+
+#define CTRL_SUBTYPE_COUNT (int)(sizeof(sniffer_ctrl_subtype) / sizeof(sniffer_ctrl_subtype[0]))
+
+#define MAX_CMDLINE_MACS SNIFFER_CONFIG_MACS
+
+//-------------------------------------------------------------------------------------------------------------------------
+// output formats
+//-------------------------------------------------------------------------------------------------------------------------
+typedef enum {
+    TEXT_OUTPUT,
+    PCAP_OUTPUT,
+    STATS_OUTPUT,
+    RECORD_OUTPUT,
+    COMPACT_OUTPUT,
+    FRAMED_OUTPUT,
+    HC22000_OUTPUT,
+    UNKNOWN_OUTPUT
+} sniffer_output_format_t;
+
+const char *sniffer_output_format[] = {
+    "text",
+    "pcap",
+    "stats",
+    "record",
+    "compact",
+    "framed",
+    "hc22000"
+};
+
+//-------------------------------------------------------------------------------------------------------------------------
+// output formats built in, picked in menuconfig (see Kconfig.projbuild). OUTPUT_IS() is a constant false for a format
+// that was left out, so its branches fold away and its formatting code never reaches the image
+//-------------------------------------------------------------------------------------------------------------------------
+#ifdef CONFIG_SNIFFER_OUTPUT_TEXT
+#define BUILT_TEXT 1
+#else
+#define BUILT_TEXT 0
+#endif
+#ifdef CONFIG_SNIFFER_OUTPUT_STREAM
+#define BUILT_STREAM 1
+#else
+#define BUILT_STREAM 0
+#endif
+#ifdef CONFIG_SNIFFER_OUTPUT_FRAMED
+#define BUILT_FRAMED 1
+#else
+#define BUILT_FRAMED 0
+#endif
+#ifdef CONFIG_SNIFFER_OUTPUT_RECORD
+#define BUILT_RECORD 1
+#else
+#define BUILT_RECORD 0
+#endif
+#ifdef CONFIG_SNIFFER_OUTPUT_HC22000
+#define BUILT_HC22000 1
+#else
+#define BUILT_HC22000 0
+#endif
+#ifdef CONFIG_SNIFFER_TEXT_BRIEF
+#define TEXT_BRIEF 1
+#else
+#define TEXT_BRIEF 0
+#endif
+
+#define OUTPUT_BUILT(format) \
+    ((format) == TEXT_OUTPUT ? BUILT_TEXT : \
+     (format) == PCAP_OUTPUT || (format) == COMPACT_OUTPUT ? BUILT_STREAM : \
+     (format) == FRAMED_OUTPUT ? BUILT_FRAMED : \
+     (format) == RECORD_OUTPUT ? BUILT_RECORD : \
+     (format) == HC22000_OUTPUT ? BUILT_HC22000 : \
+     (format) == STATS_OUTPUT)
+#define OUTPUT_IS(format) (OUTPUT_BUILT(format) && output_format == (format))
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for devices command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_str *sort;
+    struct arg_int *limit;
+    struct arg_lit *clear;
+    struct arg_end *end;
+} devices_args;
+
+const char *devices_sort_key[] = {
+    "frames",
+    "rssi",
+    "last",
+    "first",
+    "mac"
+};
+
+#define DEVICES_DEFAULT_LIMIT 20
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for aps command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_str *sort;
+    struct arg_int *limit;
+    struct arg_lit *clear;
+    struct arg_end *end;
+} aps_args;
+
+const char *aps_sort_key[] = {
+    "rssi",
+    "ssid",
+    "channel",
+    "last"
 };
 
+#define APS_DEFAULT_LIMIT 20
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for survey command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_lit *clear;
+    struct arg_end *end;
+} survey_args;
+
+// heatmap shades, from no frames to the channel's busiest rssi bucket
+static const char survey_shades[] = " .:-=+*#%@";
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for detect command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_int *deauth;
+    struct arg_int *disassoc;
+    struct arg_int *probe;
+    struct arg_lit *clear;
+    struct arg_end *end;
+} detect_args;
+
+#define DETECT_DEFAULT_LIMIT 10
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for profile command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_str *action;
+    struct arg_str *name;
+    struct arg_lit *autostart;
+    struct arg_end *end;
+} profile_args;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for perf command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} perf_args;
+
 //-------------------------------------------------------------------------------------------------------------------------
 // arguments for switchchannel command
 //-------------------------------------------------------------------------------------------------------------------------
@@ -127,286 +342,1678 @@ static struct {
     struct arg_end *end;
 } switchchannel_args;
 
-static char target_mac[18];
-static bool filter;
+static pipeline_filter_t frame_filter = { .match_mask = MATCH_ADDR2 };
+static char filter_expr[SNIFFER_CONFIG_FILTER_LEN];
+
+// settings of the last session that started, what profile save stores
+static sniffer_config_t active_config;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp_timer time of the first capture start and the first frame after boot, 0 until they happen. esp_timer starts
+// with the app, so the bootloader isn't counted.
+//-------------------------------------------------------------------------------------------------------------------------
+static int64_t boot_capture_us;
+static int64_t boot_first_frame_us;
+static volatile bool capturing;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// capture session state
+//-------------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    int64_t started;            /* esp_timer time the session started */
+    int64_t stopped;            /* esp_timer time the session stopped, 0 while running */
+    volatile uint32_t seen;     /* frames the driver handed to the callback */
+    uint32_t output;            /* frames printed or streamed */
+    volatile bool header_pending;
+    volatile bool stream_open;
+    volatile bool draining;     /* stopped, the capture task hasn't finished with the session yet */
+    volatile bool reset_pending; /* start asked the capture task to empty the ring and the frame pool */
+    int64_t batch_deadline;     /* esp_timer time the open batch has to go out by */
+    uint32_t flush_us;          /* how long a batch may stay open */
+    uint32_t alert_seq;         /* last flood detector event printed */
+} sniffer_session_t;
+
+static sniffer_session_t session;
+
+// the capture task updates the device and AP tables while the console reads them
+static SemaphoreHandle_t tables_lock;
+static sniffer_output_format_t output_format = BUILT_TEXT ? TEXT_OUTPUT : STATS_OUTPUT;
+static TaskHandle_t consumer_task;
+
+// the flood detector is updated from the rx callback, so it is guarded with interrupts off rather than a mutex
+static portMUX_TYPE detect_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// one 22000 line, too long for the consumer stack
+static char handshake_line[EAPOL_LINE_MAX];
+
+/**
+ * Generates random number
+ * @param min Minimum number
+ * @param max Maximum number
+ * @return The random number
+ */
+int random_num(int min, int max) { return min + rand() % (max - min + 1); }
+
+/**
+ * Parses a comma separated list of names into a bit mask
+ * @param input List to parse
+ * @param names Known names
+ * @param masks Mask bit for each name
+ * @param count Number of known names
+ * @param mask Where to store the mask
+ * @return False if any name is unknown
+ */
+static bool parse_mask_list(const char *input, const char **names, const uint32_t *masks, int count, uint32_t *mask)
+{
+    *mask = 0;
+    while (*input != '\0') {
+        size_t len = strcspn(input, ",");
+        bool found = false;
+        for (int i = 0; i < count; i++) {
+            if (strlen(names[i]) == len && strncmp(input, names[i], len) == 0) {
+                *mask |= masks[i];
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+
+        input += len;
+        if (*input == ',') {
+            input++;
+        }
+    }
+    return *mask != 0;
+}
+
+/**
+ * Fills a config with what start uses when given no options
+ * @param config Config to fill
+ */
+static void sniffer_config_defaults(sniffer_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->format = BUILT_TEXT ? TEXT_OUTPUT : STATS_OUTPUT;
+    config->match_mask = MATCH_ADDR2;
+    config->ctrl_mask = WIFI_PROMIS_CTRL_FILTER_MASK_ALL;
+    config->snaplen = COMPACT_SNAPLEN_HEADER;
+    config->batch_frames = BATCH_DEFAULT_FRAMES;
+    config->flush_ms = BATCH_DEFAULT_FLUSH_MS;
+}
+
+/**
+ * Copies a string option into a fixed size config field
+ * @param out Field
+ * @param size Size of the field
+ * @param value Option value
+ * @param what Option name for the error message
+ * @return False if it doesn't fit
+ */
+static bool copy_option(char *out, size_t size, const char *value, const char *what)
+{
+    if (strlen(value) >= size) {
+        printf("%s is too long, at most %i characters\n", what, (int)size - 1);
+        return false;
+    }
+    strcpy(out, value);
+    return true;
+}
+
+/**
+ * Turns the start options into a config, checking everything that can be checked without applying it
+ * @param config Config to fill
+ * @return False if an option is invalid, the reason has been printed
+ */
+static bool parse_start_args(sniffer_config_t *config)
+{
+    sniffer_config_defaults(config);
+
+    if (start_args.format->count > 0) {
+        const char *input_format = start_args.format->sval[0];
+        config->format = UNKNOWN_OUTPUT;
+        for (int i = 0; i < UNKNOWN_OUTPUT; i++) {
+            if (strcmp(input_format, sniffer_output_format[i]) == 0) {
+                config->format = i;
+                break;
+            }
+        }
+
+        if (config->format == UNKNOWN_OUTPUT) {
+            printf("Unknown output format: %s\n", input_format);
+            return false;
+        }
+        if (!OUTPUT_BUILT(config->format)) {
+            printf("Output format %s was left out of this build, see menuconfig\n", input_format);
+            return false;
+        }
+    }
+
+    int batch_frames = start_args.batch->count > 0 ? start_args.batch->ival[0] : BATCH_DEFAULT_FRAMES;
+    int flush_ms = start_args.flush->count > 0 ? start_args.flush->ival[0] : BATCH_DEFAULT_FLUSH_MS;
+    if (batch_frames < 1 || batch_frames > UINT16_MAX || flush_ms < 1 || flush_ms > UINT16_MAX) {
+        printf("Batch size and flush interval must be positive\n");
+        return false;
+    }
+    config->batch_frames = batch_frames;
+    config->flush_ms = flush_ms;
+
+    if (start_args.snaplen->count > 0) {
+        if (start_args.snaplen->ival[0] < 0 || start_args.snaplen->ival[0] > SNIFFER_SLOT_PAYLOAD) {
+            printf("Snaplen must be between 0 (mac header only) and %i\n", SNIFFER_SLOT_PAYLOAD);
+            return false;
+        }
+        config->snaplen = start_args.snaplen->ival[0];
+    }
+
+    for (int i = 0; i < start_args.mac->count; i++) {
+        if (!mac_parse(start_args.mac->sval[i], config->macs[i])) {
+            printf("Invalid MAC address: %s\n", start_args.mac->sval[i]);
+            return false;
+        }
+    }
+    config->mac_count = start_args.mac->count;
+
+    if ((start_args.macfile->count > 0 &&
+         !copy_option(config->macfile, sizeof(config->macfile), start_args.macfile->sval[0], "Watchlist path")) ||
+        (start_args.macnvs->count > 0 &&
+         !copy_option(config->macnvs, sizeof(config->macnvs), start_args.macnvs->sval[0], "Watchlist key")) ||
+        (start_args.filter->count > 0 &&
+         !copy_option(config->filter, sizeof(config->filter), start_args.filter->sval[0], "Filter expression"))) {
+        return false;
+    }
+
+    if (start_args.match->count > 0) {
+        const char *input_match = start_args.match->sval[0];
+        config->match_mask = 0;
+        if (strstr(input_match, "addr1") != NULL) {
+            config->match_mask |= MATCH_ADDR1;
+        }
+        if (strstr(input_match, "addr2") != NULL) {
+            config->match_mask |= MATCH_ADDR2;
+        }
+        if (strstr(input_match, "addr3") != NULL) {
+            config->match_mask |= MATCH_ADDR3;
+        }
+        if (strcmp(input_match, "any") == 0) {
+            config->match_mask = MATCH_ADDR1 | MATCH_ADDR2 | MATCH_ADDR3;
+        }
+
+        if (config->match_mask == 0) {
+            printf("Unknown match field: %s\n", input_match);
+            return false;
+        }
+    }
+
+    if (start_args.type->count > 0 &&
+        !parse_mask_list(start_args.type->sval[0], sniffer_packet_type, sniffer_packet_mask, UNKNOWN_PACKET, &config->type_mask)) {
+        printf("Unknown packet type: %s\n", start_args.type->sval[0]);
+        return false;
+    }
+
+    if (start_args.ctrl->count > 0) {
+        if (!parse_mask_list(start_args.ctrl->sval[0], sniffer_ctrl_subtype, sniffer_ctrl_mask, CTRL_SUBTYPE_COUNT, &config->ctrl_mask)) {
+            printf("Unknown control frame subtype: %s\n", start_args.ctrl->sval[0]);
+            return false;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // asking for control subtypes implies asking for control frames
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (config->type_mask != 0) {
+            config->type_mask |= WIFI_PROMIS_FILTER_MASK_CTRL;
+        }
+    }
+
+    if ((start_args.rotatesize->count > 0 && start_args.rotatesize->ival[0] <= 0) ||
+        (start_args.rotatetime->count > 0 && start_args.rotatetime->ival[0] <= 0)) {
+        printf("Rotation limits must be positive\n");
+        return false;
+    }
+    config->rotate_kb = start_args.rotatesize->count > 0 ? start_args.rotatesize->ival[0] : 0;
+    config->rotate_s = start_args.rotatetime->count > 0 ? start_args.rotatetime->ival[0] : 0;
+    config->record_compact = start_args.compact->count > 0;
+    return true;
+}
+
+/**
+ * Has the capture task empty the ring and the frame pool between two drains, the only point where it can't be
+ * holding a slot
+ * @return False if the capture task didn't get to it in time
+ */
+static bool reset_ring(void)
+{
+    session.reset_pending = true;
+    xTaskNotifyGive(consumer_task);
+    for (int waited = 0; session.reset_pending && waited < STOP_TIMEOUT_MS; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return !session.reset_pending;
+}
+
+/**
+ * Starts a capture session
+ * @param config Settings, from the start options or a profile
+ * @return 0 on success, 1 if the session couldn't be started, the reason has been printed
+ */
+static int sniffer_start(const sniffer_config_t *config)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // filters are only ever rebuilt while the callback is unregistered
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (capturing) {
+        printf("Sniffer already running, use stop first\n");
+        return 1;
+    }
+    if (session.draining) {
+        printf("Previous session is still closing, try again\n");
+        return 1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // format first, nothing but the stream may be printed in binary formats
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (config->format >= UNKNOWN_OUTPUT || !OUTPUT_BUILT(config->format)) {
+        printf("Output format %i is unknown or left out of this build\n", config->format);
+        return 1;
+    }
+    sniffer_output_format_t format = (sniffer_output_format_t)config->format;
+
+    if (config->channel != 0) {
+        uint32_t latency;
+        esp_err_t err = ESP_OK;
+        if (hop_active()) {
+            printf("Channel hopping is running, channel %i not applied\n", config->channel);
+        } else if (config->channel != current_channel()) {
+            err = channel_retune(config->channel, &latency);
+        }
+        if (err != ESP_OK) {
+            printf("Failed to set channel %i: %s\n", config->channel, esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // build the watchlist once, the callback only ever does hashed integer lookups
+    //-------------------------------------------------------------------------------------------------------------------------
+    maclist_clear();
+    for (int i = 0; i < config->mac_count; i++) {
+        maclist_add(config->macs[i]);
+    }
+
+    if (config->macfile[0] != '\0' && maclist_load_file(config->macfile) < 0) {
+        return 1;
+    }
+
+    if (config->macnvs[0] != '\0' && maclist_load_nvs(config->macnvs) < 0) {
+        return 1;
+    }
+
+    frame_filter.match_mask = config->match_mask;
+    frame_filter.watchlist = maclist_count() > 0;
+    if (frame_filter.watchlist && format == TEXT_OUTPUT) {
+        printf("Watching %"PRIu32" MAC address(es)\n", maclist_count());
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // compile the filter expression once, the callback runs the bytecode
+    //-------------------------------------------------------------------------------------------------------------------------
+    frame_filter.program.len = 0;
+    if (config->filter[0] != '\0') {
+        char err[64];
+        if (!bpf_compile(config->filter, &frame_filter.program, err, sizeof(err))) {
+            printf("Invalid filter: %s\n", err);
+            return 1;
+        }
+        if (format == TEXT_OUTPUT) {
+            printf("Filter: %s (%i instructions)\n", config->filter, frame_filter.program.len);
+        }
+    }
+    snprintf(filter_expr, sizeof(filter_expr), "%s", config->filter);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // push the type selection down to the driver so unwanted frames never reach the callback
+    //-------------------------------------------------------------------------------------------------------------------------
+    wifi_promiscuous_filter_t type_filter = { .filter_mask = WIFI_PROMIS_FILTER_MASK_ALL };
+    if (config->type_mask != 0) {
+        type_filter.filter_mask = config->type_mask;
+        if (format == TEXT_OUTPUT) {
+            printf("Target Packet Type:");
+            for (int i = 0; i < UNKNOWN_PACKET; i++) {
+                if (config->type_mask & sniffer_packet_mask[i]) {
+                    printf(" %s", sniffer_packet_type[i]);
+                }
+            }
+            printf("\n");
+        }
+    } else if (format == HC22000_OUTPUT) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // handshakes travel in data frames and the ESSID they need in beacons, nothing else is of use
+        //-------------------------------------------------------------------------------------------------------------------------
+        type_filter.filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA;
+    }
+
+    wifi_promiscuous_filter_t ctrl_filter = { .filter_mask = config->ctrl_mask };
+    esp_err_t ret = esp_wifi_set_promiscuous_filter(&type_filter);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_set_promiscuous_ctrl_filter(&ctrl_filter);
+    }
+    if (ret != ESP_OK) {
+        printf("Failed to set promiscuous filter: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+
+    if (format == TEXT_OUTPUT) {
+        printf("Currently on channel %i\n", current_channel());
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // spawn the capture task once, it lives for as long as the firmware does and idles between sessions
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (consumer_task == NULL) {
+        if (xTaskCreate(&sniffer_consumer_task, "sniffer_consumer", CONSUMER_TASK_STACK, NULL, CONSUMER_TASK_PRIORITY, &consumer_task) != pdPASS) {
+            printf("Failed to create consumer task\n");
+            return 1;
+        }
+    }
+
+    if (!reset_ring()) {
+        printf("Capture task is busy, try again\n");
+        return 1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // set cb
+    //-------------------------------------------------------------------------------------------------------------------------
+    perf_reset();
+    output_format = format;
+    session.started = esp_timer_get_time();
+    session.stopped = 0;
+    session.seen = 0;
+    session.output = 0;
+    uint32_t detected;
+    portENTER_CRITICAL(&detect_lock);
+    detect_get_totals(&detected, &session.alert_seq);
+    portEXIT_CRITICAL(&detect_lock);
+    compact_reset_stats();
+    if (OUTPUT_IS(PCAP_OUTPUT) || OUTPUT_IS(COMPACT_OUTPUT)) {
+        compact_begin(config->snaplen);
+        pcap_begin();
+        session.header_pending = true;
+        session.stream_open = true;
+    } else if (OUTPUT_IS(FRAMED_OUTPUT)) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // batches are picked out from between console text, so the REPL and logging stay as they are
+        //-------------------------------------------------------------------------------------------------------------------------
+        batch_begin(config->batch_frames, config->snaplen);
+        session.flush_us = config->flush_ms * 1000;
+        fflush(stdout);
+        console_set_binary(true);
+        session.stream_open = true;
+    } else if (OUTPUT_IS(RECORD_OUTPUT)) {
+        record_config_t record_config = {
+            .rotate_kb = config->rotate_kb,
+            .rotate_s = config->rotate_s,
+            .compact = config->record_compact,
+            .snaplen = config->snaplen
+        };
+
+        esp_err_t err = record_begin(&record_config);
+        if (err != ESP_OK) {
+            printf("Failed to start recording to %s: %s\n", RECORD_DIR, esp_err_to_name(err));
+            return 1;
+        }
+
+        record_stats_t record_stats;
+        record_get_stats(&record_stats);
+        printf("Recording to %s/%s\n", RECORD_DIR, record_stats.current);
+        session.stream_open = true;
+    }
+    capturing = true;
+    led_start();
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    survey_tune(current_channel(), (uint32_t)(esp_timer_get_time() / 1000));
+    if (OUTPUT_IS(HC22000_OUTPUT)) {
+        eapol_clear();
+    }
+    xSemaphoreGive(tables_lock);
+    esp_wifi_set_promiscuous_rx_cb(&sniffer_callback);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // kick the capture task so a pending pcap header goes out even if no frame arrives
+    //-------------------------------------------------------------------------------------------------------------------------
+    xTaskNotifyGive(consumer_task);
+
+    active_config = *config;
+    if (boot_capture_us == 0) {
+        boot_capture_us = session.started;
+    }
+    if (format == TEXT_OUTPUT) {
+        printf("Sniffer started, use stop to end the session\n");
+    }
+    return 0;
+}
+
+/**
+ * Starts the sniffer, initializes configuration
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int sniffer_init(int argc, char **argv)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // parse command arguments
+    //-------------------------------------------------------------------------------------------------------------------------
+    int nerrors = arg_parse(argc, argv, (void **)&start_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, start_args.end, argv[0]);
+        return 1;
+    }
+
+    sniffer_config_t config;
+    if (!parse_start_args(&config)) {
+        return 1;
+    }
+    return sniffer_start(&config);
+}
+
+/**
+ * Stops the sniffer callback, the capture task discards what is left in the ring, closes the stream and clears
+ * session.draining when it is done
+ */
+void stop_sniffer(void)
+{
+    esp_wifi_set_promiscuous_rx_cb(NULL);
+    session.draining = consumer_task != NULL;
+    capturing = false;
+    led_stop();
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    survey_tune(0, (uint32_t)(esp_timer_get_time() / 1000));
+    xSemaphoreGive(tables_lock);
+    session.stopped = esp_timer_get_time();
+
+    if (consumer_task != NULL) {
+        xTaskNotifyGive(consumer_task);
+    }
+}
+
+/**
+ * Prints how much the compact encoder saved, if it ran this session
+ */
+static void compact_print_stats(void)
+{
+    if (!BUILT_STREAM && !BUILT_FRAMED && !BUILT_RECORD) {
+        return;
+    }
+
+    compact_stats_t stats;
+    compact_get_stats(&stats);
+    if (stats.frames == 0) {
+        return;
+    }
+
+    printf("Compact: %.1f bytes/frame for %.1f bytes/frame on air, %"PRIu32" dictionary address(es)\n",
+           (double)stats.bytes_out / stats.frames, (double)stats.bytes_in / stats.frames, stats.dict_entries);
+}
+
+/**
+ * Prints batch counters, if the session was framed
+ */
+static void batch_print_stats(void)
+{
+    if (!OUTPUT_IS(FRAMED_OUTPUT)) {
+        return;
+    }
+
+    batch_stats_t stats;
+    batch_get_stats(&stats);
+    if (stats.batches == 0) {
+        return;
+    }
+
+    printf("Batches: %"PRIu32", %.1f frames/batch, %.1f bytes/frame framed\n",
+           stats.batches, (double)stats.frames / stats.batches, (double)stats.bytes / stats.frames);
+}
+
+/**
+ * Prints handshake counters, if the session was looking for them
+ */
+static void handshake_print_stats(void)
+{
+    if (!OUTPUT_IS(HC22000_OUTPUT)) {
+        return;
+    }
+
+    eapol_stats_t stats;
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    eapol_get_stats(&stats);
+    xSemaphoreGive(tables_lock);
+    printf("EAPOL-Key frames: %"PRIu32", handshakes: %"PRIu32", PMKIDs: %"PRIu32", duplicates: %"PRIu32"\n",
+           stats.keys, stats.handshakes, stats.pmkids, stats.duplicates);
+    printf("Waiting for an ESSID: %"PRIu32", given up: %"PRIu32"\n", stats.pending, stats.dropped);
+}
+
+/**
+ * Stops the current capture session
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Whether or not a session was running
+ */
+int sniffer_stop(int argc, char **argv)
+{
+    if (!capturing) {
+        printf("Sniffer is not running\n");
+        return 1;
+    }
+
+    stop_sniffer();
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // let the capture task finish the frame it is on and close the stream before we print anything, whatever the format
+    //-------------------------------------------------------------------------------------------------------------------------
+    int timeout = OUTPUT_IS(RECORD_OUTPUT) ? RECORD_STOP_TIMEOUT_MS : STOP_TIMEOUT_MS;
+    for (int waited = 0; session.draining && waited < timeout; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    printf("Sniffer stopped after %.1f s, %"PRIu32" frames output\n",
+           (session.stopped - session.started) / 1000000.0, session.output);
+    if (OUTPUT_IS(RECORD_OUTPUT)) {
+        record_print_stats();
+    }
+    compact_print_stats();
+    batch_print_stats();
+    handshake_print_stats();
+    return 0;
+}
+
+/**
+ * Prints the state of the current or last capture session
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int sniffer_status(int argc, char **argv)
+{
+    sniffer_ring_stats_t stats;
+    sniffer_ring_get_stats(&stats);
+
+    int64_t end = capturing ? esp_timer_get_time() : session.stopped;
+    double duration = session.started != 0 ? (end - session.started) / 1000000.0 : 0;
+    uint32_t seen = session.seen;
+
+    printf("State: %s\n", capturing ? "running" : "stopped");
+    printf("Output format: %s\n", sniffer_output_format[output_format]);
+    printf("Duration: %.1f s\n", duration);
+    printf("Channel: %i\n", current_channel());
+    printf("Frames seen: %"PRIu32"\n", seen);
+    printf("Frames filtered: %"PRIu32"\n", seen - stats.pushed - stats.dropped);
+    printf("Frames queued: %"PRIu32"\n", stats.pushed);
+    printf("Frames dropped: %"PRIu32"\n", stats.dropped);
+    printf("Frames output: %"PRIu32"\n", session.output);
+    if (duration > 0) {
+        printf("Rate: %.1f frames/s seen, %.1f frames/s output\n", seen / duration, session.output / duration);
+    }
+    if (boot_first_frame_us != 0) {
+        printf("Boot to capture start: %.1f ms, to first frame: %.1f ms\n", boot_capture_us / 1000.0, boot_first_frame_us / 1000.0);
+    }
+    if (OUTPUT_IS(RECORD_OUTPUT)) {
+        record_print_stats();
+    }
+    compact_print_stats();
+    batch_print_stats();
+    handshake_print_stats();
+
+    return filter_state(0, NULL);
+}
+
+/**
+ * Acquires the type of Wifi packet
+ * @param type Type of packet
+ * @return Specific type of Wifi packet
+ */
+char *get_type(wifi_promiscuous_pkt_type_t type) {
+    switch(type) {
+        case WIFI_PKT_MGMT:
+            return "Management Packet";
+        case WIFI_PKT_CTRL:
+            return "Control Packet";
+        case WIFI_PKT_DATA:
+            return "Data Packet";
+        case WIFI_PKT_MISC:
+            return "Misc Packet";
+        default:
+            return "Unknown Packet";
+    }
+}
+
+/**
+ * Returns current Wifi channel as an integer
+ * @return Current Wifi channel
+ */
+int current_channel() 
+{
+    uint8_t primary;
+    wifi_second_chan_t second;
+    esp_wifi_get_channel(&primary, &second);
+    return primary;
+}
+
+/**
+ * Switch channels
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @return Whether or not the switch was successful
+ */
+int switch_channel(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&switchchannel_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, switchchannel_args.end, argv[0]);
+        return 1;
+    }
+    
+    //-------------------------------------------------------------------------------------------------------------------------
+    // access channel number
+    //-------------------------------------------------------------------------------------------------------------------------
+    int channel = switchchannel_args.channel->ival[0];
+
+    if (hop_active()) {
+        printf("Channel hopping is running, use hop --stop first\n");
+        return 1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // double check
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (channel < 1 || channel > 13) {
+        printf("Invalid channel. Must be between 1 and 13.\n");
+        return 1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // retune in place, the driver allows channel changes while in promiscuous mode
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t latency;
+    esp_err_t ret = channel_retune(channel, &latency);
+    if (ret != ESP_OK) {
+        printf("Failed to set channel: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+
+    printf("Switched to channel %i in %"PRIu32" us\n", current_channel(), latency);
+    return 0;
+}
+
+/**
+ * Prints channel retune latency
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int retune_stats(int argc, char **argv)
+{
+    retune_stats_t stats;
+    channel_retune_get_stats(&stats);
+
+    printf("Retunes: %"PRIu32" (%"PRIu32" failed)\n", stats.count, stats.failed);
+    if (stats.count > 0) {
+        printf("Latency min/median/max: %"PRIu32"/%"PRIu32"/%"PRIu32" us\n", stats.min_us, stats.median_us, stats.max_us);
+        printf("Time spent retuning: %"PRIu64" us\n", stats.total_us);
+    }
+    return 0;
+}
+
+/**
+ * Filters a received frame and copies it into the ring
+ * @param pkt Packet
+ * @param type Type of Packet
+ */
+static void sniffer_handle_frame(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type)
+{
+    const pipeline_frame_t frame = {
+        .payload = pkt->payload,
+        .len = pkt->rx_ctrl.sig_len,
+        .orig_len = pkt->rx_ctrl.sig_len,
+        .channel = pkt->rx_ctrl.channel,
+        .rssi = pkt->rx_ctrl.rssi,
+        .rate = pkt->rx_ctrl.rate
+    };
+    if (!pipeline_filter(&frame_filter, &frame)) {
+        return;
+    }
+    if (frame_filter.watchlist || frame_filter.program.len > 0) {
+        led_note_hit();
+    }
+
+    uint32_t start = perf_now();
+    bool pushed = sniffer_ring_push(pkt, type);
+    perf_record(PERF_STAGE_ENQUEUE, perf_now() - start);
+    if (!pushed) {
+        return;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only wake the consumer when it may have gone to sleep on an empty ring
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (sniffer_ring_count() == 1) {
+        xTaskNotifyGive(consumer_task);
+    }
+}
+
+/**
+ * Sniffer callback, runs in the wifi driver's context so it only copies the frame into the ring
+ * @param buf Packet buffer
+ * @param type Type of Packet
+ */
+void sniffer_callback(void *buf, wifi_promiscuous_pkt_type_t type)
+{
+    uint32_t start = perf_now();
+    wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
+    if (boot_first_frame_us == 0) {
+        boot_first_frame_us = esp_timer_get_time();
+    }
+    session.seen++;
+    perf_note_rx(pkt->rx_ctrl.sig_len);
+    hop_note_frame();
+    led_note_frame();
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the flood detector sees every deauth, disassoc and probe request, whatever the filters
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (detect_wants(pkt->payload, pkt->rx_ctrl.sig_len)) {
+        portENTER_CRITICAL(&detect_lock);
+        bool raised = detect_frame(pkt->payload, pkt->rx_ctrl.sig_len, (uint32_t)(esp_timer_get_time() / 1000));
+        portEXIT_CRITICAL(&detect_lock);
+        if (raised) {
+            led_note_alert();
+            xTaskNotifyGive(consumer_task);
+        }
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // airtime is taken up by every frame on the channel, so the survey counts them before the filters and the ring
+    //-------------------------------------------------------------------------------------------------------------------------
+    survey_add_frame(pkt->rx_ctrl.channel, pkt->rx_ctrl.rssi, pkt->rx_ctrl.rate, pkt->rx_ctrl.sig_len);
+
+    sniffer_handle_frame(pkt, type);
+    perf_record(PERF_STAGE_CALLBACK, perf_now() - start);
+}
+
+/**
+ * Describes a queued frame for the shared pipeline
+ * @param frame Frame taken from the ring
+ * @param out Description to fill
+ */
+static void frame_view(const sniffer_frame_t *frame, pipeline_frame_t *out)
+{
+    out->payload = frame->payload;
+    out->len = frame->len;
+    out->orig_len = frame->orig_len;
+    out->timestamp = frame->rx_ctrl.timestamp;
+    out->channel = frame->rx_ctrl.channel;
+    out->rssi = frame->rx_ctrl.rssi;
+    out->noise = frame->rx_ctrl.noise_floor;
+    out->rate = frame->rx_ctrl.rate;
+}
+
+/**
+ * Formats and prints a captured frame
+ * @param frame Frame taken from the ring
+ */
+static void print_frame(const sniffer_frame_t *frame)
+{
+    pipeline_frame_t view;
+    frame_view(frame, &view);
+    if (TEXT_BRIEF) {
+        pipeline_print_brief(stdout, &view, frame_filter.watchlist);
+    } else {
+        pipeline_print_frame(stdout, &view, get_type(frame->type), frame_filter.watchlist);
+    }
+}
+
+/**
+ * Streams one frame in the compact format
+ * @param frame Frame taken from the ring
+ */
+static void write_compact_frame(const sniffer_frame_t *frame)
+{
+    pipeline_frame_t view;
+    frame_view(frame, &view);
+    compact_meta_t meta;
+    pipeline_compact_meta(&view, &meta);
+
+    uint8_t record[SNIFFER_SLOT_PAYLOAD + COMPACT_OVERHEAD_MAX];
+    fwrite(record, compact_encode_frame(&meta, frame->payload, frame->len, frame->orig_len, record), 1, stdout);
+}
+
+/**
+ * Seals the open batch and writes it to the console
+ */
+static void write_batch(void)
+{
+    const uint8_t *batch;
+    size_t len = batch_seal(&batch);
+    if (len > 0) {
+        fwrite(batch, len, 1, stdout);
+    }
+}
+
+/**
+ * Adds one frame to the open batch, writing the batch once it is full
+ * @param frame Frame taken from the ring
+ */
+static void batch_frame(const sniffer_frame_t *frame)
+{
+    pipeline_frame_t view;
+    frame_view(frame, &view);
+    compact_meta_t meta;
+    pipeline_compact_meta(&view, &meta);
+
+    if (batch_pending() == 0) {
+        session.batch_deadline = esp_timer_get_time() + session.flush_us;
+    }
+    if (batch_add(&meta, frame->payload, frame->len, frame->orig_len)) {
+        write_batch();
+    }
+}
+
+/**
+ * Prints flood detector events raised since the last call. Machine readable output (pcap, compact, framed and 22000
+ * lines) goes straight into other tools, so those sessions only count them and detect lists them.
+ */
+static void print_alerts(void)
+{
+    detect_event_t events[4];
+    size_t n;
+    do {
+        portENTER_CRITICAL(&detect_lock);
+        n = detect_recent(events, sizeof(events) / sizeof(events[0]), session.alert_seq);
+        portEXIT_CRITICAL(&detect_lock);
+
+        for (size_t i = 0; i < n; i++) {
+            session.alert_seq = events[i].seq;
+            if (output_format != TEXT_OUTPUT && output_format != STATS_OUTPUT && output_format != RECORD_OUTPUT) {
+                continue;
+            }
+            char mac[MAC_STR_LEN];
+            mac_format(mac, events[i].mac);
+            printf("Alert: %s flood, %s %s, %u frames/s\n", detect_kind_name[events[i].kind],
+                   detect_role_name[events[i].role], mac, events[i].rate);
+        }
+    } while (n == sizeof(events) / sizeof(events[0]));
+}
+
+/**
+ * Prints the handshakes and PMKIDs that are complete and have an ESSID, one 22000 line each
+ */
+static void print_handshakes(void)
+{
+    while (true) {
+        xSemaphoreTake(tables_lock, portMAX_DELAY);
+        bool ready = eapol_next_line(handshake_line, sizeof(handshake_line));
+        xSemaphoreGive(tables_lock);
+        if (!ready) {
+            return;
+        }
+        printf("%s\n", handshake_line);
+        session.output++;
+    }
+}
+
+/**
+ * Drains the capture ring and does all formatting and output
+ * @param arg Unused
+ */
+void sniffer_consumer_task(void *arg)
+{
+    while (true) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // an open batch goes out after the flush interval even if no more frames arrive
+        //-------------------------------------------------------------------------------------------------------------------------
+        TickType_t wait = portMAX_DELAY;
+        if (OUTPUT_IS(FRAMED_OUTPUT) && batch_pending() > 0) {
+            int64_t remaining = session.batch_deadline - esp_timer_get_time();
+            wait = remaining > 0 ? pdMS_TO_TICKS(remaining / 1000) + 1 : 0;
+        }
+        if (capturing && wait > pdMS_TO_TICKS(SURVEY_COLLECT_MS)) {
+            wait = pdMS_TO_TICKS(SURVEY_COLLECT_MS);
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // the survey's busiest second needs its frames collected about every second, filtered out or not
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (capturing) {
+            xSemaphoreTake(tables_lock, portMAX_DELAY);
+            survey_collect((uint32_t)(esp_timer_get_time() / 1000));
+            xSemaphoreGive(tables_lock);
+        }
+
+        if (session.reset_pending) {
+            sniffer_ring_reset();
+            session.reset_pending = false;
+        }
+
+        if (BUILT_STREAM && session.header_pending) {
+            vTaskDelay(pdMS_TO_TICKS(PCAP_HEADER_DELAY_MS));
+            if (output_format == COMPACT_OUTPUT) {
+                uint8_t header[COMPACT_HEADER_LEN];
+                fwrite(header, compact_write_header(header), 1, stdout);
+                fflush(stdout);
+            } else {
+                pcap_write_global_header();
+            }
+            session.header_pending = false;
+        }
+
+        sniffer_frame_t *frame;
+        while ((frame = sniffer_ring_peek()) != NULL) {
+            //-------------------------------------------------------------------------------------------------------------------------
+            // frames still queued after a stop are discarded
+            //-------------------------------------------------------------------------------------------------------------------------
+            if (capturing) {
+                uint32_t start = perf_now();
+                perf_record(PERF_STAGE_QUEUED, start - frame->queued_at);
+
+                pipeline_frame_t view;
+                frame_view(frame, &view);
+                xSemaphoreTake(tables_lock, portMAX_DELAY);
+                pipeline_consume(&view, (uint32_t)(esp_timer_get_time() / 1000));
+                if (OUTPUT_IS(HC22000_OUTPUT)) {
+                    eapol_update_frame(view.payload, view.len, view.len == view.orig_len, (uint32_t)(esp_timer_get_time() / 1000));
+                }
+                xSemaphoreGive(tables_lock);
+
+                uint32_t consumed = perf_now();
+                perf_record(PERF_STAGE_CONSUME, consumed - start);
+
+                if (OUTPUT_IS(PCAP_OUTPUT)) {
+                    pcap_write_frame(frame);
+                    session.output++;
+                } else if (OUTPUT_IS(RECORD_OUTPUT)) {
+                    record_write_frame(frame);
+                    session.output++;
+                } else if (OUTPUT_IS(COMPACT_OUTPUT)) {
+                    write_compact_frame(frame);
+                    session.output++;
+                } else if (OUTPUT_IS(FRAMED_OUTPUT)) {
+                    batch_frame(frame);
+                    session.output++;
+                } else if (OUTPUT_IS(TEXT_OUTPUT)) {
+                    print_frame(frame);
+                    session.output++;
+                }
+                perf_record(PERF_STAGE_OUTPUT, perf_now() - consumed);
+            }
+            sniffer_ring_pop();
+        }
+
+        if (OUTPUT_IS(FRAMED_OUTPUT) && batch_pending() > 0 &&
+            (!capturing || esp_timer_get_time() >= session.batch_deadline)) {
+            write_batch();
+        }
+
+        if (OUTPUT_IS(HC22000_OUTPUT)) {
+            print_handshakes();
+        }
+        print_alerts();
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // one flush per drained batch rather than per frame
+        //-------------------------------------------------------------------------------------------------------------------------
+        fflush(stdout);
+
+        if (!capturing && session.draining) {
+            if (session.stream_open) {
+                if (OUTPUT_IS(RECORD_OUTPUT)) {
+                    record_end();
+                } else if (OUTPUT_IS(FRAMED_OUTPUT)) {
+                    console_set_binary(false);
+                } else if (BUILT_STREAM) {
+                    pcap_end();
+                }
+                session.stream_open = false;
+            }
+            session.draining = false;
+        }
+    }
+}
+
+/**
+ * Prints capture ring counters
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int ring_stats(int argc, char **argv)
+{
+    sniffer_ring_stats_t stats;
+    sniffer_ring_get_stats(&stats);
+
+    printf("Ring slots: %i (payloads up to %i bytes in the frame pool)\n", SNIFFER_RING_SLOTS, SNIFFER_SLOT_PAYLOAD);
+    printf("Frames queued: %"PRIu32"\n", stats.pushed);
+    printf("Frames dropped: %"PRIu32"\n", stats.dropped);
+    printf("Frames truncated: %"PRIu32"\n", stats.truncated);
+    printf("Slots in use: %"PRIu32"\n", stats.used);
+    printf("High water mark: %"PRIu32"/%i\n", stats.high_water, SNIFFER_RING_SLOTS);
+
+    frame_pool_stats_t pool[FRAME_POOL_CLASSES];
+    frame_pool_get_stats(pool);
+
+    printf("Frame pool: %i blocks, %i bytes\n", FRAME_POOL_BLOCKS, FRAME_POOL_BYTES);
+    printf("%-6s %7s %7s %7s %10s %8s %10s\n", "BLOCK", "BLOCKS", "IN USE", "HIGH", "ALLOCS", "SPILLS", "EXHAUSTED");
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        printf("%-6u %7u %7u %7u %10"PRIu32" %8"PRIu32" %10"PRIu32"\n", pool[i].size, pool[i].blocks, pool[i].in_use,
+               pool[i].high_water, pool[i].allocs, pool[i].spills, pool[i].exhausted);
+    }
+    return 0;
+}
+
+/**
+ * Prints frame pool use after the heap figures of the free and heap commands
+ * @param high_water Print the high water mark rather than the blocks in use now
+ */
+static void print_frame_pool(bool high_water)
+{
+    frame_pool_stats_t pool[FRAME_POOL_CLASSES];
+    frame_pool_get_stats(pool);
+
+    uint32_t blocks = 0;
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        blocks += high_water ? pool[i].high_water : pool[i].in_use;
+    }
+
+    printf("frame pool %s: %"PRIu32"/%i blocks (", high_water ? "high water" : "in use", blocks, FRAME_POOL_BLOCKS);
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        printf("%s%u B: %u/%u", i > 0 ? ", " : "", pool[i].size, high_water ? pool[i].high_water : pool[i].in_use, pool[i].blocks);
+    }
+    printf(")\n");
+}
+
+/**
+ * Moves survey listening time to the new channel
+ * @param channel Channel the radio is on now
+ */
+static void survey_channel_changed(uint8_t channel)
+{
+    if (!capturing) {
+        return;
+    }
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    survey_tune(channel, (uint32_t)(esp_timer_get_time() / 1000));
+    xSemaphoreGive(tables_lock);
+}
+
+/**
+ * Prints estimated airtime utilisation and an rssi heatmap per channel
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int survey_dump(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&survey_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, survey_args.end, argv[0]);
+        return 1;
+    }
+
+    if (survey_args.clear->count > 0) {
+        xSemaphoreTake(tables_lock, portMAX_DELAY);
+        survey_clear();
+        xSemaphoreGive(tables_lock);
+        return 0;
+    }
+
+    printf("Ch  Listen(s)  Frames   Airtime(ms)  Util%%  Peak%%  RSSI %i..%i dBm\n",
+           SURVEY_RSSI_MIN, SURVEY_RSSI_MIN + SURVEY_RSSI_BUCKETS * SURVEY_RSSI_STEP);
+
+    int printed = 0;
+    for (uint8_t channel = 1; channel <= SURVEY_CHANNELS; channel++) {
+        survey_report_t report;
+        xSemaphoreTake(tables_lock, portMAX_DELAY);
+        bool heard = survey_report(channel, (uint32_t)(esp_timer_get_time() / 1000), &report);
+        xSemaphoreGive(tables_lock);
+        if (!heard) {
+            continue;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // each row is scaled to its own busiest bucket, it shows where the signals sit rather than how many there are
+        //-------------------------------------------------------------------------------------------------------------------------
+        uint32_t busiest = 0;
+        for (int i = 0; i < SURVEY_RSSI_BUCKETS; i++) {
+            busiest = report.rssi[i] > busiest ? report.rssi[i] : busiest;
+        }
+        char heatmap[SURVEY_RSSI_BUCKETS + 1];
+        for (int i = 0; i < SURVEY_RSSI_BUCKETS; i++) {
+            int shade = 0;
+            if (report.rssi[i] > 0) {
+                shade = 1 + (int)((uint64_t)report.rssi[i] * (sizeof(survey_shades) - 3) / busiest);
+            }
+            heatmap[i] = survey_shades[shade];
+        }
+        heatmap[SURVEY_RSSI_BUCKETS] = '\0';
+
+        printf("%-3u %-10.1f %-8"PRIu32" %-12.1f %5.1f  %5.1f  |%s|\n", channel, report.listen_ms / 1000.0,
+               report.frames, report.airtime_us / 1000.0, report.utilisation / 10.0, report.peak / 10.0, heatmap);
+        printed++;
+    }
+
+    if (printed == 0) {
+        printf("Nothing surveyed yet, start a capture and hop over the channels of interest\n");
+    }
+    return 0;
+}
+
+/**
+ * Sets flood detector thresholds and prints its state, recent events and the busiest senders
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int detect_dump(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&detect_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, detect_args.end, argv[0]);
+        return 1;
+    }
+
+    const struct arg_int *thresholds[DETECT_KINDS] = { detect_args.deauth, detect_args.disassoc, detect_args.probe };
+    for (int i = 0; i < DETECT_KINDS; i++) {
+        if (thresholds[i]->count > 0 && (thresholds[i]->ival[0] < 0 || thresholds[i]->ival[0] > UINT16_MAX)) {
+            printf("Invalid %s threshold: %i\n", detect_kind_name[i], thresholds[i]->ival[0]);
+            return 1;
+        }
+    }
+
+    detect_entry_t *entries = malloc(DETECT_CAPACITY * sizeof(detect_entry_t));
+    if (entries == NULL) {
+        printf("Failed to allocate buffer for detector table\n");
+        return 1;
+    }
+
+    detect_event_t events[DETECT_LOG];
+    uint16_t limits[DETECT_KINDS];
+    uint32_t frames;
+    uint32_t raised;
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+
+    portENTER_CRITICAL(&detect_lock);
+    if (detect_args.clear->count > 0) {
+        detect_clear();
+        session.alert_seq = 0;
+    }
+    for (int i = 0; i < DETECT_KINDS; i++) {
+        if (thresholds[i]->count > 0) {
+            detect_set_threshold(i, thresholds[i]->ival[0]);
+        }
+        limits[i] = detect_get_threshold(i);
+    }
+    detect_get_totals(&frames, &raised);
+    size_t n_events = detect_recent(events, DETECT_LOG, 0);
+    size_t n = detect_snapshot(entries, DETECT_CAPACITY, now);
+    portEXIT_CRITICAL(&detect_lock);
+
+    detect_sort(entries, n, now);
 
-/**
- * Generates random number
- * @param min Minimum number
- * @param max Maximum number
- * @return The random number
- */
-int random_num(int min, int max) { return min + rand() % (max - min + 1); }
+    printf("Thresholds: deauth %u/s, disassoc %u/s, probe %u/s over %i ms (0 disables)\n",
+           limits[DETECT_DEAUTH], limits[DETECT_DISASSOC], limits[DETECT_PROBE], DETECT_WINDOW_MS);
+    printf("Frames counted: %"PRIu32", events: %"PRIu32"\n", frames, raised);
+
+    for (size_t i = 0; i < n_events; i++) {
+        char mac[MAC_STR_LEN];
+        mac_format(mac, events[i].mac);
+        printf("  %8.1f s  %-8s %-6s %s  %u frames/s\n", events[i].time_ms / 1000.0, detect_kind_name[events[i].kind],
+               detect_role_name[events[i].role], mac, events[i].rate);
+    }
+
+    if (n > 0) {
+        printf("MAC               Role    Deauth/s  Disassoc/s  Probe/s  Alerting\n");
+    }
+    for (size_t i = 0; i < n && i < DETECT_DEFAULT_LIMIT; i++) {
+        const detect_entry_t *e = &entries[i];
+        char mac[MAC_STR_LEN];
+        mac_format(mac, e->mac);
+        printf("%s %-7s %-9.1f %-11.1f %-8.1f %s%s%s\n", mac, detect_role_name[e->role],
+               detect_window_sum(e, DETECT_DEAUTH, now) * 1000.0 / DETECT_WINDOW_MS,
+               detect_window_sum(e, DETECT_DISASSOC, now) * 1000.0 / DETECT_WINDOW_MS,
+               detect_window_sum(e, DETECT_PROBE, now) * 1000.0 / DETECT_WINDOW_MS,
+               e->alerting & (1 << DETECT_DEAUTH) ? "deauth " : "",
+               e->alerting & (1 << DETECT_DISASSOC) ? "disassoc " : "",
+               e->alerting & (1 << DETECT_PROBE) ? "probe" : "");
+    }
+
+    free(entries);
+    return 0;
+}
 
 /**
- * Starts the sniffer, initializes configuration
+ * Prints throughput and per stage latency since the session started or the last reset
  * @param argc Number of arguments
  * @param argv Arguments
  */
-int sniffer_init(int argc, char **argv)
+int perf_dump(int argc, char **argv)
 {
-    //-------------------------------------------------------------------------------------------------------------------------
-    // parse command arguments
-    //-------------------------------------------------------------------------------------------------------------------------
-    int nerrors = arg_parse(argc, argv, (void **)&start_args);
+    int nerrors = arg_parse(argc, argv, (void **)&perf_args);
     if (nerrors != 0) {
-        arg_print_errors(stderr, start_args.end, argv[0]);
+        arg_print_errors(stderr, perf_args.end, argv[0]);
         return 1;
     }
 
-    if (start_args.mac->count > 0) {
-        strncpy(target_mac, start_args.mac->sval[0], sizeof(target_mac) - 1);
-        filter = true;
-        printf("Target MAC: %s\n", target_mac);
+    if (perf_args.reset->count > 0) {
+        perf_reset();
+        printf("Perf counters reset\n");
+        return 0;
     }
 
-    sniffer_packet_type_t packet_type = UNKNOWN_PACKET;
-    if (start_args.type->count >= 1) {
-        const char *input_type = start_args.type->sval[0];
-        for (int i = 0; i < sizeof(sniffer_packet_type); i++) {
-            if (strcmp(input_type, sniffer_packet_type[i]) == 0) {
-                packet_type = (sniffer_packet_type_t)i;
-                printf("Target Packet Type: %s", sniffer_packet_type[i]);
-                break;
-            }
-        }
+    perf_counters_t counters;
+    perf_get_counters(&counters);
+    sniffer_ring_stats_t stats;
+    sniffer_ring_get_stats(&stats);
 
-        if (packet_type == UNKNOWN_PACKET) {
-            printf("Unknown packet type: %s\n", input_type);
-            return 1;
-        }
-    }
-    
-    printf("Currently on channel %i", current_channel());
+    double duration = counters.since != 0 ? (esp_timer_get_time() - counters.since) / 1000000.0 : 0;
+    perf_hist_t output;
+    perf_get_hist(PERF_STAGE_OUTPUT, &output);
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // set cb
-    //-------------------------------------------------------------------------------------------------------------------------
-    esp_wifi_set_promiscuous_rx_cb(&sniffer_callback);
+    printf("Duration: %.1f s\n", duration);
+    if (duration > 0) {
+        printf("Rate: %.1f frames/s received, %.1f frames/s output, %.1f KB/s received\n",
+               counters.rx_frames / duration, output.count / duration, counters.rx_bytes / duration / 1024);
+    }
+    printf("Frames dropped: %"PRIu32"\n", stats.dropped);
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // wait forever
-    //-------------------------------------------------------------------------------------------------------------------------
-    while (true) {
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    printf("%-9s %9s %9s %9s %9s %9s\n", "STAGE", "SAMPLES", "MEAN us", "P50 us", "P99 us", "MAX us");
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) {
+        perf_hist_t hist;
+        perf_get_hist(i, &hist);
+        if (hist.count == 0) {
+            printf("%-9s %9s\n", perf_stage_name[i], "-");
+            continue;
+        }
+        printf("%-9s %9"PRIu32" %9.1f %9.1f %9.1f %9.1f\n", perf_stage_name[i], hist.count,
+               perf_cycles_to_us(hist.total) / hist.count,
+               perf_cycles_to_us(perf_percentile(&hist, 50)),
+               perf_cycles_to_us(perf_percentile(&hist, 99)),
+               perf_cycles_to_us(hist.max));
     }
+    printf("Percentiles are upper bounds of power of two buckets\n");
+    return 0;
 }
 
 /**
- * Stops the sniffer callback
+ * Prints the driver and software filters currently in effect
+ * @param argc Number of arguments
+ * @param argv Arguments
  */
-void stop_sniffer(void)
+int filter_state(int argc, char **argv)
 {
-    esp_wifi_set_promiscuous_rx_cb(NULL);
-}
+    wifi_promiscuous_filter_t type_filter;
+    wifi_promiscuous_filter_t ctrl_filter;
 
-/**
- * Get's the mac based on source address
- * @param addr Address to use
- * @param buff Buffer to use
- * @param offset Data offset
- */
-void get_mac(char *addr, const unsigned char *buff, int offset) {
-    snprintf(addr, 18, "%02x:%02x:%02x:%02x:%02x:%02x", buff[offset],
-             buff[offset + 1], buff[offset + 2], buff[offset + 3],
-             buff[offset + 4], buff[offset + 5]);
-}
+    if (esp_wifi_get_promiscuous_filter(&type_filter) != ESP_OK ||
+        esp_wifi_get_promiscuous_ctrl_filter(&ctrl_filter) != ESP_OK) {
+        printf("Failed to read promiscuous filter\n");
+        return 1;
+    }
 
-/**
- * Extract Mac Address using get_mac()
- * @param buff Buffer to use
- * @return Source Mac Address from buffer
- */
-char *extract_mac(const unsigned char *buff) {
-    static char addr[] = "00:00:00:00:00:00";
-    get_mac(addr, buff, 10);
-    return addr;
+    printf("Driver packet types:");
+    if (type_filter.filter_mask == WIFI_PROMIS_FILTER_MASK_ALL) {
+        printf(" all");
+    } else {
+        for (int i = 0; i < UNKNOWN_PACKET; i++) {
+            if (type_filter.filter_mask & sniffer_packet_mask[i]) {
+                printf(" %s", sniffer_packet_type[i]);
+            }
+        }
+    }
+    printf(" (0x%08"PRIx32")\n", type_filter.filter_mask);
+
+    printf("Driver control subtypes:");
+    if ((ctrl_filter.filter_mask & WIFI_PROMIS_CTRL_FILTER_MASK_ALL) == WIFI_PROMIS_CTRL_FILTER_MASK_ALL) {
+        printf(" all");
+    } else {
+        for (int i = 0; i < CTRL_SUBTYPE_COUNT; i++) {
+            if (ctrl_filter.filter_mask & sniffer_ctrl_mask[i]) {
+                printf(" %s", sniffer_ctrl_subtype[i]);
+            }
+        }
+    }
+    printf(" (0x%08"PRIx32")\n", ctrl_filter.filter_mask);
+
+    printf("Filter expression: %s\n", frame_filter.program.len > 0 ? filter_expr : "none");
+    printf("Watchlist: %"PRIu32" MAC address(es) on%s%s%s\n", maclist_count(),
+           frame_filter.match_mask & MATCH_ADDR1 ? " addr1" : "",
+           frame_filter.match_mask & MATCH_ADDR2 ? " addr2" : "",
+           frame_filter.match_mask & MATCH_ADDR3 ? " addr3" : "");
+    return 0;
 }
 
 /**
- * Acquires the type of Wifi packet
- * @param type Type of packet
- * @return Specific type of Wifi packet
+ * Prints a one line summary of a profile
+ * @param name Profile name
+ * @param autostart Name of the profile started at boot
  */
-char *get_type(wifi_promiscuous_pkt_type_t type) {
-    switch(type) {
-        case WIFI_PKT_MGMT:
-            return "Management Packet";
-        case WIFI_PKT_DATA:
-            return "Data Packet";
-        case WIFI_PKT_MISC:
-            return "Misc Packet";
-        default:
-            return "Unknown Packet";
+static void profile_print(const char *name, const char *autostart)
+{
+    sniffer_config_t config;
+    esp_err_t err = profile_load(name, &config);
+    printf("%-*s ", PROFILE_NAME_LEN, name);
+    if (err != ESP_OK) {
+        printf("unusable: %s\n", err == ESP_ERR_INVALID_VERSION ? "saved by another firmware version" : esp_err_to_name(err));
+        return;
+    }
+
+    printf("%-8s", config.format < UNKNOWN_OUTPUT ? sniffer_output_format[config.format] : "?");
+    if (config.channel != 0) {
+        printf(" channel %-2i", config.channel);
+    } else {
+        printf(" any channel");
+    }
+    if (config.mac_count > 0 || config.macfile[0] != '\0' || config.macnvs[0] != '\0') {
+        printf(" watchlist");
+    }
+    if (config.filter[0] != '\0') {
+        printf(" filter \"%s\"", config.filter);
     }
+    printf("%s\n", strcmp(name, autostart) == 0 ? " (autostart)" : "");
 }
 
 /**
- * Returns current Wifi channel as an integer
- * @return Current Wifi channel
+ * Checks that a profile may start at boot. pcap and compact streams would start before the REPL prints its banner and
+ * prompt, which would then land in the stream, so only formats that live alongside console text may
+ * @param name Profile name, for the message
+ * @param config Profile settings
+ * @return Whether the profile may start at boot, the reason has been printed if not
  */
-int current_channel() 
+static bool profile_boot_safe(const char *name, const sniffer_config_t *config)
 {
-    uint8_t primary;
-    wifi_second_chan_t second;
-    esp_wifi_get_channel(&primary, &second);
-    return primary;
+    if (config->format != PCAP_OUTPUT && config->format != COMPACT_OUTPUT) {
+        return true;
+    }
+    printf("%s streams %s, which can't start at boot as console text would land in the stream, use framed or record\n",
+           name, sniffer_output_format[config->format]);
+    return false;
 }
 
 /**
- * Switch channels
+ * Saves, loads and lists capture profiles
  * @param argc Number of arguments
  * @param argv Arguments
- * @return Whether or not the switch was successful
  */
-int switch_channel(int argc, char **argv)
+int profile_command(int argc, char **argv)
 {
-    int nerrors = arg_parse(argc, argv, (void **)&switchchannel_args);
+    int nerrors = arg_parse(argc, argv, (void **)&profile_args);
     if (nerrors != 0) {
-        arg_print_errors(stderr, switchchannel_args.end, argv[0]);
+        arg_print_errors(stderr, profile_args.end, argv[0]);
         return 1;
     }
-    
-    //-------------------------------------------------------------------------------------------------------------------------
-    // access channel number
-    //-------------------------------------------------------------------------------------------------------------------------
-    int channel = switchchannel_args.channel->ival[0];
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // double check
-    //-------------------------------------------------------------------------------------------------------------------------
-    if (channel < 1 || channel > 13) {
-        printf("Invalid channel. Must be between 1 and 13.\n");
-        return 1;
+    const char *action = profile_args.action->sval[0];
+    const char *name = profile_args.name->count > 0 ? profile_args.name->sval[0] : NULL;
+    char autostart[PROFILE_NAME_LEN + 1];
+    esp_err_t err = ESP_OK;
+
+    if (strcmp(action, "list") == 0) {
+        char (*names)[PROFILE_NAME_LEN + 1] = malloc(PROFILE_MAX * sizeof(*names));
+        if (names == NULL) {
+            printf("Failed to allocate buffer for profile names\n");
+            return 1;
+        }
+        profile_get_autostart(autostart, sizeof(autostart));
+        size_t n = profile_list(names, PROFILE_MAX);
+        for (size_t i = 0; i < n; i++) {
+            profile_print(names[i], autostart);
+        }
+        printf("%zu profile(s)\n", n);
+        free(names);
+        return 0;
     }
 
-    printf("Switching to channel %d\n", channel);
+    if (strcmp(action, "autostart") == 0 && name == NULL) {
+        err = profile_set_autostart(NULL);
+        if (err != ESP_OK) {
+            printf("Failed to clear autostart: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+        printf("Nothing starts at boot\n");
+        return 0;
+    }
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // disable promiscuous mode before switching channel
-    //-------------------------------------------------------------------------------------------------------------------------
-    esp_err_t ret = esp_wifi_set_promiscuous(false);
-    if (ret != ESP_OK) {
-        printf("Failed to disable promiscuous mode: %d\n", ret);
+    if (name == NULL) {
+        printf("%s needs a profile name\n", action);
         return 1;
     }
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // quick delay
-    //-------------------------------------------------------------------------------------------------------------------------
-    vTaskDelay(pdMS_TO_TICKS(100));
-
-    //-------------------------------------------------------------------------------------------------------------------------
-    // set the channel
-    //-------------------------------------------------------------------------------------------------------------------------
-    ret = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
-    if (ret != ESP_OK) {
-        printf("Failed to set channel: %d\n", ret);
+    sniffer_config_t config;
+    if (strcmp(action, "save") == 0) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // the settings of the last start, on the channel the radio is on now unless it is hopping
+        //-------------------------------------------------------------------------------------------------------------------------
+        config = active_config;
+        config.channel = hop_active() ? 0 : current_channel();
+        if (profile_args.autostart->count > 0 && !profile_boot_safe(name, &config)) {
+            return 1;
+        }
+        err = profile_save(name, &config);
+        if (err == ESP_OK && profile_args.autostart->count > 0) {
+            err = profile_set_autostart(name);
+        }
+        if (err == ESP_OK) {
+            printf("Saved ");
+            profile_get_autostart(autostart, sizeof(autostart));
+            profile_print(name, autostart);
+        }
+    } else if (strcmp(action, "load") == 0) {
+        err = profile_load(name, &config);
+        if (err == ESP_OK) {
+            return sniffer_start(&config);
+        }
+    } else if (strcmp(action, "delete") == 0) {
+        err = profile_delete(name);
+        if (err == ESP_OK) {
+            printf("Deleted %s\n", name);
+        }
+    } else if (strcmp(action, "autostart") == 0) {
+        err = profile_load(name, &config);
+        if (err == ESP_OK && !profile_boot_safe(name, &config)) {
+            return 1;
+        }
+        if (err == ESP_OK) {
+            err = profile_set_autostart(name);
+        }
+        if (err == ESP_OK) {
+            printf("%s starts at boot\n", name);
+        }
+    } else {
+        printf("Unknown action: %s\n", action);
         return 1;
     }
 
-    printf("\nSwitched to channel %i\n", current_channel());
+    if (err == ESP_ERR_INVALID_ARG) {
+        printf("Profile names are 1 to %i characters\n", PROFILE_NAME_LEN);
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("No profile named %s\n", name);
+    } else if (err == ESP_ERR_INVALID_VERSION) {
+        printf("Profile %s was saved by another firmware version, save it again\n", name);
+    } else if (err != ESP_OK) {
+        printf("Profile %s failed: %s\n", action, esp_err_to_name(err));
+    }
+    return err == ESP_OK ? 0 : 1;
+}
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // and yet another delay
-    //-------------------------------------------------------------------------------------------------------------------------
-    vTaskDelay(pdMS_TO_TICKS(100));
+/**
+ * Starts the profile marked for autostart, called at boot after register_wifi
+ * @param console_up Whether the FAT partition is mounted and the REPL has set up the console
+ * @return ESP_OK if a session started or there is nothing to start, ESP_ERR_INVALID_STATE if the profile has to wait
+ *         for the console, ESP_FAIL otherwise
+ */
+esp_err_t sniffer_autostart(bool console_up)
+{
+    char name[PROFILE_NAME_LEN + 1];
+    if (profile_get_autostart(name, sizeof(name)) != ESP_OK || name[0] == '\0') {
+        return ESP_OK;
+    }
 
+    sniffer_config_t config;
+    esp_err_t err = profile_load(name, &config);
+    if (err != ESP_OK) {
+        printf("Not starting profile %s: %s\n", name,
+               err == ESP_ERR_INVALID_VERSION ? "saved by another firmware version" : esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    if (!profile_boot_safe(name, &config)) {
+        return ESP_FAIL;
+    }
     //-------------------------------------------------------------------------------------------------------------------------
-    // re-enable promiscuous mode
+    // record needs the partition. creating the REPL sets the console back to CRLF line endings, which would turn every
+    // LF in a framed batch into CR LF, so framed waits until it is done
     //-------------------------------------------------------------------------------------------------------------------------
-    ret = esp_wifi_set_promiscuous(true);
-    if (ret != ESP_OK) {
-        printf("Failed to enable promiscuous mode: %d\n", ret);
-        return 1;
+    if ((config.format == RECORD_OUTPUT || config.format == FRAMED_OUTPUT) && !console_up) {
+        return ESP_ERR_INVALID_STATE;
     }
-
-    return 0;
+    return sniffer_start(&config) == 0 ? ESP_OK : ESP_FAIL;
 }
 
-
 /**
- * Checks whether or not mac we're filtering for matches the current mac address found in the callback
- * @param mac
- * @param current
- * @return Result of whether or not mac addresses match
+ * Prints the transmitters seen so far
+ * @param argc Number of arguments
+ * @param argv Arguments
  */
-bool filter_mac(char *mac, char *current) 
+int devices_dump(int argc, char **argv)
 {
-    return strcmp(mac, current) == 0;
-}
+    int nerrors = arg_parse(argc, argv, (void **)&devices_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, devices_args.end, argv[0]);
+        return 1;
+    }
 
+    if (devices_args.clear->count > 0) {
+        xSemaphoreTake(tables_lock, portMAX_DELAY);
+        devices_clear();
+        xSemaphoreGive(tables_lock);
+        return 0;
+    }
 
-/**
- * Sniffer callback
- * @param buf Packet buffer
- * @param type Type of Packet
- */
-void sniffer_callback(void *buf, wifi_promiscuous_pkt_type_t type)
-{
-    wifi_promiscuous_pkt_t *snifferPacket = (wifi_promiscuous_pkt_t *)buf;
-    int len = snifferPacket->rx_ctrl.sig_len;
+    devices_sort_t sort = DEVICES_SORT_FRAMES;
+    if (devices_args.sort->count > 0) {
+        sort = DEVICES_SORT_UNKNOWN;
+        for (int i = 0; i < DEVICES_SORT_UNKNOWN; i++) {
+            if (strcmp(devices_args.sort->sval[0], devices_sort_key[i]) == 0) {
+                sort = (devices_sort_t)i;
+                break;
+            }
+        }
+
+        if (sort == DEVICES_SORT_UNKNOWN) {
+            printf("Unknown sort key: %s\n", devices_args.sort->sval[0]);
+            return 1;
+        }
+    }
+    int limit = devices_args.limit->count > 0 ? devices_args.limit->ival[0] : DEVICES_DEFAULT_LIMIT;
 
     //-------------------------------------------------------------------------------------------------------------------------
-    // start with LED off
+    // copy the table out so printing doesn't hold up the capture task
     //-------------------------------------------------------------------------------------------------------------------------
-    esp_rom_gpio_pad_select_gpio(LED_PIN);
-    gpio_set_direction(LED_PIN, GPIO_MODE_OUTPUT);
-    gpio_set_level(LED_PIN, 0);
+    device_entry_t *entries = malloc(DEVICES_CAPACITY * sizeof(device_entry_t));
+    if (entries == NULL) {
+        printf("Failed to allocate buffer for device table\n");
+        return 1;
+    }
 
-    char *packet_type = get_type(type);
-    char *mac = extract_mac(buf);
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    uint32_t evicted = devices_evictions();
+    size_t n = devices_snapshot(entries, DEVICES_CAPACITY, sort);
+    xSemaphoreGive(tables_lock);
 
-    if (filter && strcmp(mac, target_mac) != 0) {
-        printf("Packet type: %s\n", packet_type);
-        printf("Packet Length: %i\n", len);
-        printf("Packet Mac Address: %s\n", mac);
-        printf("Current Channel: %i\n", current_channel());
-        printf("\n");
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    printf("%u device(s), %"PRIu32" evicted\n", (unsigned)n, evicted);
+    printf("MAC               Frames  Mgmt    Ctrl    Data    RSSI min/avg/max  Ch  First(s)  Idle(s)\n");
+    for (size_t i = 0; i < n && (int)i < limit; i++) {
+        const device_entry_t *e = &entries[i];
+        char mac[MAC_STR_LEN];
+        mac_format(mac, e->mac);
+        uint32_t total = device_total_frames(e);
+        printf("%s %-7"PRIu32" %-7"PRIu32" %-7"PRIu32" %-7"PRIu32" %4i/%4i/%4i    %-3u %-9"PRIu32" %"PRIu32"\n",
+               mac, total, e->frames[0], e->frames[1], e->frames[2],
+               e->rssi_min, (int)(e->rssi_sum / (int32_t)total), e->rssi_max, e->last_channel,
+               e->first_seen / 1000, (now - e->last_seen) / 1000);
+    }
 
-        return;
+    free(entries);
+    return 0;
+}
+
+/**
+ * Prints the access points heard so far
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+int aps_dump(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&aps_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, aps_args.end, argv[0]);
+        return 1;
     }
 
-    if (filter && strcmp(mac, target_mac) == 0) {
-        //-------------------------------------------------------------------------------------------------------------------------
-        // turn on led once found
-        //-------------------------------------------------------------------------------------------------------------------------
-        gpio_set_level(LED_PIN, 1);
+    if (aps_args.clear->count > 0) {
+        xSemaphoreTake(tables_lock, portMAX_DELAY);
+        aps_clear();
+        xSemaphoreGive(tables_lock);
+        return 0;
+    }
 
-        printf("Filtered Mac (%s) found!\n", target_mac);
-        printf("Packet type: %s\n", packet_type);
-        printf("Packet Length: %i\n", len);
-        printf("Packet Mac Address: %s\n", mac);
-        printf("Current Channel: %i\n", current_channel());
-        printf("\n");
+    aps_sort_t sort = APS_SORT_RSSI;
+    if (aps_args.sort->count > 0) {
+        sort = APS_SORT_UNKNOWN;
+        for (int i = 0; i < APS_SORT_UNKNOWN; i++) {
+            if (strcmp(aps_args.sort->sval[0], aps_sort_key[i]) == 0) {
+                sort = (aps_sort_t)i;
+                break;
+            }
+        }
 
-        //-------------------------------------------------------------------------------------------------------------------------
-        // stop sniffer
-        //-------------------------------------------------------------------------------------------------------------------------
-        printf("Stopping sniffer\n");
-        stop_sniffer();
-        gpio_set_level(LED_PIN, 0);
+        if (sort == APS_SORT_UNKNOWN) {
+            printf("Unknown sort key: %s\n", aps_args.sort->sval[0]);
+            return 1;
+        }
+    }
+    int limit = aps_args.limit->count > 0 ? aps_args.limit->ival[0] : APS_DEFAULT_LIMIT;
 
-        return;
-    } 
-    
-    if (!filter) {
-        //-------------------------------------------------------------------------------------------------------------------------
-        // turn on
-        //-------------------------------------------------------------------------------------------------------------------------
-        gpio_set_level(LED_PIN, 1);
-    
-        printf("Packet type: %s\n", packet_type);
-        printf("Packet Length: %i\n", len);
-        printf("Packet Mac Address: %s\n", mac);
-        printf("Current Channel: %i\n", current_channel());
-        printf("\n");
+    ap_entry_t *entries = malloc(APS_CAPACITY * sizeof(ap_entry_t));
+    if (entries == NULL) {
+        printf("Failed to allocate buffer for AP table\n");
+        return 1;
+    }
 
-        //-------------------------------------------------------------------------------------------------------------------------
-        // turn off
-        //-------------------------------------------------------------------------------------------------------------------------
-        gpio_set_level(LED_PIN, 0);
+    uint32_t frames;
+    uint32_t parses;
+    xSemaphoreTake(tables_lock, portMAX_DELAY);
+    uint32_t evicted = aps_evictions();
+    aps_get_totals(&frames, &parses);
+    size_t n = aps_snapshot(entries, APS_CAPACITY, sort);
+    xSemaphoreGive(tables_lock);
+
+    uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+    printf("%u AP(s), %"PRIu32" evicted, %"PRIu32" beacon/probe response(s), %"PRIu32" parsed\n",
+           (unsigned)n, evicted, frames, parses);
+    printf("BSSID             Ch  RSSI last/max  Beacons  Probes  Security          Idle(s)  SSID\n");
+    for (size_t i = 0; i < n && (int)i < limit; i++) {
+        const ap_entry_t *e = &entries[i];
+        char bssid[MAC_STR_LEN];
+        mac_format(bssid, e->bssid);
+        char security[48];
+        wifi_security_str(e->security, security, sizeof(security));
+        if (e->ht || e->he) {
+            size_t len = strlen(security);
+            snprintf(security + len, sizeof(security) - len, "%s", e->he ? " HE" : " HT");
+        }
+        printf("%s %-3u %4i/%4i      %-8"PRIu32" %-7"PRIu32" %-17s %-8"PRIu32" %s\n",
+               bssid, e->channel, e->rssi_last, e->rssi_max, e->beacons, e->probe_resps, security,
+               (now - e->last_seen) / 1000, e->ssid_len > 0 ? e->ssid : "<hidden>");
     }
+
+    free(entries);
+    return 0;
 }
 
 int get_channel() {
@@ -416,9 +2023,27 @@ int get_channel() {
 
 void register_wifi(void)
 {
-    start_args.mac = arg_str0(NULL, "mac", "<mac_address>", "Start sniffer set to find the specified Mac Address");
-    start_args.type = arg_str0(NULL, "type", "<packet_type>", "Start sniffer set to find the specific Packet Type");
-    start_args.end = arg_end(2);
+    tables_lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(led_init());
+    sniffer_config_defaults(&active_config);
+    channel_set_listener(&survey_channel_changed);
+    register_system_mem_report(&print_frame_pool);
+
+    start_args.mac = arg_strn(NULL, "mac", "<mac_address>", 0, MAX_CMDLINE_MACS, "Mac Address to watch for, can be repeated");
+    start_args.macfile = arg_str0(NULL, "macfile", "<path>", "Load watched Mac Addresses from a file, one per line (e.g. /data/watch.txt)");
+    start_args.macnvs = arg_str0(NULL, "macnvs", "<key>", "Load watched Mac Addresses from a blob in the \"" MACLIST_NVS_NAMESPACE "\" nvs namespace");
+    start_args.match = arg_str0(NULL, "match", "<addr1|addr2|addr3|any>", "Header addresses checked against the watchlist, comma separated (default addr2)");
+    start_args.type = arg_str0(NULL, "type", "<packet_type>", "Packet types the driver delivers, comma separated: management,data,misc,control");
+    start_args.ctrl = arg_str0(NULL, "ctrl", "<subtypes>", "Control frame subtypes the driver delivers, comma separated: wrapper,bar,ba,pspoll,rts,cts,ack,cfend,cfendack");
+    start_args.format = arg_str0(NULL, "format", "<text|pcap|stats|record|compact|framed|hc22000>", "Output format, pcap and compact stream a capture over the console, framed sends crc checked batches between REPL output, stats only updates the device table, record writes files to " RECORD_DIR ", hc22000 prints complete WPA handshakes and PMKIDs for hashcat");
+    start_args.filter = arg_str0(NULL, "filter", "<expr>", "Filter expression, e.g. \"type mgmt and subtype beacon and rssi > -70\"");
+    start_args.rotatesize = arg_int0(NULL, "rotatesize", "<kb>", "With --format record, start a new file after this many KB");
+    start_args.rotatetime = arg_int0(NULL, "rotatetime", "<seconds>", "With --format record, start a new file after this many seconds");
+    start_args.compact = arg_lit0(NULL, "compact", "With --format record, write compact .cmp files instead of pcap");
+    start_args.snaplen = arg_int0(NULL, "snaplen", "<bytes>", "Bytes kept per frame in the compact format, 0 (default) keeps the mac header only");
+    start_args.batch = arg_int0(NULL, "batch", "<frames>", "With --format framed, frames per batch (default 32)");
+    start_args.flush = arg_int0(NULL, "flush", "<ms>", "With --format framed, longest a batch stays open (default 50)");
+    start_args.end = arg_end(14);
 
     switchchannel_args.channel = arg_int0(NULL, "channel", "<channel>", "Switches to specified channel");
     switchchannel_args.end = arg_end(2);
@@ -449,7 +2074,141 @@ void register_wifi(void)
 
     ESP_ERROR_CHECK(esp_console_cmd_register(&start_cmd));
     ESP_ERROR_CHECK(esp_console_cmd_register(&switchchannel_cmd));
+    const esp_console_cmd_t ringstats_cmd = {
+        .command = "ringstats",
+        .help = "Prints capture ring and frame pool usage, drops and high water marks",
+        .hint = NULL,
+        .func = &ring_stats,
+        .argtable = NULL
+    };
+
+    const esp_console_cmd_t filter_cmd = {
+        .command = "filter",
+        .help = "Prints the driver and software filters in effect",
+        .hint = NULL,
+        .func = &filter_state,
+        .argtable = NULL
+    };
+
+    const esp_console_cmd_t stop_cmd = {
+        .command = "stop",
+        .help = "Stops the Wifi Sniffer",
+        .hint = NULL,
+        .func = &sniffer_stop,
+        .argtable = NULL
+    };
+
+    const esp_console_cmd_t status_cmd = {
+        .command = "status",
+        .help = "Prints the state, counters and filters of the capture session",
+        .hint = NULL,
+        .func = &sniffer_status,
+        .argtable = NULL
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&stop_cmd));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&status_cmd));
+    const esp_console_cmd_t retunestats_cmd = {
+        .command = "retunestats",
+        .help = "Prints min, median and max channel retune latency",
+        .hint = NULL,
+        .func = &retune_stats,
+        .argtable = NULL
+    };
+
+    devices_args.sort = arg_str0(NULL, "sort", "<frames|rssi|last|first|mac>", "Sort key (default frames)");
+    devices_args.limit = arg_int0(NULL, "limit", "<n>", "Print at most n devices (default 20)");
+    devices_args.clear = arg_lit0(NULL, "clear", "Forget all devices");
+    devices_args.end = arg_end(3);
+
+    const esp_console_cmd_t devices_cmd = {
+        .command = "devices",
+        .help = "Prints per transmitter frame counts, RSSI and channel",
+        .hint = NULL,
+        .func = &devices_dump,
+        .argtable = &devices_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&devices_cmd));
+
+    aps_args.sort = arg_str0(NULL, "sort", "<rssi|ssid|channel|last>", "Sort key (default rssi)");
+    aps_args.limit = arg_int0(NULL, "limit", "<n>", "Print at most n access points (default 20)");
+    aps_args.clear = arg_lit0(NULL, "clear", "Forget all access points");
+    aps_args.end = arg_end(3);
+
+    const esp_console_cmd_t aps_cmd = {
+        .command = "aps",
+        .help = "Prints the access points heard in beacons and probe responses",
+        .hint = NULL,
+        .func = &aps_dump,
+        .argtable = &aps_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&aps_cmd));
+
+    survey_args.clear = arg_lit0(NULL, "clear", "Forget the survey");
+    survey_args.end = arg_end(1);
+
+    const esp_console_cmd_t survey_cmd = {
+        .command = "survey",
+        .help = "Prints estimated airtime utilisation and an RSSI heatmap per channel",
+        .hint = NULL,
+        .func = &survey_dump,
+        .argtable = &survey_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&survey_cmd));
+
+    detect_args.deauth = arg_int0(NULL, "deauth", "<per_second>", "Deauthentication frames per second that raise an alert (default 10)");
+    detect_args.disassoc = arg_int0(NULL, "disassoc", "<per_second>", "Disassociation frames per second that raise an alert (default 10)");
+    detect_args.probe = arg_int0(NULL, "probe", "<per_second>", "Probe requests per second from one source that raise an alert (default 50)");
+    detect_args.clear = arg_lit0(NULL, "clear", "Forget counters and events");
+    detect_args.end = arg_end(4);
+
+    const esp_console_cmd_t detect_cmd = {
+        .command = "detect",
+        .help = "Sets deauth, disassoc and probe flood thresholds and prints recent alerts",
+        .hint = NULL,
+        .func = &detect_dump,
+        .argtable = &detect_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&detect_cmd));
+
+    profile_args.action = arg_str1(NULL, NULL, "<list|save|load|delete|autostart>", "What to do");
+    profile_args.name = arg_str0(NULL, NULL, "<name>", "Profile name, autostart without one starts nothing at boot");
+    profile_args.autostart = arg_lit0(NULL, "autostart", "With save, also start this profile at boot");
+    profile_args.end = arg_end(3);
+
+    const esp_console_cmd_t profile_cmd = {
+        .command = "profile",
+        .help = "Saves the settings of the last start with the current channel as a named profile in NVS, starts or lists profiles and picks the one started at boot",
+        .hint = NULL,
+        .func = &profile_command,
+        .argtable = &profile_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&profile_cmd));
+
+    perf_args.reset = arg_lit0(NULL, "reset", "Clear the histograms and counters");
+    perf_args.end = arg_end(1);
+
+    const esp_console_cmd_t perf_cmd = {
+        .command = "perf",
+        .help = "Prints frame and byte rates, drops and p50/p99 latency of each capture stage",
+        .hint = NULL,
+        .func = &perf_dump,
+        .argtable = &perf_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&perf_cmd));
     ESP_ERROR_CHECK(esp_console_cmd_register(&currentchannel_cmd));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&retunestats_cmd));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ringstats_cmd));
+    ESP_ERROR_CHECK(esp_console_cmd_register(&filter_cmd));
+
+    register_hop();
+    register_files();
 }
 
 #endif // CONFIG_SOC_WIFI_SUPPORTED
\ No newline at end of file
@@ -32,21 +32,45 @@ int random_num(int min, int max);
 
 // sniffer related
 int sniffer_init(int argc, char **argv);
-void sniffer_stop();
+int sniffer_stop(int argc, char **argv);
+int sniffer_status(int argc, char **argv);
+void stop_sniffer(void);
 
 // functions relating to sniffer callback
-void get_mac(char *addr, const unsigned char *buff, int offset);
-char *extract_mac(const unsigned char *buff);
 char *get_type(wifi_promiscuous_pkt_type_t type);
 
 // channel stuff
 int current_channel();
 int switch_channel(int argc, char **argv);
-bool filter_mac(char *mac, char *current);
+int retune_stats(int argc, char **argv);
 
 // sniffer callback
 void sniffer_callback(void *buf, wifi_promiscuous_pkt_type_t type);
 
+// drains the capture ring
+void sniffer_consumer_task(void *arg);
+int ring_stats(int argc, char **argv);
+int perf_dump(int argc, char **argv);
+
+// per device statistics
+int devices_dump(int argc, char **argv);
+
+// access point inventory
+int aps_dump(int argc, char **argv);
+
+// channel survey
+int survey_dump(int argc, char **argv);
+
+// flood detector
+int detect_dump(int argc, char **argv);
+
+// capture profiles
+int profile_command(int argc, char **argv);
+esp_err_t sniffer_autostart(bool console_up);
+
+// reports filter state
+int filter_state(int argc, char **argv);
+
 // Register WiFi functions
 void register_wifi(void);
 
@@ -0,0 +1,364 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// access point inventory
+//
+// built from beacons and probe responses. a BSSID repeats its beacon around ten times a second with the same
+// elements, so every frame only gets a cheap content hash and the full element parse runs when the hash changes.
+// laid out like the device table, entries are chained from buckets and recycled with CLOCK. nothing here locks,
+// callers serialize access.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_aps.h"
+#include "cmd_wifi_mac.h"
+#include "cmd_wifi_decode.h"
+
+_Static_assert((APS_BUCKETS & (APS_BUCKETS - 1)) == 0, "APS_BUCKETS must be a power of two");
+_Static_assert(APS_CAPACITY < APS_NONE, "APS_CAPACITY must fit in a uint16_t index");
+
+// the TIM element changes on every beacon and is left out of the content hash
+#define WIFI_IE_TIM 5
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static ap_entry_t aps[APS_CAPACITY];
+static uint16_t ap_buckets[APS_BUCKETS];
+static uint32_t ap_entries;
+static uint32_t ap_evicted;
+static uint32_t ap_hand;
+static uint32_t ap_frames;
+static uint32_t ap_parses;
+static bool aps_initialized;
+
+/**
+ * Bucket for a BSSID
+ * @param bssid BSSID
+ * @return Bucket index
+ */
+static inline uint32_t aps_bucket(const uint8_t *bssid)
+{
+    return (uint32_t)((mac_key(bssid) * 0x9e3779b97f4a7c15ULL) >> 32) & (APS_BUCKETS - 1);
+}
+
+/**
+ * Empties the table
+ */
+void aps_clear(void)
+{
+    for (int i = 0; i < APS_BUCKETS; i++) {
+        ap_buckets[i] = APS_NONE;
+    }
+    ap_entries = 0;
+    ap_evicted = 0;
+    ap_hand = 0;
+    ap_frames = 0;
+    ap_parses = 0;
+    aps_initialized = true;
+}
+
+/**
+ * Removes an entry from its bucket chain
+ * @param index Entry to unlink
+ */
+static void aps_unlink(uint16_t index)
+{
+    uint16_t *link = &ap_buckets[aps_bucket(aps[index].bssid)];
+    while (*link != APS_NONE) {
+        if (*link == index) {
+            *link = aps[index].next;
+            return;
+        }
+        link = &aps[*link].next;
+    }
+}
+
+/**
+ * Picks an entry to reuse, giving every recently heard AP a second chance
+ * @return Entry index
+ */
+static uint16_t aps_evict(void)
+{
+    while (aps[ap_hand].referenced) {
+        aps[ap_hand].referenced = 0;
+        ap_hand = (ap_hand + 1) % APS_CAPACITY;
+    }
+
+    uint16_t victim = ap_hand;
+    ap_hand = (ap_hand + 1) % APS_CAPACITY;
+    aps_unlink(victim);
+    ap_evicted++;
+    return victim;
+}
+
+/**
+ * Hashes the capability field and the elements of a beacon or probe response, skipping the timestamp and TIM
+ * @param body Frame body
+ * @param ies First element
+ * @param ies_len Length of the element list
+ * @return FNV-1a hash
+ */
+static uint32_t aps_content_hash(const uint8_t *body, const uint8_t *ies, uint16_t ies_len)
+{
+    uint32_t hash = FNV_OFFSET;
+    for (int i = 8; i < 12; i++) {
+        hash = (hash ^ body[i]) * FNV_PRIME;
+    }
+
+    wifi_ie_iter_t it;
+    uint8_t id;
+    uint8_t len;
+    const uint8_t *data;
+    wifi_ie_begin(&it, ies, ies_len);
+    while (wifi_ie_next(&it, &id, &len, &data)) {
+        if (id == WIFI_IE_TIM) {
+            continue;
+        }
+        hash = (hash ^ id) * FNV_PRIME;
+        hash = (hash ^ len) * FNV_PRIME;
+        for (uint8_t i = 0; i < len; i++) {
+            hash = (hash ^ data[i]) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Refreshes the parsed fields of an entry
+ * @param entry Entry
+ * @param frame Decoded frame
+ * @param channel Channel the frame was received on
+ */
+static void aps_parse(ap_entry_t *entry, const wifi_frame_t *frame, uint8_t channel)
+{
+    wifi_mgmt_info_t info;
+    if (!wifi_parse_mgmt(frame, &info)) {
+        return;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // hidden networks send an empty or zeroed SSID, probe responses may still reveal it so keep what we had
+    //-------------------------------------------------------------------------------------------------------------------------
+    bool hidden = true;
+    for (uint8_t i = 0; i < info.ssid_len; i++) {
+        if (info.ssid[i] != 0) {
+            hidden = false;
+            break;
+        }
+    }
+    if (!hidden) {
+        memcpy(entry->ssid, info.ssid, info.ssid_len);
+        entry->ssid[info.ssid_len] = '\0';
+        entry->ssid_len = info.ssid_len;
+    }
+
+    entry->channel = info.channel != 0 ? info.channel : channel;
+    entry->security = info.security;
+    entry->ht = info.ht_cap != NULL;
+    entry->he = info.he_cap != NULL;
+    entry->beacon_interval = info.beacon_interval;
+    entry->parses++;
+    ap_parses++;
+}
+
+/**
+ * Records a beacon or probe response
+ * @param frame Raw frame
+ * @param len Length of the frame
+ * @param has_fcs Whether the frame still ends with its FCS
+ * @param rssi Signal strength
+ * @param channel Channel the frame was received on
+ * @param now_ms Receive time in milliseconds
+ */
+void aps_update_frame(const uint8_t *frame, uint16_t len, bool has_fcs, int8_t rssi, uint8_t channel, uint32_t now_ms)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // most frames are rejected on the first byte, before any decoding
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (len < 1 || (frame[0] != 0x80 && frame[0] != 0x50)) {
+        return;
+    }
+
+    wifi_frame_t decoded;
+    const uint8_t *ies;
+    uint16_t ies_len;
+    if (!wifi_decode(frame, len, has_fcs, &decoded) || !wifi_mgmt_ies(&decoded, &ies, &ies_len)) {
+        return;
+    }
+
+    if (!aps_initialized) {
+        aps_clear();
+    }
+    ap_frames++;
+
+    const uint8_t *bssid = decoded.addr3;
+    uint32_t bucket = aps_bucket(bssid);
+    uint16_t index = ap_buckets[bucket];
+    while (index != APS_NONE && memcmp(aps[index].bssid, bssid, MAC_LEN) != 0) {
+        index = aps[index].next;
+    }
+
+    ap_entry_t *entry;
+    if (index == APS_NONE) {
+        index = ap_entries < APS_CAPACITY ? ap_entries++ : aps_evict();
+        entry = &aps[index];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->bssid, bssid, MAC_LEN);
+        entry->rssi_max = rssi;
+        entry->first_seen = now_ms;
+        entry->next = ap_buckets[bucket];
+        ap_buckets[bucket] = index;
+    } else {
+        entry = &aps[index];
+    }
+
+    int source = decoded.subtype == WIFI_MGMT_BEACON ? APS_SOURCE_BEACON : APS_SOURCE_PROBE_RESP;
+    if (source == APS_SOURCE_BEACON) {
+        entry->beacons++;
+    } else {
+        entry->probe_resps++;
+    }
+
+    uint32_t hash = aps_content_hash(decoded.body, ies, ies_len);
+    if (entry->parses == 0 || hash != entry->hash[source]) {
+        entry->hash[source] = hash;
+        aps_parse(entry, &decoded, channel);
+    }
+
+    entry->referenced = 1;
+    entry->rssi_last = rssi;
+    if (rssi > entry->rssi_max) {
+        entry->rssi_max = rssi;
+    }
+    entry->last_seen = now_ms;
+}
+
+/**
+ * Looks up an access point by bssid
+ * @param bssid BSSID
+ * @return Entry or NULL if it isn't tracked
+ */
+const ap_entry_t *aps_find(const uint8_t *bssid)
+{
+    if (!aps_initialized) {
+        return NULL;
+    }
+
+    uint16_t index = ap_buckets[aps_bucket(bssid)];
+    while (index != APS_NONE && memcmp(aps[index].bssid, bssid, MAC_LEN) != 0) {
+        index = aps[index].next;
+    }
+    return index != APS_NONE ? &aps[index] : NULL;
+}
+
+/**
+ * Returns the number of tracked access points
+ * @return Number of entries
+ */
+uint32_t aps_count(void)
+{
+    return ap_entries;
+}
+
+/**
+ * Returns how many entries were recycled because the table was full
+ * @return Number of evictions
+ */
+uint32_t aps_evictions(void)
+{
+    return ap_evicted;
+}
+
+/**
+ * Returns how many frames were seen and how many of them were fully parsed
+ * @param frames Beacons and probe responses seen
+ * @param parses Full element parses
+ */
+void aps_get_totals(uint32_t *frames, uint32_t *parses)
+{
+    *frames = ap_frames;
+    *parses = ap_parses;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+// sort comparators, strongest, most recent and lowest channel first
+//-------------------------------------------------------------------------------------------------------------------------
+static int compare_rssi(const void *a, const void *b)
+{
+    int x = ((const ap_entry_t *)a)->rssi_last;
+    int y = ((const ap_entry_t *)b)->rssi_last;
+    return (x < y) - (x > y);
+}
+
+static int compare_ssid(const void *a, const void *b)
+{
+    return strcmp(((const ap_entry_t *)a)->ssid, ((const ap_entry_t *)b)->ssid);
+}
+
+static int compare_channel(const void *a, const void *b)
+{
+    int x = ((const ap_entry_t *)a)->channel;
+    int y = ((const ap_entry_t *)b)->channel;
+    return (x > y) - (x < y);
+}
+
+static int compare_last(const void *a, const void *b)
+{
+    uint32_t x = ((const ap_entry_t *)a)->last_seen;
+    uint32_t y = ((const ap_entry_t *)b)->last_seen;
+    return (x < y) - (x > y);
+}
+
+/**
+ * Copies the table out and sorts the copy
+ * @param out Where to copy the entries
+ * @param max Size of out in entries
+ * @param sort Sort key
+ * @return Number of entries copied
+ */
+size_t aps_snapshot(ap_entry_t *out, size_t max, aps_sort_t sort)
+{
+    static int (*const comparators[])(const void *, const void *) = {
+        compare_rssi,
+        compare_ssid,
+        compare_channel,
+        compare_last
+    };
+
+    size_t n = ap_entries < max ? ap_entries : max;
+    memcpy(out, aps, n * sizeof(ap_entry_t));
+    if (sort < APS_SORT_UNKNOWN) {
+        qsort(out, n, sizeof(ap_entry_t), comparators[sort]);
+    }
+    return n;
+}
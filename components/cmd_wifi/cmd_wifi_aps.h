@@ -0,0 +1,95 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// fixed capacity access point table, bucket count must be a power of two
+//-------------------------------------------------------------------------------------------------------------------------
+#define APS_CAPACITY 128
+#define APS_BUCKETS 128
+#define APS_NONE 0xffff
+#define APS_SSID_LEN 32
+
+// which frame an entry was last parsed from, beacons and probe responses carry different elements
+#define APS_SOURCE_BEACON 0
+#define APS_SOURCE_PROBE_RESP 1
+#define APS_SOURCES 2
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid_len;       /* 0 for hidden networks */
+    uint8_t channel;        /* from the DS parameter set, else the channel it was heard on */
+    char ssid[APS_SSID_LEN + 1];
+    uint8_t security;       /* WIFI_SEC_* */
+    bool ht;
+    bool he;
+    uint8_t referenced;     /* CLOCK bit, set on every hit */
+    int8_t rssi_last;
+    int8_t rssi_max;
+    uint16_t beacon_interval;
+    uint16_t next;          /* next entry in the same bucket */
+    uint32_t hash[APS_SOURCES];  /* content hash of the elements last parsed */
+    uint32_t beacons;
+    uint32_t probe_resps;
+    uint32_t parses;        /* full element parses, only when the content hash changes */
+    uint32_t first_seen;    /* ms */
+    uint32_t last_seen;     /* ms */
+} ap_entry_t;
+
+typedef enum {
+    APS_SORT_RSSI,
+    APS_SORT_SSID,
+    APS_SORT_CHANNEL,
+    APS_SORT_LAST,
+    APS_SORT_UNKNOWN
+} aps_sort_t;
+
+void aps_clear(void);
+
+// records a beacon or probe response, anything else is ignored
+void aps_update_frame(const uint8_t *frame, uint16_t len, bool has_fcs, int8_t rssi, uint8_t channel, uint32_t now_ms);
+
+uint32_t aps_count(void);
+uint32_t aps_evictions(void);
+
+// looks up an access point, the entry stays valid until the next update or clear
+const ap_entry_t *aps_find(const uint8_t *bssid);
+
+// frames seen and full parses done, the difference is what deduplication saved
+void aps_get_totals(uint32_t *frames, uint32_t *parses);
+
+// copies the table out and sorts it, returns the number of entries copied
+size_t aps_snapshot(ap_entry_t *out, size_t max, aps_sort_t sort);
+
+#ifdef __cplusplus
+}
+#endif
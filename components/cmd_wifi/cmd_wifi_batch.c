@@ -0,0 +1,190 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// batches compact records into length prefixed, crc checked frames so the console carries one write per batch
+// instead of one per frame, and host tools can pick batches out from between REPL output. no esp-idf dependencies,
+// the caller decides when to seal and where the bytes go.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_batch.h"
+
+// ieee 802.3 polynomial, reflected, one nibble at a time to keep the table small
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+// the longest mac header (data with addr4, QoS and HT control) is 36 bytes
+#define BATCH_HEADER_ONLY_BOUND 36
+
+static uint8_t batch_buf[BATCH_MAX_LEN];
+static uint16_t batch_len;          /* payload bytes */
+static uint16_t batch_count;
+static uint16_t batch_max_frames;
+static uint16_t batch_snaplen;
+static uint16_t batch_seq;
+static batch_stats_t batch_stats;
+
+/**
+ * Updates a crc32, start with 0
+ * @param crc Running crc
+ * @param data Bytes to add
+ * @param len Number of bytes
+ * @return Updated crc
+ */
+uint32_t batch_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+        crc = (crc >> 4) ^ crc_nibble[crc & 0xf];
+    }
+    return ~crc;
+}
+
+/**
+ * Largest record a frame can encode to
+ * @param len Bytes available in the frame
+ * @return Upper bound of the record length
+ */
+static inline uint16_t batch_bound(uint16_t len)
+{
+    uint16_t incl = batch_snaplen > 0 ? batch_snaplen : BATCH_HEADER_ONLY_BOUND;
+    return (len < incl ? len : incl) + COMPACT_OVERHEAD_MAX;
+}
+
+/**
+ * Starts a new stream
+ * @param max_frames Records per batch
+ * @param snaplen Passed on to the compact encoder
+ */
+void batch_begin(uint16_t max_frames, uint16_t snaplen)
+{
+    batch_len = 0;
+    batch_count = 0;
+    batch_max_frames = max_frames > 0 ? max_frames : 1;
+    batch_snaplen = snaplen;
+    batch_seq = 0;
+    memset(&batch_stats, 0, sizeof(batch_stats));
+    compact_begin(snaplen);
+}
+
+/**
+ * Adds a frame to the open batch
+ * @param meta Receive metadata
+ * @param frame Raw frame
+ * @param len Bytes available in frame
+ * @param orig_len Length of the frame on air
+ * @return True once the batch is full, the caller seals it before adding more. the frame is only dropped if
+ *         the caller kept adding to a full batch
+ */
+bool batch_add(const compact_meta_t *meta, const uint8_t *frame, uint16_t len, uint16_t orig_len)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // callers seal on true so there is always room, this only guards against one that didn't
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (batch_len + batch_bound(len) > BATCH_MAX_PAYLOAD) {
+        return true;
+    }
+
+    batch_len += compact_encode_frame(meta, frame, len, orig_len, &batch_buf[BATCH_HEADER_LEN + batch_len]);
+    batch_count++;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // full by count, or no room left for a worst case record
+    //-------------------------------------------------------------------------------------------------------------------------
+    return batch_count >= batch_max_frames || batch_len + batch_bound(UINT16_MAX) > BATCH_MAX_PAYLOAD;
+}
+
+/**
+ * Returns how many records wait in the open batch
+ * @return Record count
+ */
+uint16_t batch_pending(void)
+{
+    return batch_count;
+}
+
+/**
+ * Seals the open batch with its header and crc and starts the next one
+ * @param out Where to store a pointer to the sealed batch, valid until the next batch_add()
+ * @return Length of the sealed batch, 0 if there was nothing to seal
+ */
+size_t batch_seal(const uint8_t **out)
+{
+    if (batch_count == 0) {
+        return 0;
+    }
+
+    uint8_t *h = batch_buf;
+    h[0] = BATCH_SYNC0;
+    h[1] = BATCH_SYNC1;
+    h[2] = BATCH_VERSION;
+    h[3] = BATCH_PAYLOAD_COMPACT;
+    h[4] = batch_seq & 0xff;
+    h[5] = batch_seq >> 8;
+    h[6] = batch_count & 0xff;
+    h[7] = batch_count >> 8;
+    h[8] = batch_len & 0xff;
+    h[9] = batch_len >> 8;
+
+    size_t len = BATCH_HEADER_LEN + batch_len;
+    uint32_t crc = batch_crc32(0, batch_buf, len);
+    for (int i = 0; i < 4; i++) {
+        batch_buf[len++] = (uint8_t)(crc >> (8 * i));
+    }
+
+    batch_stats.batches++;
+    batch_stats.frames += batch_count;
+    batch_stats.bytes += len;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // every batch decodes on its own, a corrupted one doesn't take the dictionary of the next down with it
+    //-------------------------------------------------------------------------------------------------------------------------
+    batch_seq++;
+    batch_len = 0;
+    batch_count = 0;
+    compact_begin(batch_snaplen);
+
+    *out = batch_buf;
+    return len;
+}
+
+/**
+ * Copies the batch counters
+ * @param stats Where to copy them
+ */
+void batch_get_stats(batch_stats_t *stats)
+{
+    *stats = batch_stats;
+}
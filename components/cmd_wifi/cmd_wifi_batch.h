@@ -0,0 +1,82 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmd_wifi_compact.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// framed batches for the console, tools/serial_frames.py decodes them
+//
+// header:  0xa5 0x5a, version, payload type, seq (u16 le), record count (u16 le), payload length (u16 le)
+// payload: records, for BATCH_PAYLOAD_COMPACT compact records with a dictionary that starts empty in every batch
+// trailer: crc32 (ieee, as zlib.crc32) of header and payload, u32 le
+//
+// anything between batches is console text, so the host can resync on the sync bytes and the crc.
+//-------------------------------------------------------------------------------------------------------------------------
+#define BATCH_SYNC0 0xa5
+#define BATCH_SYNC1 0x5a
+#define BATCH_VERSION 1
+#define BATCH_PAYLOAD_COMPACT 1
+
+#define BATCH_HEADER_LEN 10
+#define BATCH_TRAILER_LEN 4
+#define BATCH_MAX_PAYLOAD 4096
+#define BATCH_MAX_LEN (BATCH_HEADER_LEN + BATCH_MAX_PAYLOAD + BATCH_TRAILER_LEN)
+
+#define BATCH_DEFAULT_FRAMES 32
+#define BATCH_DEFAULT_FLUSH_MS 50
+
+typedef struct {
+    uint32_t batches;
+    uint32_t frames;
+    uint64_t bytes;         /* framed bytes including headers and crcs */
+} batch_stats_t;
+
+// starts a new stream, a batch is sealed once it holds max_frames records
+void batch_begin(uint16_t max_frames, uint16_t snaplen);
+
+// adds a frame, returns true when the batch is full and should be sealed
+bool batch_add(const compact_meta_t *meta, const uint8_t *frame, uint16_t len, uint16_t orig_len);
+
+// number of records waiting in the open batch
+uint16_t batch_pending(void);
+
+// seals the open batch, returns its length and where it is, 0 if it was empty
+size_t batch_seal(const uint8_t **out);
+
+void batch_get_stats(batch_stats_t *stats);
+
+// crc32 as used in the trailer
+uint32_t batch_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,661 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// small filter language compiled once into postfix bytecode and run against every frame in the rx callback
+//
+//   expr      := term { ("or" | "||") term }
+//   term      := factor { ("and" | "&&") factor }
+//   factor    := ("not" | "!") factor | "(" expr ")" | predicate
+//   predicate := "type" [cmp] (mgmt | ctrl | data | number)
+//              | "subtype" [cmp] (name | number)
+//              | ("rssi" | "channel" | "rate" | "len") cmp number
+//              | ("addr1" | "addr2" | "addr3" | "addr") [cmp] mac
+//              | "tods" | "fromds" | "retry" | "protected"
+//   cmp       := "==" | "=" | "!=" | "<" | "<=" | ">" | ">="
+//
+// a test on a field the frame doesn't carry is false whatever the cmp, cts and ack have no addr2 and no control frame
+// has an addr3
+//
+// e.g. "type mgmt and subtype beacon and rssi > -70 and addr2 == aa:bb:cc:dd:ee:ff"
+//
+// this file has no esp-idf dependencies so it can be built and exercised on a host
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_bpf.h"
+#include "cmd_wifi_mac.h"
+#include "cmd_wifi_decode.h"
+
+#define BPF_MAX_TOKEN 24
+#define BPF_MAX_NESTING 8
+
+//-------------------------------------------------------------------------------------------------------------------------
+// named values
+//-------------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    const char *name;
+    int value;
+} bpf_name_t;
+
+static const bpf_name_t bpf_types[] = {
+    { "mgmt", 0 },
+    { "management", 0 },
+    { "ctrl", 1 },
+    { "control", 1 },
+    { "data", 2 },
+};
+
+// type << 4 | subtype
+static const bpf_name_t bpf_subtypes[] = {
+    { "assocreq", 0x00 },
+    { "assocresp", 0x01 },
+    { "reassocreq", 0x02 },
+    { "reassocresp", 0x03 },
+    { "probereq", 0x04 },
+    { "proberesp", 0x05 },
+    { "beacon", 0x08 },
+    { "atim", 0x09 },
+    { "disassoc", 0x0a },
+    { "auth", 0x0b },
+    { "deauth", 0x0c },
+    { "action", 0x0d },
+    { "bar", 0x18 },
+    { "ba", 0x19 },
+    { "pspoll", 0x1a },
+    { "rts", 0x1b },
+    { "cts", 0x1c },
+    { "ack", 0x1d },
+    { "cfend", 0x1e },
+    { "qosdata", 0x28 },
+    { "null", 0x24 },
+    { "qosnull", 0x2c },
+};
+
+typedef struct {
+    const char *name;
+    bpf_field_t field;
+} bpf_field_name_t;
+
+static const bpf_field_name_t bpf_numeric_fields[] = {
+    { "rssi", BPF_FIELD_RSSI },
+    { "channel", BPF_FIELD_CHANNEL },
+    { "rate", BPF_FIELD_RATE },
+    { "len", BPF_FIELD_LEN },
+};
+
+static const bpf_field_name_t bpf_addr_fields[] = {
+    { "addr1", BPF_FIELD_ADDR1 },
+    { "addr2", BPF_FIELD_ADDR2 },
+    { "addr3", BPF_FIELD_ADDR3 },
+    { "addr", BPF_FIELD_ADDR },
+};
+
+static const bpf_field_name_t bpf_flag_fields[] = {
+    { "tods", BPF_FIELD_TODS },
+    { "fromds", BPF_FIELD_FROMDS },
+    { "retry", BPF_FIELD_RETRY },
+    { "protected", BPF_FIELD_PROTECTED },
+};
+
+#define BPF_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+//-------------------------------------------------------------------------------------------------------------------------
+// compiler state
+//-------------------------------------------------------------------------------------------------------------------------
+typedef struct {
+    const char *pos;
+    char token[BPF_MAX_TOKEN];
+    bpf_program_t *prog;
+    int depth;
+    int nesting;
+    char *err;
+    size_t err_len;
+    bool failed;
+} bpf_parser_t;
+
+static void bpf_parse_expr(bpf_parser_t *p);
+static void bpf_parse_factor_inner(bpf_parser_t *p);
+
+/**
+ * Records the first compile error
+ * @param p Parser
+ * @param msg Message
+ */
+static void bpf_fail(bpf_parser_t *p, const char *msg)
+{
+    if (!p->failed) {
+        snprintf(p->err, p->err_len, "%s near '%s'", msg, p->token[0] ? p->token : "end of filter");
+        p->failed = true;
+    }
+}
+
+/**
+ * Reads the next token into p->token, an empty token marks the end of the input
+ * @param p Parser
+ */
+static void bpf_next(bpf_parser_t *p)
+{
+    while (isspace((unsigned char)*p->pos)) {
+        p->pos++;
+    }
+
+    size_t n = 0;
+    const char *s = p->pos;
+    if (*s == '\0') {
+        n = 0;
+    } else if (*s == '(' || *s == ')') {
+        n = 1;
+    } else if (strchr("=!<>&|", *s) != NULL) {
+        n = 1;
+        if (s[1] == '=' || (s[0] == '&' && s[1] == '&') || (s[0] == '|' && s[1] == '|')) {
+            n = 2;
+        }
+    } else {
+        while (s[n] != '\0' && (isalnum((unsigned char)s[n]) || s[n] == ':' || s[n] == '-' || s[n] == '_')) {
+            n++;
+        }
+        if (n == 0) {
+            n = 1;
+        }
+    }
+
+    if (n >= BPF_MAX_TOKEN) {
+        n = BPF_MAX_TOKEN - 1;
+    }
+    memcpy(p->token, s, n);
+    p->token[n] = '\0';
+    p->pos = s + n;
+}
+
+/**
+ * Checks the current token against a keyword and its symbolic alias
+ * @param p Parser
+ * @param word Keyword
+ * @param symbol Alias, or NULL
+ * @return Whether it matched
+ */
+static bool bpf_is(const bpf_parser_t *p, const char *word, const char *symbol)
+{
+    return strcmp(p->token, word) == 0 || (symbol != NULL && strcmp(p->token, symbol) == 0);
+}
+
+/**
+ * Appends an instruction and tracks the evaluation stack depth
+ * @param p Parser
+ * @param op Opcode
+ * @param field Field tested
+ * @param cmp Comparison
+ * @param imm Immediate
+ */
+static void bpf_emit(bpf_parser_t *p, bpf_op_t op, bpf_field_t field, bpf_cmp_t cmp, int64_t imm)
+{
+    if (p->failed) {
+        return;
+    }
+    if (p->prog->len >= BPF_MAX_INSNS) {
+        bpf_fail(p, "filter too long");
+        return;
+    }
+
+    if (op == BPF_OP_TEST) {
+        if (++p->depth > BPF_MAX_STACK) {
+            bpf_fail(p, "filter nested too deeply");
+            return;
+        }
+    } else if (op == BPF_OP_AND || op == BPF_OP_OR) {
+        p->depth--;
+    }
+
+    bpf_insn_t *insn = &p->prog->insns[p->prog->len++];
+    insn->op = op;
+    insn->field = field;
+    insn->cmp = cmp;
+    insn->imm = imm;
+}
+
+/**
+ * Parses an optional comparison operator, defaulting to ==
+ * @param p Parser
+ * @param cmp Where to store the comparison
+ * @return Whether an operator was consumed
+ */
+static bool bpf_parse_cmp(bpf_parser_t *p, bpf_cmp_t *cmp)
+{
+    static const struct { const char *str; bpf_cmp_t cmp; } ops[] = {
+        { "==", BPF_CMP_EQ }, { "=", BPF_CMP_EQ }, { "!=", BPF_CMP_NE },
+        { "<", BPF_CMP_LT }, { "<=", BPF_CMP_LE }, { ">", BPF_CMP_GT }, { ">=", BPF_CMP_GE },
+    };
+
+    for (size_t i = 0; i < BPF_ARRAY_SIZE(ops); i++) {
+        if (strcmp(p->token, ops[i].str) == 0) {
+            *cmp = ops[i].cmp;
+            bpf_next(p);
+            return true;
+        }
+    }
+
+    *cmp = BPF_CMP_EQ;
+    return false;
+}
+
+/**
+ * Parses a decimal or 0x prefixed number
+ * @param p Parser
+ * @param value Where to store the number
+ * @return Whether the token was a number
+ */
+static bool bpf_parse_number(bpf_parser_t *p, int64_t *value)
+{
+    char *end;
+    long v = strtol(p->token, &end, 0);
+    if (p->token[0] == '\0' || *end != '\0') {
+        return false;
+    }
+    *value = v;
+    bpf_next(p);
+    return true;
+}
+
+/**
+ * Looks the current token up in a name table
+ * @param p Parser
+ * @param names Table
+ * @param count Number of entries
+ * @param value Where to store the value
+ * @return Whether the name was found
+ */
+static bool bpf_parse_name(bpf_parser_t *p, const bpf_name_t *names, size_t count, int64_t *value)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(p->token, names[i].name) == 0) {
+            *value = names[i].value;
+            bpf_next(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Parses a single predicate
+ * @param p Parser
+ */
+static void bpf_parse_predicate(bpf_parser_t *p)
+{
+    bpf_cmp_t cmp;
+    int64_t value;
+
+    if (bpf_is(p, "type", NULL)) {
+        bpf_next(p);
+        bpf_parse_cmp(p, &cmp);
+        if (!bpf_parse_name(p, bpf_types, BPF_ARRAY_SIZE(bpf_types), &value) && !bpf_parse_number(p, &value)) {
+            bpf_fail(p, "expected frame type");
+            return;
+        }
+        bpf_emit(p, BPF_OP_TEST, BPF_FIELD_TYPE, cmp, value);
+        return;
+    }
+
+    if (bpf_is(p, "subtype", NULL)) {
+        bpf_next(p);
+        bpf_parse_cmp(p, &cmp);
+        if (bpf_parse_name(p, bpf_subtypes, BPF_ARRAY_SIZE(bpf_subtypes), &value)) {
+            bpf_emit(p, BPF_OP_TEST, BPF_FIELD_TYPESUB, cmp, value);
+        } else if (bpf_parse_number(p, &value)) {
+            bpf_emit(p, BPF_OP_TEST, BPF_FIELD_SUBTYPE, cmp, value);
+        } else {
+            bpf_fail(p, "expected frame subtype");
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < BPF_ARRAY_SIZE(bpf_numeric_fields); i++) {
+        if (bpf_is(p, bpf_numeric_fields[i].name, NULL)) {
+            bpf_next(p);
+            if (!bpf_parse_cmp(p, &cmp)) {
+                bpf_fail(p, "expected comparison");
+                return;
+            }
+            if (!bpf_parse_number(p, &value)) {
+                bpf_fail(p, "expected number");
+                return;
+            }
+            bpf_emit(p, BPF_OP_TEST, bpf_numeric_fields[i].field, cmp, value);
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < BPF_ARRAY_SIZE(bpf_addr_fields); i++) {
+        if (bpf_is(p, bpf_addr_fields[i].name, NULL)) {
+            bpf_next(p);
+            bpf_parse_cmp(p, &cmp);
+            uint8_t mac[MAC_LEN];
+            if (cmp != BPF_CMP_EQ && cmp != BPF_CMP_NE) {
+                bpf_fail(p, "addresses only support == and !=");
+                return;
+            }
+            if (!mac_parse(p->token, mac)) {
+                bpf_fail(p, "expected mac address");
+                return;
+            }
+            bpf_next(p);
+            bpf_emit(p, BPF_OP_TEST, bpf_addr_fields[i].field, cmp, (int64_t)mac_key(mac));
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < BPF_ARRAY_SIZE(bpf_flag_fields); i++) {
+        if (bpf_is(p, bpf_flag_fields[i].name, NULL)) {
+            bpf_next(p);
+            bpf_emit(p, BPF_OP_TEST, bpf_flag_fields[i].field, BPF_CMP_NE, 0);
+            return;
+        }
+    }
+
+    bpf_fail(p, "unknown field");
+}
+
+/**
+ * Parses a negation, a parenthesised expression or a predicate
+ * @param p Parser
+ */
+static void bpf_parse_factor(bpf_parser_t *p)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // bound the recursion, this runs on the console task's stack
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (++p->nesting > BPF_MAX_NESTING) {
+        bpf_fail(p, "filter nested too deeply");
+        return;
+    }
+
+    bpf_parse_factor_inner(p);
+    p->nesting--;
+}
+
+/**
+ * Parses a negation, a parenthesised expression or a predicate without the nesting check
+ * @param p Parser
+ */
+static void bpf_parse_factor_inner(bpf_parser_t *p)
+{
+    if (bpf_is(p, "not", "!")) {
+        bpf_next(p);
+        bpf_parse_factor(p);
+        bpf_emit(p, BPF_OP_NOT, 0, 0, 0);
+        return;
+    }
+
+    if (bpf_is(p, "(", NULL)) {
+        bpf_next(p);
+        bpf_parse_expr(p);
+        if (!bpf_is(p, ")", NULL)) {
+            bpf_fail(p, "expected ')'");
+            return;
+        }
+        bpf_next(p);
+        return;
+    }
+
+    bpf_parse_predicate(p);
+}
+
+/**
+ * Parses a chain of factors joined by and
+ * @param p Parser
+ */
+static void bpf_parse_term(bpf_parser_t *p)
+{
+    bpf_parse_factor(p);
+    while (!p->failed && bpf_is(p, "and", "&&")) {
+        bpf_next(p);
+        bpf_parse_factor(p);
+        bpf_emit(p, BPF_OP_AND, 0, 0, 0);
+    }
+}
+
+/**
+ * Parses a chain of terms joined by or
+ * @param p Parser
+ */
+static void bpf_parse_expr(bpf_parser_t *p)
+{
+    bpf_parse_term(p);
+    while (!p->failed && bpf_is(p, "or", "||")) {
+        bpf_next(p);
+        bpf_parse_term(p);
+        bpf_emit(p, BPF_OP_OR, 0, 0, 0);
+    }
+}
+
+/**
+ * Compiles a filter expression
+ * @param expr Expression
+ * @param prog Where to store the program
+ * @param err Buffer for an error message
+ * @param err_len Size of the error buffer
+ * @return Whether the expression compiled
+ */
+bool bpf_compile(const char *expr, bpf_program_t *prog, char *err, size_t err_len)
+{
+    bpf_parser_t p = {
+        .pos = expr,
+        .prog = prog,
+        .depth = 0,
+        .nesting = 0,
+        .err = err,
+        .err_len = err_len,
+        .failed = false
+    };
+
+    prog->len = 0;
+    bpf_next(&p);
+    if (p.token[0] == '\0') {
+        return true;
+    }
+
+    bpf_parse_expr(&p);
+    if (!p.failed && p.token[0] != '\0') {
+        bpf_fail(&p, "unexpected token");
+    }
+
+    if (p.failed) {
+        prog->len = 0;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads a field out of the frame
+ * @param field Field to read
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @param meta Driver metadata
+ * @param value Where to store the value
+ * @return False if the frame doesn't carry the field or is too short for it
+ */
+static inline bool bpf_load(bpf_field_t field, const uint8_t *frame, uint16_t len, const bpf_meta_t *meta, int64_t *value)
+{
+    uint8_t fc0 = len > 0 ? frame[0] : 0;
+    uint8_t fc1 = len > 1 ? frame[1] : 0;
+
+    switch (field) {
+        case BPF_FIELD_TYPE:
+            *value = (fc0 >> 2) & 0x3;
+            return len >= 2;
+        case BPF_FIELD_SUBTYPE:
+            *value = fc0 >> 4;
+            return len >= 2;
+        case BPF_FIELD_TYPESUB:
+            *value = ((fc0 >> 2) & 0x3) << 4 | fc0 >> 4;
+            return len >= 2;
+        case BPF_FIELD_TODS:
+            *value = fc1 & 0x01;
+            return len >= 2;
+        case BPF_FIELD_FROMDS:
+            *value = fc1 & 0x02;
+            return len >= 2;
+        case BPF_FIELD_RETRY:
+            *value = fc1 & 0x08;
+            return len >= 2;
+        case BPF_FIELD_PROTECTED:
+            *value = fc1 & 0x40;
+            return len >= 2;
+        case BPF_FIELD_RSSI:
+            *value = meta->rssi;
+            return true;
+        case BPF_FIELD_CHANNEL:
+            *value = meta->channel;
+            return true;
+        case BPF_FIELD_RATE:
+            *value = meta->rate;
+            return true;
+        case BPF_FIELD_LEN:
+            *value = meta->len;
+            return true;
+        case BPF_FIELD_ADDR1:
+            if (wifi_addr_count(frame, len) < 1) {
+                return false;
+            }
+            *value = (int64_t)mac_key(&frame[MAC_ADDR1_OFFSET]);
+            return true;
+        case BPF_FIELD_ADDR2:
+            if (wifi_addr_count(frame, len) < 2) {
+                return false;
+            }
+            *value = (int64_t)mac_key(&frame[MAC_ADDR2_OFFSET]);
+            return true;
+        case BPF_FIELD_ADDR3:
+            if (wifi_addr_count(frame, len) < 3) {
+                return false;
+            }
+            *value = (int64_t)mac_key(&frame[MAC_ADDR3_OFFSET]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Applies a comparison
+ * @param cmp Comparison
+ * @param a Left hand side
+ * @param b Right hand side
+ * @return Result
+ */
+static inline bool bpf_compare(bpf_cmp_t cmp, int64_t a, int64_t b)
+{
+    switch (cmp) {
+        case BPF_CMP_EQ: return a == b;
+        case BPF_CMP_NE: return a != b;
+        case BPF_CMP_LT: return a < b;
+        case BPF_CMP_LE: return a <= b;
+        case BPF_CMP_GT: return a > b;
+        case BPF_CMP_GE: return a >= b;
+        default: return false;
+    }
+}
+
+/**
+ * Evaluates one test instruction
+ * @param insn Instruction
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @param meta Driver metadata
+ * @return Result, tests on fields the frame doesn't carry are false
+ */
+static inline bool bpf_test(const bpf_insn_t *insn, const uint8_t *frame, uint16_t len, const bpf_meta_t *meta)
+{
+    int64_t value;
+
+    if (insn->field == BPF_FIELD_ADDR) {
+        bool any = false;
+        for (bpf_field_t f = BPF_FIELD_ADDR1; f <= BPF_FIELD_ADDR3; f++) {
+            if (bpf_load(f, frame, len, meta, &value) && value == insn->imm) {
+                any = true;
+                break;
+            }
+        }
+        return insn->cmp == BPF_CMP_EQ ? any : !any;
+    }
+
+    if (!bpf_load(insn->field, frame, len, meta, &value)) {
+        return false;
+    }
+    return bpf_compare(insn->cmp, value, insn->imm);
+}
+
+/**
+ * Runs a compiled program against a frame
+ * @param prog Program
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @param meta Driver metadata
+ * @return Whether the frame passes the filter
+ */
+bool bpf_run(const bpf_program_t *prog, const uint8_t *frame, uint16_t len, const bpf_meta_t *meta)
+{
+    if (prog->len == 0) {
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the compiler guarantees the stack never under or overflows
+    //-------------------------------------------------------------------------------------------------------------------------
+    bool stack[BPF_MAX_STACK];
+    int sp = 0;
+
+    for (int pc = 0; pc < prog->len; pc++) {
+        const bpf_insn_t *insn = &prog->insns[pc];
+        switch (insn->op) {
+            case BPF_OP_TEST:
+                stack[sp++] = bpf_test(insn, frame, len, meta);
+                break;
+            case BPF_OP_AND:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] && stack[sp];
+                break;
+            case BPF_OP_OR:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] || stack[sp];
+                break;
+            case BPF_OP_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+        }
+    }
+
+    return stack[0];
+}
@@ -0,0 +1,102 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// compiled filter programs, see cmd_wifi_bpf.c for the expression syntax
+//-------------------------------------------------------------------------------------------------------------------------
+#define BPF_MAX_INSNS 32
+#define BPF_MAX_STACK 16
+
+typedef enum {
+    BPF_OP_TEST,    /* push (field cmp imm) */
+    BPF_OP_AND,     /* pop two, push both */
+    BPF_OP_OR,      /* pop two, push either */
+    BPF_OP_NOT      /* invert top */
+} bpf_op_t;
+
+typedef enum {
+    BPF_FIELD_TYPE,
+    BPF_FIELD_SUBTYPE,
+    BPF_FIELD_TYPESUB,  /* type << 4 | subtype, used for named subtypes */
+    BPF_FIELD_TODS,
+    BPF_FIELD_FROMDS,
+    BPF_FIELD_RETRY,
+    BPF_FIELD_PROTECTED,
+    BPF_FIELD_RSSI,
+    BPF_FIELD_CHANNEL,
+    BPF_FIELD_RATE,
+    BPF_FIELD_LEN,
+    BPF_FIELD_ADDR1,
+    BPF_FIELD_ADDR2,
+    BPF_FIELD_ADDR3,
+    BPF_FIELD_ADDR     /* any of addr1, addr2, addr3 */
+} bpf_field_t;
+
+typedef enum {
+    BPF_CMP_EQ,
+    BPF_CMP_NE,
+    BPF_CMP_LT,
+    BPF_CMP_LE,
+    BPF_CMP_GT,
+    BPF_CMP_GE
+} bpf_cmp_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t field;
+    uint8_t cmp;
+    int64_t imm;        /* number, or a packed mac address */
+} bpf_insn_t;
+
+typedef struct {
+    uint8_t len;
+    bpf_insn_t insns[BPF_MAX_INSNS];
+} bpf_program_t;
+
+// per frame metadata the driver hands us next to the raw frame
+typedef struct {
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t rate;
+    uint16_t len;
+} bpf_meta_t;
+
+// compiles an expression, on failure a message is written to err
+bool bpf_compile(const char *expr, bpf_program_t *prog, char *err, size_t err_len);
+
+// runs a program against a raw 802.11 frame, an empty program accepts everything
+bool bpf_run(const bpf_program_t *prog, const uint8_t *frame, uint16_t len, const bpf_meta_t *meta);
+
+#ifdef __cplusplus
+}
+#endif
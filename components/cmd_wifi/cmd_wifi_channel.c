@@ -0,0 +1,161 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// fast channel retune
+//
+// esp_wifi_set_channel works while promiscuous mode is on and only returns once the PHY is on the new
+// channel, so there is nothing to gain from turning promiscuous mode off and sleeping around it
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 wifi libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// freeRTOS libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "freertos/FreeRTOS.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_channel.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// retunes come from both the console and the hop task
+//-------------------------------------------------------------------------------------------------------------------------
+static portMUX_TYPE retune_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t retune_samples[RETUNE_SAMPLES];
+static uint32_t retune_count;
+static uint32_t retune_failed;
+static uint32_t retune_min;
+static uint32_t retune_max;
+static uint64_t retune_total;
+static channel_listener_t retune_listener;
+
+/**
+ * Switches channel while staying in monitor mode
+ * @param channel Channel to switch to
+ * @param latency_us Where to store how long the switch took, may be NULL
+ * @return ESP_OK on success
+ */
+esp_err_t channel_retune(uint8_t channel, uint32_t *latency_us)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - start);
+
+    if (latency_us != NULL) {
+        *latency_us = latency;
+    }
+
+    portENTER_CRITICAL(&retune_lock);
+    if (err != ESP_OK) {
+        retune_failed++;
+    } else {
+        retune_samples[retune_count % RETUNE_SAMPLES] = latency;
+        if (retune_count == 0 || latency < retune_min) {
+            retune_min = latency;
+        }
+        if (latency > retune_max) {
+            retune_max = latency;
+        }
+        retune_total += latency;
+        retune_count++;
+    }
+    portEXIT_CRITICAL(&retune_lock);
+
+    if (err == ESP_OK && retune_listener != NULL) {
+        retune_listener(channel);
+    }
+
+    return err;
+}
+
+/**
+ * Sets the function told about every channel change
+ * @param listener Listener, NULL for none
+ */
+void channel_set_listener(channel_listener_t listener)
+{
+    retune_listener = listener;
+}
+
+/**
+ * Sorts latencies for the median
+ */
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Takes a snapshot of the retune latency counters, the median covers the last RETUNE_SAMPLES retunes
+ * @param stats Where to store the counters
+ */
+void channel_retune_get_stats(retune_stats_t *stats)
+{
+    uint32_t samples[RETUNE_SAMPLES];
+
+    portENTER_CRITICAL(&retune_lock);
+    stats->count = retune_count;
+    stats->failed = retune_failed;
+    stats->min_us = retune_min;
+    stats->max_us = retune_max;
+    stats->total_us = retune_total;
+    memcpy(samples, retune_samples, sizeof(samples));
+    portEXIT_CRITICAL(&retune_lock);
+
+    uint32_t n = stats->count < RETUNE_SAMPLES ? stats->count : RETUNE_SAMPLES;
+    stats->median_us = 0;
+    if (n > 0) {
+        qsort(samples, n, sizeof(samples[0]), &compare_u32);
+        stats->median_us = samples[n / 2];
+    }
+}
+
+/**
+ * Clears the retune latency counters
+ */
+void channel_retune_reset_stats(void)
+{
+    portENTER_CRITICAL(&retune_lock);
+    retune_count = 0;
+    retune_failed = 0;
+    retune_min = 0;
+    retune_max = 0;
+    retune_total = 0;
+    portEXIT_CRITICAL(&retune_lock);
+}
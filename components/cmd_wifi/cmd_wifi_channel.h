@@ -0,0 +1,59 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// number of recent retunes the median is taken over
+#define RETUNE_SAMPLES 64
+
+typedef struct {
+    uint32_t count;
+    uint32_t failed;
+    uint32_t min_us;
+    uint32_t median_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} retune_stats_t;
+
+// called after every successful retune, from the task that retuned
+typedef void (*channel_listener_t)(uint8_t channel);
+
+// retunes without leaving promiscuous mode, returns the time it took in latency_us
+esp_err_t channel_retune(uint8_t channel, uint32_t *latency_us);
+
+void channel_retune_get_stats(retune_stats_t *stats);
+void channel_retune_reset_stats(void);
+
+// only one listener, NULL removes it
+void channel_set_listener(channel_listener_t listener);
+
+#ifdef __cplusplus
+}
+#endif
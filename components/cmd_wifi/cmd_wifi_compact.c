@@ -0,0 +1,248 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// compact capture encoder
+//
+// records carry varint timestamp deltas, an optional snaplen (by default just the mac header) and replace
+// repeated addresses with dictionary indices, so a typical header-only record is 15-25 bytes. no esp-idf
+// dependencies, the caller fills in compact_meta_t from rx_ctrl.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_compact.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_mac.h"
+
+_Static_assert((COMPACT_DICT_SLOTS & (COMPACT_DICT_SLOTS - 1)) == 0, "COMPACT_DICT_SLOTS must be a power of two");
+_Static_assert(COMPACT_DICT_ENTRIES < COMPACT_DICT_SLOTS, "COMPACT_DICT_SLOTS must leave empty slots");
+
+// packed addresses only use 48 bits, so this can never collide with a real key
+#define COMPACT_EMPTY UINT64_MAX
+
+static uint64_t dict_keys[COMPACT_DICT_SLOTS];
+static uint16_t dict_index[COMPACT_DICT_SLOTS];
+static uint32_t dict_entries;
+static uint32_t last_timestamp;
+static uint16_t compact_snaplen;
+static compact_stats_t compact_stats;
+
+/**
+ * Starts a new stream, counters carry on across streams until compact_reset_stats()
+ * @param snaplen Bytes of each frame to keep, COMPACT_SNAPLEN_HEADER for the mac header only
+ */
+void compact_begin(uint16_t snaplen)
+{
+    for (int i = 0; i < COMPACT_DICT_SLOTS; i++) {
+        dict_keys[i] = COMPACT_EMPTY;
+    }
+    dict_entries = 0;
+    last_timestamp = 0;
+    compact_snaplen = snaplen;
+}
+
+/**
+ * Writes an unsigned LEB128 varint
+ * @param out Where to write
+ * @param value Value
+ * @return Bytes written
+ */
+static inline size_t put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * Writes the file header
+ * @param out Buffer of at least COMPACT_HEADER_LEN bytes
+ * @return Length of the header
+ */
+size_t compact_write_header(uint8_t *out)
+{
+    memcpy(out, COMPACT_MAGIC, 4);
+    out[4] = COMPACT_VERSION;
+    out[5] = 0;
+    out[6] = compact_snaplen & 0xff;
+    out[7] = compact_snaplen >> 8;
+    compact_stats.bytes_out += COMPACT_HEADER_LEN;
+    return COMPACT_HEADER_LEN;
+}
+
+/**
+ * Finds the address fields of a frame that were captured in full
+ * @param frame Raw frame, at least 2 bytes if incl_len is
+ * @param incl_len Bytes captured
+ * @param offsets Where to store the offsets, COMPACT_MAX_SLOTS entries
+ * @return Number of slots
+ */
+int compact_addr_slots(const uint8_t *frame, uint16_t incl_len, uint8_t *offsets)
+{
+    if (incl_len < 2) {
+        return 0;
+    }
+
+    uint8_t type = (frame[0] >> 2) & 0x3;
+    uint8_t subtype = frame[0] >> 4;
+    int n = 0;
+    switch (type) {
+        case WIFI_TYPE_MGMT:
+            offsets[n++] = 4;
+            offsets[n++] = 10;
+            offsets[n++] = 16;
+            break;
+        case WIFI_TYPE_CTRL:
+            offsets[n++] = 4;
+            if (subtype != 0xc && subtype != 0xd) {     /* cts and ack only carry the receiver */
+                offsets[n++] = 10;
+            }
+            break;
+        case WIFI_TYPE_DATA:
+            offsets[n++] = 4;
+            offsets[n++] = 10;
+            offsets[n++] = 16;
+            if ((frame[1] & 0x3) == 0x3) {
+                offsets[n++] = 24;
+            }
+            break;
+        default:
+            break;
+    }
+
+    while (n > 0 && offsets[n - 1] + MAC_LEN > incl_len) {
+        n--;
+    }
+    return n;
+}
+
+/**
+ * Writes the dictionary code for an address, adding it if it is new
+ * @param out Where to write
+ * @param mac Address
+ * @return Bytes written
+ */
+static size_t put_addr(uint8_t *out, const uint8_t *mac)
+{
+    uint64_t key = mac_key(mac);
+    uint32_t slot = (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (COMPACT_DICT_SLOTS - 1);
+    while (dict_keys[slot] != COMPACT_EMPTY) {
+        if (dict_keys[slot] == key) {
+            return put_varint(out, dict_index[slot] + 1);
+        }
+        slot = (slot + 1) & (COMPACT_DICT_SLOTS - 1);
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the decoder mirrors this, a literal only becomes an entry while there is room
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (dict_entries < COMPACT_DICT_ENTRIES) {
+        dict_keys[slot] = key;
+        dict_index[slot] = dict_entries++;
+    }
+    out[0] = 0;
+    memcpy(&out[1], mac, MAC_LEN);
+    return 1 + MAC_LEN;
+}
+
+/**
+ * Encodes one frame
+ * @param meta Receive metadata
+ * @param frame Raw frame
+ * @param len Bytes available in frame
+ * @param orig_len Length of the frame on air
+ * @param out Buffer of at least len + COMPACT_OVERHEAD_MAX bytes
+ * @return Length of the record
+ */
+size_t compact_encode_frame(const compact_meta_t *meta, const uint8_t *frame, uint16_t len, uint16_t orig_len, uint8_t *out)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // header only unless a snaplen was given, frames we can't decode keep their first 24 bytes
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint16_t incl_len = compact_snaplen;
+    if (incl_len == COMPACT_SNAPLEN_HEADER) {
+        wifi_frame_t decoded;
+        incl_len = wifi_decode(frame, len, len == orig_len, &decoded) ? decoded.hdr_len : 24;
+    }
+    if (incl_len > len) {
+        incl_len = len;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // unsigned subtraction keeps deltas right across the 32 bit wrap
+    //-------------------------------------------------------------------------------------------------------------------------
+    size_t n = put_varint(out, meta->timestamp - last_timestamp);
+    last_timestamp = meta->timestamp;
+    out[n++] = meta->channel;
+    out[n++] = (uint8_t)meta->rssi;
+    out[n++] = (uint8_t)meta->noise;
+    out[n++] = meta->rate;
+    n += put_varint(&out[n], orig_len);
+    n += put_varint(&out[n], incl_len);
+
+    uint8_t offsets[COMPACT_MAX_SLOTS];
+    int slots = compact_addr_slots(frame, incl_len, offsets);
+    uint16_t pos = 0;
+    for (int i = 0; i < slots; i++) {
+        memcpy(&out[n], &frame[pos], offsets[i] - pos);
+        n += offsets[i] - pos;
+        n += put_addr(&out[n], &frame[offsets[i]]);
+        pos = offsets[i] + MAC_LEN;
+    }
+    memcpy(&out[n], &frame[pos], incl_len - pos);
+    n += incl_len - pos;
+
+    compact_stats.frames++;
+    compact_stats.bytes_in += orig_len;
+    compact_stats.bytes_out += n;
+    return n;
+}
+
+/**
+ * Copies the encoder counters
+ * @param stats Where to copy them
+ */
+void compact_get_stats(compact_stats_t *stats)
+{
+    *stats = compact_stats;
+    stats->dict_entries = dict_entries;
+}
+
+/**
+ * Clears the encoder counters
+ */
+void compact_reset_stats(void)
+{
+    memset(&compact_stats, 0, sizeof(compact_stats));
+}
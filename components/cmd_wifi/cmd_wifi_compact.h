@@ -0,0 +1,92 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// compact capture format, tools/compact2pcap.py expands it back to pcap
+//
+// file header: "ESPC", version, reserved, snaplen (u16 le)
+// record:      varint timestamp delta (us), channel, rssi, noise, rate,
+//              varint orig_len, varint incl_len, then incl_len bytes of the frame in which every address slot
+//              (see compact_addr_slots) is replaced by a varint code: 0 followed by the 6 byte address, which
+//              also appends it to the dictionary, or n for dictionary entry n - 1
+//-------------------------------------------------------------------------------------------------------------------------
+#define COMPACT_MAGIC "ESPC"
+#define COMPACT_VERSION 1
+#define COMPACT_HEADER_LEN 8
+
+// snaplen 0 keeps the mac header only
+#define COMPACT_SNAPLEN_HEADER 0
+
+// dictionary size, addresses seen after it is full are always written out
+#define COMPACT_DICT_ENTRIES 1024
+#define COMPACT_DICT_SLOTS 2048
+
+// worst case bytes a record adds on top of the captured frame
+#define COMPACT_OVERHEAD_MAX 24
+
+#define COMPACT_MAX_SLOTS 4
+
+// receive metadata kept per record
+typedef struct {
+    uint32_t timestamp;     /* us, wraps */
+    uint8_t channel;
+    int8_t rssi;
+    int8_t noise;
+    uint8_t rate;           /* wifi_phy_rate_t */
+} compact_meta_t;
+
+typedef struct {
+    uint32_t frames;
+    uint64_t bytes_in;      /* original frame bytes */
+    uint64_t bytes_out;     /* encoded bytes including the file header */
+    uint32_t dict_entries;
+} compact_stats_t;
+
+// starts a new stream, clearing the dictionary and timestamp base
+void compact_begin(uint16_t snaplen);
+
+// writes the file header, returns its length
+size_t compact_write_header(uint8_t *out);
+
+// encodes one frame into out, which needs len + COMPACT_OVERHEAD_MAX bytes, returns the record length
+size_t compact_encode_frame(const compact_meta_t *meta, const uint8_t *frame, uint16_t len, uint16_t orig_len, uint8_t *out);
+
+// offsets of the address fields a frame carries within its first incl_len bytes, returns how many
+int compact_addr_slots(const uint8_t *frame, uint16_t incl_len, uint8_t *offsets);
+
+void compact_get_stats(compact_stats_t *stats);
+void compact_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
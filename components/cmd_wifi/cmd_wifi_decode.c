@@ -0,0 +1,492 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// bounds checked 802.11 decoder
+//
+// nothing is copied, the decoded frame and element summaries point into the buffer that was decoded.
+// this file has no esp-idf dependencies so it can be built and exercised on a host.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_decode.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// frame control flags, second byte
+//-------------------------------------------------------------------------------------------------------------------------
+#define FC_TO_DS 0x01
+#define FC_FROM_DS 0x02
+#define FC_MORE_FRAG 0x04
+#define FC_RETRY 0x08
+#define FC_PWR_MGMT 0x10
+#define FC_MORE_DATA 0x20
+#define FC_PROTECTED 0x40
+#define FC_ORDER 0x80
+
+//-------------------------------------------------------------------------------------------------------------------------
+// control subtypes with a short header (fc, duration, addr1)
+//-------------------------------------------------------------------------------------------------------------------------
+#define CTRL_CTS 0xc
+#define CTRL_ACK 0xd
+
+static const uint8_t oui_ieee[3] = { 0x00, 0x0f, 0xac };
+static const uint8_t oui_microsoft[3] = { 0x00, 0x50, 0xf2 };
+
+static inline uint16_t read_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t read_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Decodes the mac header of a frame
+ * @param buf Raw frame
+ * @param len Length of the frame
+ * @param has_fcs Whether the last 4 bytes are the FCS, false for truncated captures
+ * @param frame Where to store the decoded frame
+ * @return False if the frame is too short for its own header
+ */
+bool wifi_decode(const uint8_t *buf, uint16_t len, bool has_fcs, wifi_frame_t *frame)
+{
+    memset(frame, 0, sizeof(*frame));
+
+    if (has_fcs) {
+        if (len < WIFI_FCS_LEN) {
+            return false;
+        }
+        len -= WIFI_FCS_LEN;
+    }
+    if (len < 10) {
+        return false;
+    }
+
+    frame->fc = read_le16(buf);
+    frame->type = (buf[0] >> 2) & 0x3;
+    frame->subtype = buf[0] >> 4;
+    frame->to_ds = buf[1] & FC_TO_DS;
+    frame->from_ds = buf[1] & FC_FROM_DS;
+    frame->more_frag = buf[1] & FC_MORE_FRAG;
+    frame->retry = buf[1] & FC_RETRY;
+    frame->pwr_mgmt = buf[1] & FC_PWR_MGMT;
+    frame->more_data = buf[1] & FC_MORE_DATA;
+    frame->protected_frame = buf[1] & FC_PROTECTED;
+    frame->order = buf[1] & FC_ORDER;
+    frame->duration = read_le16(&buf[2]);
+    frame->addr1 = &buf[4];
+
+    uint16_t hdr = 10;
+    switch (frame->type) {
+        case WIFI_TYPE_CTRL:
+            //-------------------------------------------------------------------------------------------------------------------------
+            // everything but cts and ack also carries the transmitter
+            //-------------------------------------------------------------------------------------------------------------------------
+            if (frame->subtype != CTRL_CTS && frame->subtype != CTRL_ACK) {
+                hdr = 16;
+            }
+            break;
+
+        case WIFI_TYPE_MGMT:
+        case WIFI_TYPE_DATA:
+            hdr = 24;
+            if (frame->type == WIFI_TYPE_DATA && frame->to_ds && frame->from_ds) {
+                hdr += 6;
+            }
+            if (frame->type == WIFI_TYPE_DATA && (frame->subtype & 0x8)) {
+                frame->has_qos = true;
+                hdr += 2;
+            }
+            //-------------------------------------------------------------------------------------------------------------------------
+            // the order bit means an HT control field follows for management and QoS data frames
+            //-------------------------------------------------------------------------------------------------------------------------
+            if (frame->order && (frame->type == WIFI_TYPE_MGMT || frame->has_qos)) {
+                frame->has_htc = true;
+                hdr += 4;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    if (len < hdr) {
+        return false;
+    }
+
+    if (hdr >= 16) {
+        frame->addr2 = &buf[10];
+    }
+    if (hdr >= 24) {
+        frame->addr3 = &buf[16];
+        uint16_t seq_ctrl = read_le16(&buf[22]);
+        frame->has_seq = true;
+        frame->seq = seq_ctrl >> 4;
+        frame->frag = seq_ctrl & 0xf;
+
+        uint16_t off = 24;
+        if (frame->type == WIFI_TYPE_DATA && frame->to_ds && frame->from_ds) {
+            frame->addr4 = &buf[off];
+            off += 6;
+        }
+        if (frame->has_qos) {
+            frame->qos = read_le16(&buf[off]);
+            off += 2;
+        }
+        if (frame->has_htc) {
+            frame->htc = read_le32(&buf[off]);
+        }
+    }
+
+    frame->hdr_len = hdr;
+    frame->body = &buf[hdr];
+    frame->body_len = len - hdr;
+    return true;
+}
+
+/**
+ * Counts the header addresses of a frame the way wifi_decode lays them out, without decoding the rest
+ * @param buf Raw frame
+ * @param len Length of the frame
+ * @return Number of addr1, addr2 and addr3 present, an address cut off by len is not counted
+ */
+uint8_t wifi_addr_count(const uint8_t *buf, uint16_t len)
+{
+    if (len < 2) {
+        return 0;
+    }
+
+    uint8_t count;
+    switch ((buf[0] >> 2) & 0x3) {
+        case WIFI_TYPE_CTRL:
+            count = (buf[0] >> 4) == CTRL_CTS || (buf[0] >> 4) == CTRL_ACK ? 1 : 2;
+            break;
+        case WIFI_TYPE_MGMT:
+        case WIFI_TYPE_DATA:
+            count = 3;
+            break;
+        default:
+            return 0;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // addr1 starts at 4 and the others follow back to back
+    //-------------------------------------------------------------------------------------------------------------------------
+    while (count > 0 && len < 4 + 6 * count) {
+        count--;
+    }
+    return count;
+}
+
+/**
+ * Starts walking a list of elements
+ * @param it Iterator
+ * @param ies First element
+ * @param len Length of the element list
+ */
+void wifi_ie_begin(wifi_ie_iter_t *it, const uint8_t *ies, uint16_t len)
+{
+    it->pos = ies;
+    it->end = ies + len;
+}
+
+/**
+ * Returns the next element, stops at the first element that would run past the end
+ * @param it Iterator
+ * @param id Element id
+ * @param len Element length
+ * @param data Element body
+ * @return False when there are no more complete elements
+ */
+bool wifi_ie_next(wifi_ie_iter_t *it, uint8_t *id, uint8_t *len, const uint8_t **data)
+{
+    if (it->end - it->pos < 2) {
+        return false;
+    }
+
+    uint8_t n = it->pos[1];
+    if (it->end - it->pos - 2 < n) {
+        return false;
+    }
+
+    *id = it->pos[0];
+    *len = n;
+    *data = it->pos + 2;
+    it->pos += 2 + n;
+    return true;
+}
+
+/**
+ * Finds the elements of a management frame, after the fixed fields of its subtype
+ * @param frame Decoded frame
+ * @param ies Where to store the first element
+ * @param len Where to store the length of the element list
+ * @return False for subtypes without elements or bodies too short for their fixed fields
+ */
+bool wifi_mgmt_ies(const wifi_frame_t *frame, const uint8_t **ies, uint16_t *len)
+{
+    uint16_t fixed;
+
+    if (frame->type != WIFI_TYPE_MGMT || frame->protected_frame) {
+        return false;
+    }
+
+    switch (frame->subtype) {
+        case WIFI_MGMT_BEACON:
+        case WIFI_MGMT_PROBE_RESP:
+            fixed = 12;     /* timestamp, interval, capability */
+            break;
+        case WIFI_MGMT_PROBE_REQ:
+            fixed = 0;
+            break;
+        case WIFI_MGMT_ASSOC_REQ:
+            fixed = 4;      /* capability, listen interval */
+            break;
+        case WIFI_MGMT_REASSOC_REQ:
+            fixed = 10;     /* capability, listen interval, current ap */
+            break;
+        case WIFI_MGMT_ASSOC_RESP:
+        case WIFI_MGMT_REASSOC_RESP:
+        case WIFI_MGMT_AUTH:
+            fixed = 6;
+            break;
+        default:
+            return false;
+    }
+
+    if (frame->body_len < fixed) {
+        return false;
+    }
+
+    *ies = frame->body + fixed;
+    *len = frame->body_len - fixed;
+    return true;
+}
+
+/**
+ * Reads the AKM suites of an RSN or WPA element
+ * @param p First byte of the AKM count
+ * @param end End of the element
+ * @param oui OUI the suites are expected under
+ * @return WIFI_SEC_* bits for the suites found
+ */
+static uint8_t parse_akms(const uint8_t *p, const uint8_t *end, const uint8_t *oui)
+{
+    uint8_t security = 0;
+
+    if (end - p < 2) {
+        return 0;
+    }
+    uint16_t count = read_le16(p);
+    p += 2;
+
+    for (uint16_t i = 0; i < count && end - p >= 4; i++, p += 4) {
+        if (memcmp(p, oui, 3) != 0) {
+            continue;
+        }
+        switch (p[3]) {
+            case 1:
+            case 3:
+            case 5:
+            case 11:
+            case 12:
+                security |= WIFI_SEC_EAP;
+                break;
+            case 2:
+            case 4:
+            case 6:
+                security |= WIFI_SEC_PSK;
+                break;
+            case 8:
+            case 9:
+            case 24:
+                security |= WIFI_SEC_SAE;
+                break;
+            case 18:
+                security |= WIFI_SEC_OWE;
+                break;
+        }
+    }
+    return security;
+}
+
+/**
+ * Skips version, group cipher and pairwise ciphers to reach the AKM list
+ * @param p First byte after the version or OUI header
+ * @param end End of the element
+ * @return Pointer to the AKM count, or end if the element is truncated
+ */
+static const uint8_t *skip_ciphers(const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 6) {
+        return end;
+    }
+    p += 4;     /* group cipher */
+    uint16_t count = read_le16(p);
+    p += 2;
+    if ((end - p) / 4 < count) {
+        return end;
+    }
+    return p + 4 * count;
+}
+
+/**
+ * Parses the elements we care about out of a management frame
+ * @param frame Decoded frame
+ * @param info Where to store the summary
+ * @return False if the frame carries no elements
+ */
+bool wifi_parse_mgmt(const wifi_frame_t *frame, wifi_mgmt_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+
+    const uint8_t *ies;
+    uint16_t ies_len;
+    if (!wifi_mgmt_ies(frame, &ies, &ies_len)) {
+        return false;
+    }
+
+    if (frame->subtype == WIFI_MGMT_BEACON || frame->subtype == WIFI_MGMT_PROBE_RESP) {
+        info->beacon_interval = read_le16(&frame->body[8]);
+        info->capability = read_le16(&frame->body[10]);
+    }
+
+    wifi_ie_iter_t it;
+    uint8_t id;
+    uint8_t len;
+    const uint8_t *data;
+    wifi_ie_begin(&it, ies, ies_len);
+    while (wifi_ie_next(&it, &id, &len, &data)) {
+        switch (id) {
+            case WIFI_IE_SSID:
+                if (info->ssid == NULL && len <= 32) {
+                    info->ssid = data;
+                    info->ssid_len = len;
+                }
+                break;
+
+            case WIFI_IE_DS_PARAMS:
+                if (len >= 1) {
+                    info->channel = data[0];
+                }
+                break;
+
+            case WIFI_IE_HT_CAP:
+                info->ht_cap = data;
+                info->ht_cap_len = len;
+                break;
+
+            case WIFI_IE_RSN:
+                info->rsn = data;
+                info->rsn_len = len;
+                info->security |= WIFI_SEC_WPA2;
+                info->security |= parse_akms(skip_ciphers(data + 2, data + len), data + len, oui_ieee);
+                break;
+
+            case WIFI_IE_VENDOR:
+                if (len >= 4 && memcmp(data, oui_microsoft, 3) == 0 && data[3] == 1) {
+                    info->security |= WIFI_SEC_WPA;
+                    info->security |= parse_akms(skip_ciphers(data + 6, data + len), data + len, oui_microsoft);
+                }
+                break;
+
+            case WIFI_IE_EXTENSION:
+                if (len >= 1 && data[0] == WIFI_IE_EXT_HE_CAP) {
+                    info->he_cap = data + 1;
+                    info->he_cap_len = len - 1;
+                }
+                break;
+        }
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // no RSN or WPA element, the privacy bit tells WEP from open
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (!(info->security & (WIFI_SEC_WPA | WIFI_SEC_WPA2))) {
+        info->security |= (info->capability & 0x0010) ? WIFI_SEC_WEP : WIFI_SEC_OPEN;
+    }
+    return true;
+}
+
+/**
+ * Names a frame subtype
+ * @param type Frame type
+ * @param subtype Frame subtype
+ * @return Name of the subtype
+ */
+const char *wifi_subtype_name(uint8_t type, uint8_t subtype)
+{
+    static const char *mgmt[16] = {
+        "assoc-req", "assoc-resp", "reassoc-req", "reassoc-resp", "probe-req", "probe-resp", "timing-adv", "mgmt-7",
+        "beacon", "atim", "disassoc", "auth", "deauth", "action", "action-noack", "mgmt-15"
+    };
+    static const char *ctrl[16] = {
+        "ctrl-0", "ctrl-1", "trigger", "tack", "beamforming-poll", "ndp-announce", "ctrl-ext", "ctrl-wrapper",
+        "block-ack-req", "block-ack", "ps-poll", "rts", "cts", "ack", "cf-end", "cf-end-ack"
+    };
+    static const char *data[16] = {
+        "data", "data-cf-ack", "data-cf-poll", "data-cf-ack-poll", "null", "cf-ack", "cf-poll", "cf-ack-poll",
+        "qos-data", "qos-data-cf-ack", "qos-data-cf-poll", "qos-data-cf-ack-poll", "qos-null", "data-13", "qos-cf-poll", "qos-cf-ack-poll"
+    };
+
+    subtype &= 0xf;
+    switch (type) {
+        case WIFI_TYPE_MGMT:
+            return mgmt[subtype];
+        case WIFI_TYPE_CTRL:
+            return ctrl[subtype];
+        case WIFI_TYPE_DATA:
+            return data[subtype];
+        default:
+            return "extension";
+    }
+}
+
+/**
+ * Formats security bits, e.g. WPA2/PSK/SAE
+ * @param security WIFI_SEC_* bits
+ * @param out Buffer
+ * @param out_len Size of the buffer
+ */
+void wifi_security_str(uint8_t security, char *out, int out_len)
+{
+    static const char *names[] = { "OPEN", "WEP", "WPA", "WPA2", "PSK", "SAE", "EAP", "OWE" };
+
+    int pos = 0;
+    out[0] = '\0';
+    for (int i = 0; i < 8 && pos < out_len; i++) {
+        if (security & (1 << i)) {
+            pos += snprintf(out + pos, out_len - pos, "%s%s", pos > 0 ? "/" : "", names[i]);
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// frame control types and the subtypes we look at
+//-------------------------------------------------------------------------------------------------------------------------
+#define WIFI_TYPE_MGMT 0
+#define WIFI_TYPE_CTRL 1
+#define WIFI_TYPE_DATA 2
+#define WIFI_TYPE_EXT 3
+
+#define WIFI_MGMT_ASSOC_REQ 0x0
+#define WIFI_MGMT_ASSOC_RESP 0x1
+#define WIFI_MGMT_REASSOC_REQ 0x2
+#define WIFI_MGMT_REASSOC_RESP 0x3
+#define WIFI_MGMT_PROBE_REQ 0x4
+#define WIFI_MGMT_PROBE_RESP 0x5
+#define WIFI_MGMT_BEACON 0x8
+#define WIFI_MGMT_DISASSOC 0xa
+#define WIFI_MGMT_AUTH 0xb
+#define WIFI_MGMT_DEAUTH 0xc
+#define WIFI_MGMT_ACTION 0xd
+
+#define WIFI_FCS_LEN 4
+
+//-------------------------------------------------------------------------------------------------------------------------
+// element ids
+//-------------------------------------------------------------------------------------------------------------------------
+#define WIFI_IE_SSID 0
+#define WIFI_IE_DS_PARAMS 3
+#define WIFI_IE_HT_CAP 45
+#define WIFI_IE_RSN 48
+#define WIFI_IE_VENDOR 221
+#define WIFI_IE_EXTENSION 255
+#define WIFI_IE_EXT_HE_CAP 35
+
+// a decoded frame, all pointers point into the buffer that was decoded
+typedef struct {
+    uint16_t fc;
+    uint8_t type;
+    uint8_t subtype;
+    bool to_ds;
+    bool from_ds;
+    bool more_frag;
+    bool retry;
+    bool pwr_mgmt;
+    bool more_data;
+    bool protected_frame;
+    bool order;
+    uint16_t duration;
+    const uint8_t *addr1;   /* NULL when the frame doesn't carry it */
+    const uint8_t *addr2;
+    const uint8_t *addr3;
+    const uint8_t *addr4;
+    bool has_seq;
+    uint16_t seq;
+    uint8_t frag;
+    bool has_qos;
+    uint16_t qos;
+    bool has_htc;
+    uint32_t htc;
+    uint16_t hdr_len;
+    const uint8_t *body;    /* frame body without the FCS */
+    uint16_t body_len;
+} wifi_frame_t;
+
+// walks information elements
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+} wifi_ie_iter_t;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// security summary from the RSN and WPA elements
+//-------------------------------------------------------------------------------------------------------------------------
+#define WIFI_SEC_OPEN (1 << 0)
+#define WIFI_SEC_WEP (1 << 1)
+#define WIFI_SEC_WPA (1 << 2)
+#define WIFI_SEC_WPA2 (1 << 3)
+#define WIFI_SEC_PSK (1 << 4)
+#define WIFI_SEC_SAE (1 << 5)
+#define WIFI_SEC_EAP (1 << 6)
+#define WIFI_SEC_OWE (1 << 7)
+
+// what we pull out of a beacon, probe or association frame, pointers point into the frame
+typedef struct {
+    uint16_t beacon_interval;
+    uint16_t capability;
+    const uint8_t *ssid;
+    uint8_t ssid_len;
+    uint8_t channel;        /* from the DS parameter set, 0 if absent */
+    const uint8_t *rsn;     /* RSN element body */
+    uint8_t rsn_len;
+    const uint8_t *ht_cap;
+    uint8_t ht_cap_len;
+    const uint8_t *he_cap;  /* HE capabilities, after the extension id */
+    uint8_t he_cap_len;
+    uint8_t security;       /* WIFI_SEC_* */
+} wifi_mgmt_info_t;
+
+// decodes the mac header, has_fcs says whether the last 4 bytes are the FCS
+bool wifi_decode(const uint8_t *buf, uint16_t len, bool has_fcs, wifi_frame_t *frame);
+
+// how many of addr1, addr2 and addr3 the frame carries, from its type and subtype and cut short by len
+uint8_t wifi_addr_count(const uint8_t *buf, uint16_t len);
+
+// element iterator over a body
+void wifi_ie_begin(wifi_ie_iter_t *it, const uint8_t *ies, uint16_t len);
+bool wifi_ie_next(wifi_ie_iter_t *it, uint8_t *id, uint8_t *len, const uint8_t **data);
+
+// locates the elements of a management frame after its fixed fields
+bool wifi_mgmt_ies(const wifi_frame_t *frame, const uint8_t **ies, uint16_t *len);
+
+// parses the elements we care about out of a management frame
+bool wifi_parse_mgmt(const wifi_frame_t *frame, wifi_mgmt_info_t *info);
+
+const char *wifi_subtype_name(uint8_t type, uint8_t subtype);
+void wifi_security_str(uint8_t security, char *out, int out_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,416 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// flood detector
+//
+// the table works like the device table: a flat array found through chained hash buckets and recycled with CLOCK.
+// nothing here locks, callers serialize access.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_detect.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_mac.h"
+
+_Static_assert((DETECT_HASH_BUCKETS & (DETECT_HASH_BUCKETS - 1)) == 0, "DETECT_HASH_BUCKETS must be a power of two");
+_Static_assert(DETECT_CAPACITY < DETECT_NONE, "DETECT_CAPACITY must fit in a uint16_t index");
+
+const char *detect_kind_name[DETECT_KINDS] = {
+    "deauth",
+    "disassoc",
+    "probe"
+};
+
+const char *detect_role_name[2] = {
+    "source",
+    "bssid"
+};
+
+static detect_entry_t detect_entries[DETECT_CAPACITY];
+static uint16_t detect_buckets[DETECT_HASH_BUCKETS];
+static uint32_t detect_count;
+static uint32_t detect_hand;
+static bool detect_initialized;
+
+static uint16_t detect_thresholds[DETECT_KINDS] = {
+    DETECT_DEFAULT_DEAUTH,
+    DETECT_DEFAULT_DISASSOC,
+    DETECT_DEFAULT_PROBE
+};
+
+static detect_event_t detect_log[DETECT_LOG];
+static uint32_t detect_seq;
+static uint32_t detect_frames;
+
+/**
+ * Bucket for an address and role
+ * @param mac Mac address
+ * @param role Role of the address
+ * @return Bucket index
+ */
+static inline uint32_t detect_bucket(const uint8_t *mac, uint8_t role)
+{
+    uint64_t key = mac_key(mac) ^ ((uint64_t)role << 48);
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (DETECT_HASH_BUCKETS - 1);
+}
+
+/**
+ * Empties the table and the event log, thresholds are kept
+ */
+void detect_clear(void)
+{
+    for (int i = 0; i < DETECT_HASH_BUCKETS; i++) {
+        detect_buckets[i] = DETECT_NONE;
+    }
+    detect_count = 0;
+    detect_hand = 0;
+    detect_seq = 0;
+    detect_frames = 0;
+    detect_initialized = true;
+}
+
+/**
+ * Sets the threshold of a frame kind
+ * @param kind Frame kind
+ * @param per_second Frames per second, 0 disables the kind
+ */
+void detect_set_threshold(detect_kind_t kind, uint16_t per_second)
+{
+    detect_thresholds[kind] = per_second;
+}
+
+/**
+ * Returns the threshold of a frame kind
+ * @param kind Frame kind
+ * @return Frames per second
+ */
+uint16_t detect_get_threshold(detect_kind_t kind)
+{
+    return detect_thresholds[kind];
+}
+
+/**
+ * Maps a frame to the kind it counts as
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @return Kind, DETECT_KINDS if it isn't watched
+ */
+static inline detect_kind_t detect_kind(const uint8_t *frame, uint16_t len)
+{
+    if (len < MAC_ADDR3_OFFSET + MAC_LEN || ((frame[0] >> 2) & 0x3) != WIFI_TYPE_MGMT) {
+        return DETECT_KINDS;
+    }
+    switch (frame[0] >> 4) {
+        case WIFI_MGMT_DEAUTH:
+            return DETECT_DEAUTH;
+        case WIFI_MGMT_DISASSOC:
+            return DETECT_DISASSOC;
+        case WIFI_MGMT_PROBE_REQ:
+            return DETECT_PROBE;
+        default:
+            return DETECT_KINDS;
+    }
+}
+
+/**
+ * Checks whether the detector counts a frame
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @return True for deauth, disassoc and probe request frames
+ */
+bool detect_wants(const uint8_t *frame, uint16_t len)
+{
+    return detect_kind(frame, len) != DETECT_KINDS;
+}
+
+/**
+ * Moves a window forward to the bucket holding now, clearing the buckets it passes
+ * @param window Window
+ * @param epoch Current bucket number
+ */
+static void detect_advance(detect_window_t *window, uint32_t epoch)
+{
+    uint32_t steps = epoch - window->epoch;
+    if (steps >= DETECT_BUCKETS) {
+        memset(window->counts, 0, sizeof(window->counts));
+        window->sum = 0;
+    } else {
+        for (uint32_t i = 1; i <= steps; i++) {
+            uint16_t *count = &window->counts[(window->epoch + i) % DETECT_BUCKETS];
+            window->sum -= *count;
+            *count = 0;
+        }
+    }
+    window->epoch = epoch;
+}
+
+/**
+ * Removes an entry from its bucket chain
+ * @param index Entry to unlink
+ */
+static void detect_unlink(uint16_t index)
+{
+    detect_entry_t *entry = &detect_entries[index];
+    uint16_t *link = &detect_buckets[detect_bucket(entry->mac, entry->role)];
+    while (*link != DETECT_NONE) {
+        if (*link == index) {
+            *link = entry->next;
+            return;
+        }
+        link = &detect_entries[*link].next;
+    }
+}
+
+/**
+ * Picks an entry to reuse, giving every recently used entry a second chance
+ * @return Entry index
+ */
+static uint16_t detect_evict(void)
+{
+    while (detect_entries[detect_hand].referenced) {
+        detect_entries[detect_hand].referenced = 0;
+        detect_hand = (detect_hand + 1) % DETECT_CAPACITY;
+    }
+
+    uint16_t victim = detect_hand;
+    detect_hand = (detect_hand + 1) % DETECT_CAPACITY;
+    detect_unlink(victim);
+    return victim;
+}
+
+/**
+ * Counts a frame against one address
+ * @param mac Address
+ * @param role Role of the address
+ * @param kind Frame kind
+ * @param now_ms Receive time in milliseconds
+ * @return True if this frame raised an event
+ */
+static bool detect_count_frame(const uint8_t *mac, detect_role_t role, detect_kind_t kind, uint32_t now_ms)
+{
+    uint32_t bucket = detect_bucket(mac, role);
+    uint16_t index = detect_buckets[bucket];
+    while (index != DETECT_NONE &&
+           (detect_entries[index].role != role || memcmp(detect_entries[index].mac, mac, MAC_LEN) != 0)) {
+        index = detect_entries[index].next;
+    }
+
+    uint32_t epoch = now_ms / DETECT_BUCKET_MS;
+    detect_entry_t *entry;
+    if (index == DETECT_NONE) {
+        index = detect_count < DETECT_CAPACITY ? detect_count++ : detect_evict();
+        entry = &detect_entries[index];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->mac, mac, MAC_LEN);
+        entry->role = role;
+        for (int i = 0; i < DETECT_KINDS; i++) {
+            entry->windows[i].epoch = epoch;
+        }
+        entry->next = detect_buckets[bucket];
+        detect_buckets[bucket] = index;
+    } else {
+        entry = &detect_entries[index];
+    }
+
+    entry->referenced = 1;
+    entry->last_seen = now_ms;
+    entry->totals[kind]++;
+
+    detect_window_t *window = &entry->windows[kind];
+    detect_advance(window, epoch);
+    if (window->counts[epoch % DETECT_BUCKETS] < UINT16_MAX && window->sum < UINT16_MAX) {
+        window->counts[epoch % DETECT_BUCKETS]++;
+        window->sum++;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // raise once per burst, rearm when the rate has fallen below half the threshold
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t limit = (uint32_t)detect_thresholds[kind] * DETECT_WINDOW_MS / 1000;
+    uint8_t bit = 1 << kind;
+    if (limit == 0) {
+        entry->alerting &= ~bit;
+        return false;
+    }
+    if (entry->alerting & bit) {
+        if (window->sum < limit / 2) {
+            entry->alerting &= ~bit;
+        }
+        return false;
+    }
+    if (window->sum < limit) {
+        return false;
+    }
+
+    entry->alerting |= bit;
+    detect_event_t *event = &detect_log[detect_seq % DETECT_LOG];
+    event->seq = ++detect_seq;
+    event->time_ms = now_ms;
+    memcpy(event->mac, mac, MAC_LEN);
+    event->role = role;
+    event->kind = kind;
+    event->rate = (uint16_t)((uint32_t)window->sum * 1000 / DETECT_WINDOW_MS);
+    return true;
+}
+
+/**
+ * Counts a deauth, disassoc or probe request frame against its source and, for the first two, its bssid
+ * @param frame Raw 802.11 frame
+ * @param len Length of the frame
+ * @param now_ms Receive time in milliseconds
+ * @return True if the frame raised an event
+ */
+bool detect_frame(const uint8_t *frame, uint16_t len, uint32_t now_ms)
+{
+    detect_kind_t kind = detect_kind(frame, len);
+    if (kind == DETECT_KINDS) {
+        return false;
+    }
+    if (!detect_initialized) {
+        detect_clear();
+    }
+    detect_frames++;
+
+    bool raised = detect_count_frame(&frame[MAC_ADDR2_OFFSET], DETECT_ROLE_SOURCE, kind, now_ms);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // probe requests go to the wildcard bssid, only deauth and disassoc name the network they hit
+    //-------------------------------------------------------------------------------------------------------------------------
+    const uint8_t *bssid = &frame[MAC_ADDR3_OFFSET];
+    if (kind != DETECT_PROBE && !(bssid[0] & 0x01)) {
+        raised |= detect_count_frame(bssid, DETECT_ROLE_BSSID, kind, now_ms);
+    }
+    return raised;
+}
+
+/**
+ * Copies logged events newer than a sequence number
+ * @param out Where to copy them
+ * @param max Room in out
+ * @param after Last sequence number already seen
+ * @return Number of events copied
+ */
+size_t detect_recent(detect_event_t *out, size_t max, uint32_t after)
+{
+    uint32_t first = after + 1;
+    if (detect_seq >= DETECT_LOG && first <= detect_seq - DETECT_LOG) {
+        first = detect_seq - DETECT_LOG + 1;
+    }
+
+    size_t n = 0;
+    for (uint32_t seq = first; seq <= detect_seq && n < max; seq++) {
+        out[n++] = detect_log[(seq - 1) % DETECT_LOG];
+    }
+    return n;
+}
+
+/**
+ * Returns the frames counted and events raised since the last clear
+ * @param frames Where to store the frame count
+ * @param events Where to store the event count
+ */
+void detect_get_totals(uint32_t *frames, uint32_t *events)
+{
+    *frames = detect_frames;
+    *events = detect_seq;
+}
+
+/**
+ * Returns the window sum of an entry as of a time, without changing the entry
+ * @param entry Entry
+ * @param kind Frame kind
+ * @param now_ms Current time in milliseconds
+ * @return Frames in the window
+ */
+uint16_t detect_window_sum(const detect_entry_t *entry, detect_kind_t kind, uint32_t now_ms)
+{
+    detect_window_t window = entry->windows[kind];
+    detect_advance(&window, now_ms / DETECT_BUCKET_MS);
+    return window.sum;
+}
+
+/**
+ * Sums the windows of an entry over all kinds
+ * @param entry Entry
+ * @param now_ms Current time in milliseconds
+ * @return Frames in the windows
+ */
+static uint32_t detect_busy(const detect_entry_t *entry, uint32_t now_ms)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < DETECT_KINDS; i++) {
+        sum += detect_window_sum(entry, i, now_ms);
+    }
+    return sum;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+// sort comparator, busiest first. qsort has no context argument so the time is passed in a static
+//-------------------------------------------------------------------------------------------------------------------------
+static uint32_t detect_sort_now;
+
+static int compare_busy(const void *a, const void *b)
+{
+    uint32_t x = detect_busy(a, detect_sort_now);
+    uint32_t y = detect_busy(b, detect_sort_now);
+    return (x < y) - (x > y);
+}
+
+/**
+ * Copies the entries with frames in their current window
+ * @param out Where to copy them
+ * @param max Room in out
+ * @param now_ms Current time in milliseconds
+ * @return Number of entries copied
+ */
+size_t detect_snapshot(detect_entry_t *out, size_t max, uint32_t now_ms)
+{
+    size_t n = 0;
+    for (uint32_t i = 0; i < detect_count && n < max; i++) {
+        if (detect_busy(&detect_entries[i], now_ms) > 0) {
+            out[n++] = detect_entries[i];
+        }
+    }
+    return n;
+}
+
+/**
+ * Sorts copied entries, busiest first
+ * @param entries Entries from detect_snapshot
+ * @param n Number of entries
+ * @param now_ms Time the windows are looked at
+ */
+void detect_sort(detect_entry_t *entries, size_t n, uint32_t now_ms)
+{
+    detect_sort_now = now_ms;
+    qsort(entries, n, sizeof(*entries), compare_busy);
+}
@@ -0,0 +1,127 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// deauthentication, disassociation and probe request flood detector
+//
+// every source address, and every bssid of deauth and disassoc frames, gets a sliding window per frame kind made of
+// DETECT_BUCKETS ring buckets of DETECT_BUCKET_MS each. a frame costs one table lookup and at most DETECT_BUCKETS
+// bucket clears. an event is raised when a window reaches its threshold and rearmed once it drops below half.
+//-------------------------------------------------------------------------------------------------------------------------
+#define DETECT_CAPACITY 64
+#define DETECT_HASH_BUCKETS 64      /* power of two */
+#define DETECT_NONE 0xffff
+
+#define DETECT_BUCKETS 8
+#define DETECT_BUCKET_MS 250
+#define DETECT_WINDOW_MS (DETECT_BUCKETS * DETECT_BUCKET_MS)
+
+// events kept for the console, older ones are overwritten
+#define DETECT_LOG 16
+
+typedef enum {
+    DETECT_DEAUTH,
+    DETECT_DISASSOC,
+    DETECT_PROBE,
+    DETECT_KINDS
+} detect_kind_t;
+
+typedef enum {
+    DETECT_ROLE_SOURCE,     /* addr2 */
+    DETECT_ROLE_BSSID       /* addr3 */
+} detect_role_t;
+
+// default thresholds in frames per second, 0 disables a kind
+#define DETECT_DEFAULT_DEAUTH 10
+#define DETECT_DEFAULT_DISASSOC 10
+#define DETECT_DEFAULT_PROBE 50
+
+typedef struct {
+    uint16_t counts[DETECT_BUCKETS];
+    uint16_t sum;
+    uint32_t epoch;         /* bucket number of the newest bucket, now_ms / DETECT_BUCKET_MS */
+} detect_window_t;
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t role;
+    uint8_t referenced;     /* CLOCK bit */
+    uint8_t alerting;       /* bit per kind, set while above threshold */
+    uint16_t next;
+    uint32_t last_seen;     /* ms */
+    uint32_t totals[DETECT_KINDS];
+    detect_window_t windows[DETECT_KINDS];
+} detect_entry_t;
+
+typedef struct {
+    uint32_t seq;           /* starts at 1 */
+    uint32_t time_ms;
+    uint8_t mac[6];
+    uint8_t role;
+    uint8_t kind;
+    uint16_t rate;          /* frames per second over the window when raised */
+} detect_event_t;
+
+extern const char *detect_kind_name[DETECT_KINDS];
+extern const char *detect_role_name[2];
+
+void detect_clear(void);
+
+// thresholds in frames per second over the window, 0 disables the kind
+void detect_set_threshold(detect_kind_t kind, uint16_t per_second);
+uint16_t detect_get_threshold(detect_kind_t kind);
+
+// cheap check on the frame control field, true for deauth, disassoc and probe request frames
+bool detect_wants(const uint8_t *frame, uint16_t len);
+
+// counts a frame, returns true if it raised an event
+bool detect_frame(const uint8_t *frame, uint16_t len, uint32_t now_ms);
+
+// copies events with seq > after, oldest first, returns how many
+size_t detect_recent(detect_event_t *out, size_t max, uint32_t after);
+
+// frames counted and events raised since the last clear
+void detect_get_totals(uint32_t *frames, uint32_t *events);
+
+// copies the entries with frames in their current window, cheap enough to run with interrupts off
+size_t detect_snapshot(detect_entry_t *out, size_t max, uint32_t now_ms);
+
+// sorts copied entries, busiest first
+void detect_sort(detect_entry_t *entries, size_t n, uint32_t now_ms);
+
+// window sum of an entry as of now_ms, for entries copied by detect_snapshot
+uint16_t detect_window_sum(const detect_entry_t *entry, detect_kind_t kind, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
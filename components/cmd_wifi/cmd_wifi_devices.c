@@ -0,0 +1,268 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// per transmitter statistics
+//
+// entries live in one flat array, found through a bucket array of chained indices, and are recycled
+// with the CLOCK algorithm once the array is full. nothing here locks, callers serialize access.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_devices.h"
+#include "cmd_wifi_mac.h"
+
+_Static_assert((DEVICES_BUCKETS & (DEVICES_BUCKETS - 1)) == 0, "DEVICES_BUCKETS must be a power of two");
+_Static_assert(DEVICES_CAPACITY < DEVICES_NONE, "DEVICES_CAPACITY must fit in a uint16_t index");
+
+static device_entry_t devices[DEVICES_CAPACITY];
+static uint16_t device_buckets[DEVICES_BUCKETS];
+static uint32_t device_entries;
+static uint32_t device_evicted;
+static uint32_t device_hand;
+static bool devices_initialized;
+
+/**
+ * Bucket for an address
+ * @param mac Mac address
+ * @return Bucket index
+ */
+static inline uint32_t devices_bucket(const uint8_t *mac)
+{
+    return (uint32_t)((mac_key(mac) * 0x9e3779b97f4a7c15ULL) >> 32) & (DEVICES_BUCKETS - 1);
+}
+
+/**
+ * Empties the table
+ */
+void devices_clear(void)
+{
+    for (int i = 0; i < DEVICES_BUCKETS; i++) {
+        device_buckets[i] = DEVICES_NONE;
+    }
+    device_entries = 0;
+    device_evicted = 0;
+    device_hand = 0;
+    devices_initialized = true;
+}
+
+/**
+ * Removes an entry from its bucket chain
+ * @param index Entry to unlink
+ */
+static void devices_unlink(uint16_t index)
+{
+    uint16_t *link = &device_buckets[devices_bucket(devices[index].mac)];
+    while (*link != DEVICES_NONE) {
+        if (*link == index) {
+            *link = devices[index].next;
+            return;
+        }
+        link = &devices[*link].next;
+    }
+}
+
+/**
+ * Picks an entry to reuse, giving every recently used entry a second chance
+ * @return Entry index
+ */
+static uint16_t devices_evict(void)
+{
+    while (devices[device_hand].referenced) {
+        devices[device_hand].referenced = 0;
+        device_hand = (device_hand + 1) % DEVICES_CAPACITY;
+    }
+
+    uint16_t victim = device_hand;
+    device_hand = (device_hand + 1) % DEVICES_CAPACITY;
+    devices_unlink(victim);
+    device_evicted++;
+    return victim;
+}
+
+/**
+ * Records a frame sent by an address
+ * @param mac Transmitter address
+ * @param frame_type Type from the frame control field
+ * @param rssi Signal strength
+ * @param channel Channel the frame was received on
+ * @param now_ms Receive time in milliseconds
+ */
+void devices_update(const uint8_t *mac, uint8_t frame_type, int8_t rssi, uint8_t channel, uint32_t now_ms)
+{
+    if (!devices_initialized) {
+        devices_clear();
+    }
+
+    uint32_t bucket = devices_bucket(mac);
+    uint16_t index = device_buckets[bucket];
+    while (index != DEVICES_NONE && memcmp(devices[index].mac, mac, MAC_LEN) != 0) {
+        index = devices[index].next;
+    }
+
+    device_entry_t *entry;
+    if (index == DEVICES_NONE) {
+        index = device_entries < DEVICES_CAPACITY ? device_entries++ : devices_evict();
+        entry = &devices[index];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->mac, mac, MAC_LEN);
+        entry->rssi_min = rssi;
+        entry->rssi_max = rssi;
+        entry->first_seen = now_ms;
+        entry->next = device_buckets[bucket];
+        device_buckets[bucket] = index;
+    } else {
+        entry = &devices[index];
+    }
+
+    entry->referenced = 1;
+    entry->frames[frame_type & (DEVICE_FRAME_TYPES - 1)]++;
+    entry->rssi_sum += rssi;
+    if (rssi < entry->rssi_min) {
+        entry->rssi_min = rssi;
+    }
+    if (rssi > entry->rssi_max) {
+        entry->rssi_max = rssi;
+    }
+    entry->last_channel = channel;
+    entry->last_seen = now_ms;
+}
+
+/**
+ * Records the transmitter of a raw 802.11 frame, frames without addr2 (ack, cts) are skipped
+ * @param frame Raw frame
+ * @param len Length of the frame
+ * @param rssi Signal strength
+ * @param channel Channel the frame was received on
+ * @param now_ms Receive time in milliseconds
+ */
+void devices_update_frame(const uint8_t *frame, uint16_t len, int8_t rssi, uint8_t channel, uint32_t now_ms)
+{
+    if (len < MAC_ADDR2_OFFSET + MAC_LEN) {
+        return;
+    }
+    devices_update(&frame[MAC_ADDR2_OFFSET], (frame[0] >> 2) & 0x3, rssi, channel, now_ms);
+}
+
+/**
+ * Returns the number of tracked transmitters
+ * @return Number of entries
+ */
+uint32_t devices_count(void)
+{
+    return device_entries;
+}
+
+/**
+ * Returns how many entries were recycled because the table was full
+ * @return Number of evictions
+ */
+uint32_t devices_evictions(void)
+{
+    return device_evicted;
+}
+
+/**
+ * Sums the frame counters of an entry
+ * @param entry Entry
+ * @return Frames of all types
+ */
+uint32_t device_total_frames(const device_entry_t *entry)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < DEVICE_FRAME_TYPES; i++) {
+        total += entry->frames[i];
+    }
+    return total;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+// sort comparators, busiest, strongest and most recent first
+//-------------------------------------------------------------------------------------------------------------------------
+static int compare_frames(const void *a, const void *b)
+{
+    uint32_t x = device_total_frames(a);
+    uint32_t y = device_total_frames(b);
+    return (x < y) - (x > y);
+}
+
+static int compare_rssi(const void *a, const void *b)
+{
+    const device_entry_t *x = a;
+    const device_entry_t *y = b;
+    int32_t ax = x->rssi_sum / (int32_t)device_total_frames(x);
+    int32_t ay = y->rssi_sum / (int32_t)device_total_frames(y);
+    return (ax < ay) - (ax > ay);
+}
+
+static int compare_last(const void *a, const void *b)
+{
+    uint32_t x = ((const device_entry_t *)a)->last_seen;
+    uint32_t y = ((const device_entry_t *)b)->last_seen;
+    return (x < y) - (x > y);
+}
+
+static int compare_first(const void *a, const void *b)
+{
+    uint32_t x = ((const device_entry_t *)a)->first_seen;
+    uint32_t y = ((const device_entry_t *)b)->first_seen;
+    return (x > y) - (x < y);
+}
+
+static int compare_mac(const void *a, const void *b)
+{
+    return memcmp(((const device_entry_t *)a)->mac, ((const device_entry_t *)b)->mac, MAC_LEN);
+}
+
+/**
+ * Copies the table out and sorts the copy
+ * @param out Where to copy the entries
+ * @param max Size of out in entries
+ * @param sort Sort key
+ * @return Number of entries copied
+ */
+size_t devices_snapshot(device_entry_t *out, size_t max, devices_sort_t sort)
+{
+    static int (*const comparators[])(const void *, const void *) = {
+        compare_frames,
+        compare_rssi,
+        compare_last,
+        compare_first,
+        compare_mac
+    };
+
+    size_t n = device_entries < max ? device_entries : max;
+    memcpy(out, devices, n * sizeof(device_entry_t));
+    if (sort < DEVICES_SORT_UNKNOWN) {
+        qsort(out, n, sizeof(device_entry_t), comparators[sort]);
+    }
+    return n;
+}
@@ -0,0 +1,83 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// fixed capacity transmitter table, bucket count must be a power of two
+//-------------------------------------------------------------------------------------------------------------------------
+#define DEVICES_CAPACITY 256
+#define DEVICES_BUCKETS 256
+#define DEVICES_NONE 0xffff
+
+// frame types as found in the frame control field
+#define DEVICE_FRAME_TYPES 4
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t last_channel;
+    uint8_t referenced;     /* CLOCK bit, set on every hit */
+    int8_t rssi_min;
+    int8_t rssi_max;
+    uint16_t next;          /* next entry in the same bucket */
+    int32_t rssi_sum;
+    uint32_t frames[DEVICE_FRAME_TYPES];
+    uint32_t first_seen;    /* ms */
+    uint32_t last_seen;     /* ms */
+} device_entry_t;
+
+typedef enum {
+    DEVICES_SORT_FRAMES,
+    DEVICES_SORT_RSSI,
+    DEVICES_SORT_LAST,
+    DEVICES_SORT_FIRST,
+    DEVICES_SORT_MAC,
+    DEVICES_SORT_UNKNOWN
+} devices_sort_t;
+
+void devices_clear(void);
+
+// records a frame sent by mac, evicting the least recently used entry when full
+void devices_update(const uint8_t *mac, uint8_t frame_type, int8_t rssi, uint8_t channel, uint32_t now_ms);
+
+// parses the transmitter out of a raw frame and records it
+void devices_update_frame(const uint8_t *frame, uint16_t len, int8_t rssi, uint8_t channel, uint32_t now_ms);
+
+uint32_t devices_count(void);
+uint32_t devices_evictions(void);
+uint32_t device_total_frames(const device_entry_t *entry);
+
+// copies the table out and sorts it, returns the number of entries copied
+size_t devices_snapshot(device_entry_t *out, size_t max, devices_sort_t sort);
+
+#ifdef __cplusplus
+}
+#endif
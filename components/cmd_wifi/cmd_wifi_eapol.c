@@ -0,0 +1,471 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// EAPOL handshake and PMKID extraction
+//
+// the pair table is small and searched linearly, the oldest pair is recycled when it fills. complete captures wait in a
+// short queue until the AP table has the ESSID, which is part of the salt. nothing here locks, callers serialize access
+// and hold the lock that covers the AP table.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_eapol.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_aps.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+//-------------------------------------------------------------------------------------------------------------------------
+// LLC/SNAP header of an 802.1X frame and the EAPOL-Key layout, offsets from the start of the EAPOL header
+//-------------------------------------------------------------------------------------------------------------------------
+static const uint8_t eapol_llc[8] = { 0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x88, 0x8e };
+
+#define EAPOL_TYPE_KEY 3
+#define EAPOL_DESC_RSN 2
+#define EAPOL_DESC_WPA 254
+
+#define KEY_DESC 4
+#define KEY_INFO 5
+#define KEY_REPLAY 9
+#define KEY_NONCE 17
+#define KEY_MIC 81
+#define KEY_DATA_LEN 97
+#define KEY_DATA 99
+
+#define KEY_INFO_VERSION 0x0007
+#define KEY_INFO_PAIRWISE 0x0008
+#define KEY_INFO_INSTALL 0x0040
+#define KEY_INFO_ACK 0x0080
+#define KEY_INFO_MIC 0x0100
+
+// PMKID key data encapsulation, vendor element with the 802.11 OUI and data type 4
+static const uint8_t pmkid_kde[4] = { 0x00, 0x0f, 0xac, 0x04 };
+
+//-------------------------------------------------------------------------------------------------------------------------
+// hashcat message pair values, which two messages a line was built from and which one the EAPOL frame is
+//-------------------------------------------------------------------------------------------------------------------------
+#define MESSAGE_PAIR_M12E2 0x00
+#define MESSAGE_PAIR_M32E2 0x02
+
+#define LINE_PMKID 1
+#define LINE_EAPOL 2
+
+// how many complete captures may wait for their ESSID
+#define EAPOL_READY 4
+
+typedef struct {
+    uint8_t ap[6];
+    uint8_t sta[6];
+    bool used;
+    bool have_m1;
+    bool have_m2;
+    uint32_t last_seen;     /* ms */
+    uint64_t m1_replay;
+    uint64_t m2_replay;
+    uint8_t anonce[EAPOL_NONCE_LEN];
+    uint8_t mic[EAPOL_MIC_LEN];
+    uint16_t eapol_len;
+    uint8_t eapol[EAPOL_FRAME_MAX];     /* message 2 with its MIC zeroed */
+} eapol_pair_t;
+
+typedef struct {
+    uint8_t kind;           /* LINE_* */
+    uint8_t message_pair;
+    uint8_t ap[6];
+    uint8_t sta[6];
+    uint8_t mic[EAPOL_MIC_LEN];         /* or the PMKID */
+    uint8_t anonce[EAPOL_NONCE_LEN];
+    uint16_t eapol_len;
+    uint8_t eapol[EAPOL_FRAME_MAX];
+    uint32_t fingerprint;   /* goes into eapol_seen once the line is produced */
+} eapol_ready_t;
+
+static eapol_pair_t eapol_pairs[EAPOL_PAIRS];
+static eapol_ready_t eapol_ready[EAPOL_READY];
+static uint32_t eapol_ready_count;  /* oldest first */
+static uint32_t eapol_seen[EAPOL_SEEN];
+static uint32_t eapol_seen_count;
+static eapol_stats_t eapol_stats;
+
+/**
+ * Forgets all pairs, queued captures and fingerprints
+ */
+void eapol_clear(void)
+{
+    memset(eapol_pairs, 0, sizeof(eapol_pairs));
+    eapol_ready_count = 0;
+    eapol_seen_count = 0;
+    memset(&eapol_stats, 0, sizeof(eapol_stats));
+}
+
+/**
+ * Reads a big endian value
+ * @param data First byte
+ * @param len Number of bytes, at most 8
+ * @return Value
+ */
+static uint64_t read_be(const uint8_t *data, int len)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < len; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/**
+ * Checks whether a buffer is all zeros
+ * @param data Buffer
+ * @param len Length
+ * @return True if every byte is zero
+ */
+static bool all_zero(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Folds bytes into an FNV-1a hash
+ * @param hash Hash so far
+ * @param data Bytes
+ * @param len Length
+ * @return Updated hash
+ */
+static uint32_t fnv_add(uint32_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Finds the pair for an AP and station, recycling the oldest pair if it isn't tracked yet
+ * @param ap AP address
+ * @param sta Station address
+ * @param now_ms Current time in ms
+ * @return Pair
+ */
+static eapol_pair_t *eapol_pair(const uint8_t *ap, const uint8_t *sta, uint32_t now_ms)
+{
+    eapol_pair_t *oldest = &eapol_pairs[0];
+    for (int i = 0; i < EAPOL_PAIRS; i++) {
+        eapol_pair_t *pair = &eapol_pairs[i];
+        if (pair->used && memcmp(pair->ap, ap, 6) == 0 && memcmp(pair->sta, sta, 6) == 0) {
+            pair->last_seen = now_ms;
+            return pair;
+        }
+        if (!pair->used) {
+            oldest = pair;
+        } else if (oldest->used && (int32_t)(pair->last_seen - oldest->last_seen) < 0) {
+            oldest = pair;
+        }
+    }
+
+    memset(oldest, 0, sizeof(*oldest));
+    memcpy(oldest->ap, ap, 6);
+    memcpy(oldest->sta, sta, 6);
+    oldest->used = true;
+    oldest->last_seen = now_ms;
+    return oldest;
+}
+
+/**
+ * Queues a complete capture unless an identical one was produced before or is already waiting
+ * @param ready Capture to queue, its fingerprint is filled in here
+ */
+static void eapol_queue(eapol_ready_t *ready)
+{
+    uint32_t hash = FNV_OFFSET;
+    hash = fnv_add(hash, &ready->kind, 1);
+    hash = fnv_add(hash, ready->ap, 6);
+    hash = fnv_add(hash, ready->sta, 6);
+    hash = fnv_add(hash, ready->mic, EAPOL_MIC_LEN);
+    if (ready->kind == LINE_EAPOL) {
+        hash = fnv_add(hash, ready->anonce, EAPOL_NONCE_LEN);
+    }
+
+    uint32_t remembered = eapol_seen_count < EAPOL_SEEN ? eapol_seen_count : EAPOL_SEEN;
+    for (uint32_t i = 0; i < remembered; i++) {
+        if (eapol_seen[i] == hash) {
+            eapol_stats.duplicates++;
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < eapol_ready_count; i++) {
+        if (eapol_ready[i].fingerprint == hash) {
+            eapol_stats.duplicates++;
+            return;
+        }
+    }
+    ready->fingerprint = hash;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // a full queue means ESSIDs aren't turning up, the capture that has waited longest gives way. it was never
+    // produced, so a retransmission of it can still be queued again
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (eapol_ready_count == EAPOL_READY) {
+        memmove(&eapol_ready[0], &eapol_ready[1], (EAPOL_READY - 1) * sizeof(eapol_ready_t));
+        eapol_ready_count--;
+        eapol_stats.dropped++;
+    }
+    eapol_ready[eapol_ready_count++] = *ready;
+}
+
+/**
+ * Looks for a PMKID in the key data of message 1, either as a KDE or in an RSN element
+ * @param data Key data
+ * @param len Key data length
+ * @return PMKID or NULL
+ */
+static const uint8_t *find_pmkid(const uint8_t *data, uint16_t len)
+{
+    wifi_ie_iter_t it;
+    uint8_t id;
+    uint8_t ie_len;
+    const uint8_t *ie;
+    wifi_ie_begin(&it, data, len);
+    while (wifi_ie_next(&it, &id, &ie_len, &ie)) {
+        if (id == WIFI_IE_VENDOR && ie_len >= 4 + EAPOL_PMKID_LEN && memcmp(ie, pmkid_kde, 4) == 0) {
+            return ie + 4;
+        }
+
+        if (id == WIFI_IE_RSN && ie_len >= 8) {
+            //-------------------------------------------------------------------------------------------------------------------------
+            // version, group cipher, pairwise and AKM suite lists, capabilities, then the PMKID list
+            //-------------------------------------------------------------------------------------------------------------------------
+            uint16_t pos = 6;
+            for (int list = 0; list < 2 && pos + 2 <= ie_len; list++) {
+                pos += 2 + 4 * (ie[pos] | (ie[pos + 1] << 8));
+            }
+            pos += 2;
+            if (pos + 2 + EAPOL_PMKID_LEN <= ie_len && (ie[pos] | (ie[pos + 1] << 8)) > 0) {
+                return ie + pos + 2;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Tracks an EAPOL-Key frame
+ * @param frame Frame, starting at the mac header
+ * @param len Captured length
+ * @param has_fcs Whether the frame ends with the FCS
+ * @param now_ms Current time in ms
+ */
+void eapol_update_frame(const uint8_t *frame, uint16_t len, bool has_fcs, uint32_t now_ms)
+{
+    wifi_frame_t wf;
+    if (!wifi_decode(frame, len, has_fcs, &wf) || wf.type != WIFI_TYPE_DATA || wf.protected_frame ||
+        wf.to_ds == wf.from_ds || wf.body_len < sizeof(eapol_llc) + KEY_DATA ||
+        memcmp(wf.body, eapol_llc, sizeof(eapol_llc)) != 0) {
+        return;
+    }
+
+    const uint8_t *eapol = wf.body + sizeof(eapol_llc);
+    uint16_t avail = wf.body_len - sizeof(eapol_llc);
+    uint32_t eapol_len = 4 + read_be(eapol + 2, 2);
+    if (eapol[1] != EAPOL_TYPE_KEY || eapol_len > avail || eapol_len < KEY_DATA ||
+        (eapol[KEY_DESC] != EAPOL_DESC_RSN && eapol[KEY_DESC] != EAPOL_DESC_WPA)) {
+        return;
+    }
+    eapol_stats.keys++;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only pairwise keys with an HMAC-MD5, HMAC-SHA1 or AES-CMAC MIC, the 16 byte MIC hashcat expects
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint16_t info = read_be(eapol + KEY_INFO, 2);
+    uint8_t version = info & KEY_INFO_VERSION;
+    uint16_t data_len = read_be(eapol + KEY_DATA_LEN, 2);
+    if (!(info & KEY_INFO_PAIRWISE) || version < 1 || version > 3 || data_len > eapol_len - KEY_DATA) {
+        return;
+    }
+
+    const uint8_t *ap = wf.from_ds ? wf.addr2 : wf.addr1;
+    const uint8_t *sta = wf.from_ds ? wf.addr1 : wf.addr2;
+    uint64_t replay = read_be(eapol + KEY_REPLAY, 8);
+    const uint8_t *nonce = eapol + KEY_NONCE;
+    bool ack = info & KEY_INFO_ACK;
+    bool mic = info & KEY_INFO_MIC;
+
+    eapol_ready_t ready;
+    memcpy(ready.ap, ap, 6);
+    memcpy(ready.sta, sta, 6);
+
+    if (ack && !mic) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // message 1, the ANonce and maybe a PMKID
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (!wf.from_ds || all_zero(nonce, EAPOL_NONCE_LEN)) {
+            return;
+        }
+        eapol_pair_t *pair = eapol_pair(ap, sta, now_ms);
+        memcpy(pair->anonce, nonce, EAPOL_NONCE_LEN);
+        pair->m1_replay = replay;
+        pair->have_m1 = true;
+
+        const uint8_t *pmkid = find_pmkid(eapol + KEY_DATA, data_len);
+        if (pmkid != NULL && !all_zero(pmkid, EAPOL_PMKID_LEN)) {
+            ready.kind = LINE_PMKID;
+            ready.message_pair = 0;
+            memcpy(ready.mic, pmkid, EAPOL_PMKID_LEN);
+            ready.eapol_len = 0;
+            eapol_queue(&ready);
+        }
+    } else if (!ack && mic && !(info & KEY_INFO_INSTALL) && data_len > 0 && !all_zero(nonce, EAPOL_NONCE_LEN)) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // message 2 carries the SNonce and the station's RSN element, message 4 has neither
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (!wf.to_ds || eapol_len > EAPOL_FRAME_MAX) {
+            return;
+        }
+        eapol_pair_t *pair = eapol_pair(ap, sta, now_ms);
+        memcpy(pair->mic, eapol + KEY_MIC, EAPOL_MIC_LEN);
+        memcpy(pair->eapol, eapol, eapol_len);
+        memset(pair->eapol + KEY_MIC, 0, EAPOL_MIC_LEN);
+        pair->eapol_len = eapol_len;
+        pair->m2_replay = replay;
+        pair->have_m2 = true;
+
+        if (pair->have_m1 && pair->m1_replay == replay) {
+            ready.kind = LINE_EAPOL;
+            ready.message_pair = MESSAGE_PAIR_M12E2;
+            memcpy(ready.mic, pair->mic, EAPOL_MIC_LEN);
+            memcpy(ready.anonce, pair->anonce, EAPOL_NONCE_LEN);
+            memcpy(ready.eapol, pair->eapol, eapol_len);
+            ready.eapol_len = eapol_len;
+            eapol_queue(&ready);
+        }
+    } else if (ack && mic && (info & KEY_INFO_INSTALL)) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // message 3 repeats the ANonce with the next replay counter, enough to pair it with a message 2 whose message 1
+        // was missed
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (!wf.from_ds) {
+            return;
+        }
+        eapol_pair_t *pair = eapol_pair(ap, sta, now_ms);
+        if (pair->have_m2 && replay == pair->m2_replay + 1) {
+            ready.kind = LINE_EAPOL;
+            ready.message_pair = MESSAGE_PAIR_M32E2;
+            memcpy(ready.mic, pair->mic, EAPOL_MIC_LEN);
+            memcpy(ready.anonce, nonce, EAPOL_NONCE_LEN);
+            memcpy(ready.eapol, pair->eapol, pair->eapol_len);
+            ready.eapol_len = pair->eapol_len;
+            eapol_queue(&ready);
+        }
+    }
+}
+
+/**
+ * Appends bytes as lowercase hex
+ * @param out Output position
+ * @param data Bytes
+ * @param len Length
+ * @return Position after the hex
+ */
+static char *put_hex(char *out, const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        *out++ = digits[data[i] >> 4];
+        *out++ = digits[data[i] & 0xf];
+    }
+    return out;
+}
+
+/**
+ * Writes the next capture whose ESSID is known as a hashcat 22000 line
+ * @param out Output buffer, EAPOL_LINE_MAX bytes is always enough
+ * @param size Size of the buffer
+ * @return True if a line was written
+ */
+bool eapol_next_line(char *out, size_t size)
+{
+    for (uint32_t slot = 0; slot < eapol_ready_count; slot++) {
+        const eapol_ready_t *ready = &eapol_ready[slot];
+        const ap_entry_t *ap = aps_find(ready->ap);
+        if (ap == NULL || ap->ssid_len == 0) {
+            continue;
+        }
+        if (size < EAPOL_LINE_MAX) {
+            return false;
+        }
+
+        char *pos = out;
+        memcpy(pos, ready->kind == LINE_PMKID ? "WPA*01*" : "WPA*02*", 7);
+        pos += 7;
+        pos = put_hex(pos, ready->mic, EAPOL_MIC_LEN);
+        *pos++ = '*';
+        pos = put_hex(pos, ready->ap, 6);
+        *pos++ = '*';
+        pos = put_hex(pos, ready->sta, 6);
+        *pos++ = '*';
+        pos = put_hex(pos, (const uint8_t *)ap->ssid, ap->ssid_len);
+        *pos++ = '*';
+        if (ready->kind == LINE_EAPOL) {
+            pos = put_hex(pos, ready->anonce, EAPOL_NONCE_LEN);
+            *pos++ = '*';
+            pos = put_hex(pos, ready->eapol, ready->eapol_len);
+            *pos++ = '*';
+            pos = put_hex(pos, &ready->message_pair, 1);
+            eapol_stats.handshakes++;
+        } else {
+            *pos++ = '*';
+            *pos++ = '*';
+            eapol_stats.pmkids++;
+        }
+        *pos = '\0';
+
+        eapol_seen[eapol_seen_count++ % EAPOL_SEEN] = ready->fingerprint;
+        eapol_ready_count--;
+        memmove(&eapol_ready[slot], &eapol_ready[slot + 1], (eapol_ready_count - slot) * sizeof(eapol_ready_t));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Copies out the counters
+ * @param stats Counters
+ */
+void eapol_get_stats(eapol_stats_t *stats)
+{
+    *stats = eapol_stats;
+    stats->pending = eapol_ready_count;
+}
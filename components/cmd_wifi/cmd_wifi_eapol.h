@@ -0,0 +1,73 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// WPA handshake and PMKID extraction in hashcat's 22000 format, for auditing networks you run
+//
+// EAPOL-Key frames are tracked per (AP, STA) pair. a line is produced once a pair holds something crackable and
+// verified by its replay counter: a PMKID from message 1, message 2 with the message 1 it answers (message pair 00),
+// or message 2 with the message 3 that follows it (message pair 02). lines wait until the AP table knows the ESSID
+// and are produced once per ANonce and MIC, or per PMKID.
+//-------------------------------------------------------------------------------------------------------------------------
+#define EAPOL_PAIRS 16
+#define EAPOL_SEEN 64               /* fingerprints of lines already produced */
+#define EAPOL_FRAME_MAX 255         /* longest EAPOL frame hashcat takes */
+#define EAPOL_NONCE_LEN 32
+#define EAPOL_MIC_LEN 16
+#define EAPOL_PMKID_LEN 16
+
+// longest line: fixed fields, 32 byte ESSID and a full EAPOL frame, all hex
+#define EAPOL_LINE_MAX (40 + 2 * (EAPOL_MIC_LEN + 6 + 6 + 32 + EAPOL_NONCE_LEN + EAPOL_FRAME_MAX))
+
+typedef struct {
+    uint32_t keys;          /* EAPOL-Key frames seen */
+    uint32_t pmkids;        /* PMKID lines produced */
+    uint32_t handshakes;    /* handshake lines produced */
+    uint32_t duplicates;    /* complete handshakes or PMKIDs dropped as already produced */
+    uint32_t dropped;       /* gave up waiting for the ESSID */
+    uint32_t pending;       /* waiting for the ESSID */
+} eapol_stats_t;
+
+void eapol_clear(void);
+
+// looks at a data frame, anything that isn't an unprotected EAPOL-Key frame is skipped on the first bytes
+void eapol_update_frame(const uint8_t *frame, uint16_t len, bool has_fcs, uint32_t now_ms);
+
+// writes the next ready 22000 line without a newline, returns false if none is ready
+bool eapol_next_line(char *out, size_t size);
+
+void eapol_get_stats(eapol_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
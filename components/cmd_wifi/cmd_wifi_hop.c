@@ -0,0 +1,441 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// channel hopping, a one shot esp_timer per dwell wakes the hop task which retunes and re-arms the timer
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 wifi libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_console.h"
+#include "esp_timer.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// other CLI related libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "argtable3/argtable3.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// freeRTOS libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_hop.h"
+#include "cmd_wifi_channel.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// hop task, above the capture task so a busy channel can't delay the next hop
+//-------------------------------------------------------------------------------------------------------------------------
+#define HOP_TASK_STACK 3072
+#define HOP_TASK_PRIORITY 6
+
+//-------------------------------------------------------------------------------------------------------------------------
+// adaptive dwell, quiet channels still get a slice as if they carried this many frames/s
+//-------------------------------------------------------------------------------------------------------------------------
+#define HOP_RATE_FLOOR 10
+#define HOP_MAX_DWELL_SCALE 4
+
+typedef struct {
+    uint32_t frames;        /* frames seen on this channel */
+    uint64_t dwell_us;      /* time spent on this channel */
+    uint32_t rate;          /* moving average of frames/s */
+    uint32_t last_dwell_ms; /* dwell used on the last visit */
+} hop_channel_stats_t;
+
+static hop_config_t hop_config;
+static hop_channel_stats_t hop_stats[HOP_MAX_CHANNELS];
+static esp_timer_handle_t hop_timer;
+static TaskHandle_t hop_task;
+static volatile bool hopping;
+static volatile uint32_t hop_frames;
+static uint8_t hop_index;
+static int64_t hop_started;
+static int64_t hop_dwell_start;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// time spent retuning since hopping started
+//-------------------------------------------------------------------------------------------------------------------------
+static uint32_t hop_count;
+static uint64_t hop_latency_total;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for hop command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_str *channels;
+    struct arg_str *dwell;
+    struct arg_lit *adaptive;
+    struct arg_lit *stop;
+    struct arg_lit *status;
+    struct arg_end *end;
+} hop_args;
+
+/**
+ * Works out how long to stay on a channel
+ * @param i Index into the channel list
+ * @return Dwell in milliseconds
+ */
+static uint32_t hop_dwell_ms(int i)
+{
+    if (!hop_config.adaptive) {
+        return hop_config.dwell_ms[i];
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // split the configured cycle time in proportion to recent traffic
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint64_t budget = 0;
+    uint64_t weight_sum = 0;
+    for (int j = 0; j < hop_config.count; j++) {
+        budget += hop_config.dwell_ms[j];
+        weight_sum += hop_stats[j].rate + HOP_RATE_FLOOR;
+    }
+
+    uint64_t dwell = budget * (hop_stats[i].rate + HOP_RATE_FLOOR) / weight_sum;
+    uint64_t max_dwell = (uint64_t)hop_config.dwell_ms[i] * HOP_MAX_DWELL_SCALE;
+    if (dwell < HOP_MIN_DWELL_MS) {
+        dwell = HOP_MIN_DWELL_MS;
+    }
+    if (dwell > max_dwell) {
+        dwell = max_dwell;
+    }
+    return (uint32_t)dwell;
+}
+
+/**
+ * Tunes the radio and records how long it took
+ * @param channel Channel to tune to
+ */
+static void hop_retune(uint8_t channel)
+{
+    uint32_t latency;
+    channel_retune(channel, &latency);
+
+    hop_count++;
+    hop_latency_total += latency;
+}
+
+/**
+ * Closes the books on the current channel and moves to the next one
+ */
+static void hop_next(void)
+{
+    int64_t now = esp_timer_get_time();
+    hop_channel_stats_t *stats = &hop_stats[hop_index];
+
+    uint32_t frames = hop_frames;
+    hop_frames = 0;
+    uint64_t dwell = now - hop_dwell_start;
+
+    stats->frames += frames;
+    stats->dwell_us += dwell;
+    if (dwell > 0) {
+        uint32_t rate = (uint32_t)((uint64_t)frames * 1000000 / dwell);
+        stats->rate = (stats->rate * 3 + rate) / 4;
+    }
+
+    hop_index = (hop_index + 1) % hop_config.count;
+    hop_retune(hop_config.channels[hop_index]);
+    hop_dwell_start = esp_timer_get_time();
+
+    uint32_t next = hop_dwell_ms(hop_index);
+    hop_stats[hop_index].last_dwell_ms = next;
+    esp_timer_start_once(hop_timer, (uint64_t)next * 1000);
+}
+
+/**
+ * Hop task, woken by the dwell timer
+ * @param arg Unused
+ */
+static void hop_task_main(void *arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (hopping) {
+            hop_next();
+        }
+    }
+}
+
+/**
+ * Dwell timer callback, runs in the esp_timer task so it only wakes the hop task
+ * @param arg Unused
+ */
+static void hop_timer_cb(void *arg)
+{
+    xTaskNotifyGive(hop_task);
+}
+
+/**
+ * Counts a frame against the channel we're dwelling on
+ */
+void hop_note_frame(void)
+{
+    hop_frames++;
+}
+
+/**
+ * Returns whether channel hopping is running
+ * @return Whether we're hopping
+ */
+bool hop_active(void)
+{
+    return hopping;
+}
+
+/**
+ * Starts hopping over a channel list
+ * @param config Channels and dwell times
+ * @return ESP_OK on success
+ */
+esp_err_t hop_start(const hop_config_t *config)
+{
+    if (config->count == 0 || config->count > HOP_MAX_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (hop_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = &hop_timer_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "hop",
+            .skip_unhandled_events = true
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &hop_timer);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (hop_task == NULL) {
+        if (xTaskCreate(&hop_task_main, "hop", HOP_TASK_STACK, NULL, HOP_TASK_PRIORITY, &hop_task) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    hop_stop();
+
+    hop_config = *config;
+    memset(hop_stats, 0, sizeof(hop_stats));
+    hop_count = 0;
+    hop_latency_total = 0;
+    channel_retune_reset_stats();
+    hop_index = 0;
+    hop_frames = 0;
+
+    hop_retune(hop_config.channels[0]);
+    hop_started = esp_timer_get_time();
+    hop_dwell_start = hop_started;
+    hop_stats[0].last_dwell_ms = hop_dwell_ms(0);
+    hopping = true;
+
+    return esp_timer_start_once(hop_timer, (uint64_t)hop_stats[0].last_dwell_ms * 1000);
+}
+
+/**
+ * Stops hopping, the radio stays on whatever channel it was on
+ */
+void hop_stop(void)
+{
+    hopping = false;
+    if (hop_timer != NULL && esp_timer_is_active(hop_timer)) {
+        esp_timer_stop(hop_timer);
+    }
+}
+
+/**
+ * Prints per channel traffic and retune latency
+ */
+void hop_print_status(void)
+{
+    printf("Hopping: %s\n", hopping ? "yes" : "no");
+    if (hop_config.count == 0) {
+        return;
+    }
+
+    printf("Channel\tFrames\tTime (ms)\tFrames/s\tDwell (ms)\n");
+    for (int i = 0; i < hop_config.count; i++) {
+        printf("%i%s\t%"PRIu32"\t%"PRIu64"\t\t%"PRIu32"\t\t%"PRIu32"\n",
+               hop_config.channels[i], hopping && i == hop_index ? "*" : "",
+               hop_stats[i].frames, hop_stats[i].dwell_us / 1000, hop_stats[i].rate, hop_stats[i].last_dwell_ms);
+    }
+
+    if (hop_count > 0) {
+        retune_stats_t stats;
+        channel_retune_get_stats(&stats);
+
+        int64_t elapsed = esp_timer_get_time() - hop_started;
+        printf("Retunes: %"PRIu32", latency min/median/max %"PRIu32"/%"PRIu32"/%"PRIu32" us\n",
+               hop_count, stats.min_us, stats.median_us, stats.max_us);
+        if (elapsed > 0) {
+            printf("Capture time lost to retuning: %.2f%%\n", hop_latency_total * 100.0 / elapsed);
+        }
+    }
+}
+
+/**
+ * Parses a channel list such as 1,6,11 or 1-13
+ * @param input List to parse
+ * @param config Where to store the channels
+ * @return Whether the list was valid
+ */
+static bool parse_channels(const char *input, hop_config_t *config)
+{
+    config->count = 0;
+    while (*input != '\0') {
+        char *end;
+        long first = strtol(input, &end, 10);
+        long last = first;
+        if (*end == '-') {
+            last = strtol(end + 1, &end, 10);
+        }
+        if (end == input || first < 1 || last > 13 || first > last) {
+            return false;
+        }
+        for (long ch = first; ch <= last; ch++) {
+            if (config->count >= HOP_MAX_CHANNELS) {
+                return false;
+            }
+            config->channels[config->count++] = (uint8_t)ch;
+        }
+
+        input = end;
+        if (*input == ',') {
+            input++;
+        } else if (*input != '\0') {
+            return false;
+        }
+    }
+    return config->count > 0;
+}
+
+/**
+ * Parses a dwell time, or one dwell time per channel
+ * @param input Dwell list in milliseconds
+ * @param config Channel list the dwell times belong to
+ * @return Whether the list was valid
+ */
+static bool parse_dwell(const char *input, hop_config_t *config)
+{
+    uint32_t dwell[HOP_MAX_CHANNELS];
+    int count = 0;
+    while (*input != '\0' && count < HOP_MAX_CHANNELS) {
+        char *end;
+        long ms = strtol(input, &end, 10);
+        if (end == input || ms < HOP_MIN_DWELL_MS) {
+            return false;
+        }
+        dwell[count++] = (uint32_t)ms;
+        input = *end == ',' ? end + 1 : end;
+    }
+
+    if (count != 1 && count != config->count) {
+        return false;
+    }
+    for (int i = 0; i < config->count; i++) {
+        config->dwell_ms[i] = count == 1 ? dwell[0] : dwell[i];
+    }
+    return true;
+}
+
+/**
+ * Starts, stops or reports on channel hopping
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+static int hop_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&hop_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, hop_args.end, argv[0]);
+        return 1;
+    }
+
+    if (hop_args.stop->count > 0) {
+        hop_stop();
+        printf("Stopped hopping\n");
+        return 0;
+    }
+
+    if (hop_args.status->count > 0) {
+        hop_print_status();
+        return 0;
+    }
+
+    hop_config_t config = { .count = 0, .adaptive = hop_args.adaptive->count > 0 };
+    if (!parse_channels(hop_args.channels->count > 0 ? hop_args.channels->sval[0] : "1-13", &config)) {
+        printf("Invalid channel list, expected e.g. 1,6,11 or 1-13\n");
+        return 1;
+    }
+
+    for (int i = 0; i < config.count; i++) {
+        config.dwell_ms[i] = HOP_DEFAULT_DWELL_MS;
+    }
+    if (hop_args.dwell->count > 0 && !parse_dwell(hop_args.dwell->sval[0], &config)) {
+        printf("Invalid dwell, give one time or one per channel, each at least %i ms\n", HOP_MIN_DWELL_MS);
+        return 1;
+    }
+
+    esp_err_t err = hop_start(&config);
+    if (err != ESP_OK) {
+        printf("Failed to start hopping: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    printf("Hopping over %i channel(s)%s\n", config.count, config.adaptive ? " with adaptive dwell" : "");
+    return 0;
+}
+
+void register_hop(void)
+{
+    hop_args.channels = arg_str0(NULL, "channels", "<list>", "Channels to hop over, e.g. 1,6,11 or 1-13 (default 1-13)");
+    hop_args.dwell = arg_str0(NULL, "dwell", "<ms>", "Dwell time in ms, or one per channel, e.g. 300,100,100 (default 250)");
+    hop_args.adaptive = arg_lit0(NULL, "adaptive", "Weight dwell time by recent traffic on each channel");
+    hop_args.stop = arg_lit0(NULL, "stop", "Stop hopping");
+    hop_args.status = arg_lit0(NULL, "status", "Print per channel traffic and retune latency");
+    hop_args.end = arg_end(5);
+
+    const esp_console_cmd_t hop_cmd_def = {
+        .command = "hop",
+        .help = "Hops over a list of channels with a dwell time per channel",
+        .hint = NULL,
+        .func = &hop_cmd,
+        .argtable = &hop_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&hop_cmd_def));
+}
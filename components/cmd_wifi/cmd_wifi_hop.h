@@ -0,0 +1,58 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOP_MAX_CHANNELS 13
+#define HOP_DEFAULT_DWELL_MS 250
+#define HOP_MIN_DWELL_MS 20
+
+typedef struct {
+    uint8_t count;
+    uint8_t channels[HOP_MAX_CHANNELS];
+    uint32_t dwell_ms[HOP_MAX_CHANNELS];
+    bool adaptive;      /* scale dwell by recent traffic on each channel */
+} hop_config_t;
+
+esp_err_t hop_start(const hop_config_t *config);
+void hop_stop(void);
+bool hop_active(void);
+void hop_print_status(void);
+
+// called from the rx callback for every frame while hopping
+void hop_note_frame(void);
+
+// registers the hop command
+void register_hop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,209 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// activity LED
+//
+// the pin is configured once, the rx callback never touches gpio. it only bumps two counters and a periodic timer
+// compares them with what it saw on the previous tick.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdatomic.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_led.h"
+
+// written by the rx callback only, read by the timer
+static atomic_uint led_frames;
+static atomic_uint led_hits;
+static atomic_uint led_alerts;
+
+// timer state
+static esp_timer_handle_t led_timer;
+static unsigned led_seen_frames;
+static unsigned led_seen_hits;
+static unsigned led_seen_alerts;
+static uint8_t led_phase;
+static uint8_t led_hit_tick;
+static uint8_t led_alert_tick;
+static bool led_level;
+
+/**
+ * Sets the LED only when the level changes
+ * @param level Level to set
+ */
+static void led_set(bool level)
+{
+    if (level != led_level) {
+        gpio_set_level(LED_PIN, level);
+        led_level = level;
+    }
+}
+
+/**
+ * Timer callback, picks the LED level for the next tick
+ * @param arg Unused
+ */
+static void led_timer_cb(void *arg)
+{
+    unsigned frames = atomic_load_explicit(&led_frames, memory_order_relaxed);
+    unsigned hits = atomic_load_explicit(&led_hits, memory_order_relaxed);
+    unsigned new_frames = frames - led_seen_frames;
+    unsigned new_hits = hits - led_seen_hits;
+    led_seen_frames = frames;
+    led_seen_hits = hits;
+
+    unsigned alerts = atomic_load_explicit(&led_alerts, memory_order_relaxed);
+    if (alerts != led_seen_alerts) {
+        led_seen_alerts = alerts;
+        led_alert_tick = LED_ALERT_TICKS;
+    }
+    if (led_alert_tick > 0) {
+        led_alert_tick--;
+        led_set(led_alert_tick & 1);
+        return;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // a hit starts the hit pattern unless one is already playing, it wins over activity
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (new_hits > 0 && led_hit_tick == 0) {
+        led_hit_tick = LED_HIT_TICKS;
+    }
+    if (led_hit_tick > 0) {
+        led_hit_tick--;
+        led_set((LED_HIT_PATTERN >> (LED_HIT_TICKS - 1 - led_hit_tick)) & 1);
+        return;
+    }
+
+    if (new_frames == 0) {
+        led_set(false);
+        return;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // every doubling of the frame rate halves the toggle interval
+    //-------------------------------------------------------------------------------------------------------------------------
+    unsigned shift = 31 - __builtin_clz(new_frames);
+    unsigned interval = shift < 3 ? LED_SLOW_TICKS >> shift : 1;
+    if (++led_phase >= interval) {
+        led_phase = 0;
+        led_set(!led_level);
+    }
+}
+
+/**
+ * Configures the LED pin and creates the blink timer
+ * @return ESP_OK on success
+ */
+esp_err_t led_init(void)
+{
+    const gpio_config_t config = {
+        .pin_bit_mask = 1ULL << LED_PIN,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    esp_err_t err = gpio_config(&config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    gpio_set_level(LED_PIN, 0);
+    led_level = false;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &led_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "led",
+        .skip_unhandled_events = true
+    };
+    return esp_timer_create(&timer_args, &led_timer);
+}
+
+/**
+ * Starts blinking
+ */
+void led_start(void)
+{
+    if (led_timer == NULL) {
+        return;
+    }
+    led_seen_frames = atomic_load_explicit(&led_frames, memory_order_relaxed);
+    led_seen_hits = atomic_load_explicit(&led_hits, memory_order_relaxed);
+    led_seen_alerts = atomic_load_explicit(&led_alerts, memory_order_relaxed);
+    led_phase = 0;
+    led_hit_tick = 0;
+    led_alert_tick = 0;
+    esp_timer_stop(led_timer);
+    esp_timer_start_periodic(led_timer, LED_TICK_MS * 1000);
+}
+
+/**
+ * Stops blinking and turns the LED off
+ */
+void led_stop(void)
+{
+    if (led_timer == NULL) {
+        return;
+    }
+    esp_timer_stop(led_timer);
+    gpio_set_level(LED_PIN, 0);
+    led_level = false;
+}
+
+/**
+ * Counts a received frame
+ */
+void led_note_frame(void)
+{
+    atomic_store_explicit(&led_frames, atomic_load_explicit(&led_frames, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/**
+ * Counts a frame that passed the filter
+ */
+void led_note_hit(void)
+{
+    atomic_store_explicit(&led_hits, atomic_load_explicit(&led_hits, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/**
+ * Counts a flood detector event
+ */
+void led_note_alert(void)
+{
+    atomic_store_explicit(&led_alerts, atomic_load_explicit(&led_alerts, memory_order_relaxed) + 1, memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// activity LED, the rx path only bumps counters and a timer turns them into a blink pattern
+//
+// activity: the LED toggles faster as the frame rate goes up, from every LED_SLOW_TICKS ticks down to every tick
+// hits:     frames that passed the filter expression or watchlist play LED_HIT_PATTERN instead, one bit per tick
+// alerts:   a flood detector event strobes the LED every tick for LED_ALERT_TICKS, over everything else
+//-------------------------------------------------------------------------------------------------------------------------
+#define LED_PIN 7
+#define LED_TICK_MS 25
+#define LED_SLOW_TICKS 8
+#define LED_HIT_PATTERN 0x1b    /* on, on, off, on, on: a double flash */
+#define LED_HIT_TICKS 6
+#define LED_ALERT_TICKS 40
+
+// configures the pin and creates the timer, called once at startup
+esp_err_t led_init(void);
+
+// starts and stops blinking with a capture session, the LED is left off when stopped
+void led_start(void);
+void led_stop(void);
+
+// called from the rx callback, single producer
+void led_note_frame(void);
+void led_note_hit(void);
+void led_note_alert(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAC_LEN 6
+#define MAC_STR_LEN 18
+
+//-------------------------------------------------------------------------------------------------------------------------
+// offsets of the addresses in the 802.11 mac header
+//-------------------------------------------------------------------------------------------------------------------------
+#define MAC_ADDR1_OFFSET 4
+#define MAC_ADDR2_OFFSET 10
+#define MAC_ADDR3_OFFSET 16
+
+/**
+ * Packs a mac address into the low 48 bits of an integer so it can be compared in one go
+ * @param mac Mac address, no alignment required
+ * @return Packed address
+ */
+static inline uint64_t mac_key(const uint8_t *mac)
+{
+    uint64_t key = 0;
+    memcpy(&key, mac, MAC_LEN);
+    return key;
+}
+
+/**
+ * Parses a mac address in aa:bb:cc:dd:ee:ff form
+ * @param str String to parse
+ * @param mac Where to store the address
+ * @return Whether the string was a valid address
+ */
+static inline bool mac_parse(const char *str, uint8_t *mac)
+{
+    unsigned int b[MAC_LEN];
+    char tail;
+    if (sscanf(str, "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != MAC_LEN) {
+        return false;
+    }
+
+    for (int i = 0; i < MAC_LEN; i++) {
+        mac[i] = (uint8_t)b[i];
+    }
+    return true;
+}
+
+/**
+ * Formats a mac address
+ * @param str Buffer of at least MAC_STR_LEN bytes
+ * @param mac Mac address
+ */
+static inline void mac_format(char *str, const uint8_t *mac)
+{
+    snprintf(str, MAC_STR_LEN, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,236 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// watchlist of mac addresses, stored in an open addressing hash set keyed on the packed 48 bit address
+//
+// the set is only written while the sniffer is stopped, the rx callback just reads it
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// nvs libraries, the host build has no nvs and only loads watchlists from files
+//-------------------------------------------------------------------------------------------------------------------------
+#ifdef ESP_PLATFORM
+#include "nvs.h"
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_maclist.h"
+#include "cmd_wifi_mac.h"
+
+_Static_assert((MACLIST_CAPACITY & (MACLIST_CAPACITY - 1)) == 0, "MACLIST_CAPACITY must be a power of two");
+
+// packed addresses only use 48 bits, so this can never collide with a real key
+#define MACLIST_EMPTY UINT64_MAX
+
+static uint64_t maclist_slots[MACLIST_CAPACITY];
+static uint32_t maclist_entries;
+static bool maclist_initialized;
+
+/**
+ * Fibonacci hash of a packed address
+ * @param key Packed address
+ * @return Slot index
+ */
+static inline uint32_t maclist_hash(uint64_t key)
+{
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (MACLIST_CAPACITY - 1);
+}
+
+/**
+ * Empties the watchlist
+ */
+void maclist_clear(void)
+{
+    for (int i = 0; i < MACLIST_CAPACITY; i++) {
+        maclist_slots[i] = MACLIST_EMPTY;
+    }
+    maclist_entries = 0;
+    maclist_initialized = true;
+}
+
+/**
+ * Adds an address to the watchlist, duplicates are ignored
+ * @param mac Mac address
+ * @return False if the watchlist is full
+ */
+bool maclist_add(const uint8_t *mac)
+{
+    if (!maclist_initialized) {
+        maclist_clear();
+    }
+
+    uint64_t key = mac_key(mac);
+    uint32_t i = maclist_hash(key);
+
+    while (maclist_slots[i] != MACLIST_EMPTY) {
+        if (maclist_slots[i] == key) {
+            return true;
+        }
+        i = (i + 1) & (MACLIST_CAPACITY - 1);
+    }
+
+    if (maclist_entries >= MACLIST_MAX_ENTRIES) {
+        return false;
+    }
+
+    maclist_slots[i] = key;
+    maclist_entries++;
+    return true;
+}
+
+/**
+ * Looks up a packed address, safe to call from the rx callback
+ * @param key Packed address
+ * @return Whether the address is on the watchlist
+ */
+bool maclist_contains(uint64_t key)
+{
+    if (maclist_entries == 0) {
+        return false;
+    }
+
+    uint32_t i = maclist_hash(key);
+    while (maclist_slots[i] != MACLIST_EMPTY) {
+        if (maclist_slots[i] == key) {
+            return true;
+        }
+        i = (i + 1) & (MACLIST_CAPACITY - 1);
+    }
+    return false;
+}
+
+/**
+ * Returns the number of addresses on the watchlist
+ * @return Number of addresses
+ */
+uint32_t maclist_count(void)
+{
+    return maclist_entries;
+}
+
+/**
+ * Loads addresses from a text file, one per line, blank lines and lines starting with # are skipped
+ * @param path File to read, usually on the /data mount
+ * @return Number of addresses added or -1 on error
+ */
+int maclist_load_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("Failed to open %s\n", path);
+        return -1;
+    }
+
+    char line[64];
+    int added = 0;
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_no++;
+
+        char *start = line;
+        while (isspace((unsigned char)*start)) {
+            start++;
+        }
+        char *end = start + strlen(start);
+        while (end > start && isspace((unsigned char)end[-1])) {
+            *--end = '\0';
+        }
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+
+        uint8_t mac[MAC_LEN];
+        if (!mac_parse(start, mac)) {
+            printf("%s:%i: invalid MAC address: %s\n", path, line_no, start);
+            continue;
+        }
+        if (!maclist_add(mac)) {
+            printf("Watchlist full, stopped at %s:%i\n", path, line_no);
+            break;
+        }
+        added++;
+    }
+
+    fclose(f);
+    return added;
+}
+
+#ifdef ESP_PLATFORM
+/**
+ * Loads addresses from an nvs blob of packed 6 byte addresses
+ * @param key Blob key in the MACLIST_NVS_NAMESPACE namespace
+ * @return Number of addresses added or -1 on error
+ */
+int maclist_load_nvs(const char *key)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(MACLIST_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        printf("Failed to open nvs namespace %s: %s\n", MACLIST_NVS_NAMESPACE, esp_err_to_name(err));
+        return -1;
+    }
+
+    size_t len = 0;
+    err = nvs_get_blob(nvs, key, NULL, &len);
+    if (err != ESP_OK || len % MAC_LEN != 0) {
+        printf("No valid watchlist blob under %s\n", key);
+        nvs_close(nvs);
+        return -1;
+    }
+
+    uint8_t *blob = malloc(len);
+    if (blob == NULL) {
+        nvs_close(nvs);
+        return -1;
+    }
+    err = nvs_get_blob(nvs, key, blob, &len);
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        free(blob);
+        return -1;
+    }
+
+    int added = 0;
+    for (size_t off = 0; off < len; off += MAC_LEN) {
+        if (!maclist_add(&blob[off])) {
+            printf("Watchlist full, stopped after %i addresses\n", added);
+            break;
+        }
+        added++;
+    }
+
+    free(blob);
+    return added;
+}
+#endif // ESP_PLATFORM
@@ -0,0 +1,55 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// open addressing table, kept at most half full so probe chains stay short
+//-------------------------------------------------------------------------------------------------------------------------
+#define MACLIST_CAPACITY 1024
+#define MACLIST_MAX_ENTRIES (MACLIST_CAPACITY / 2)
+
+// nvs namespace watchlist blobs are read from
+#define MACLIST_NVS_NAMESPACE "sniffer"
+
+void maclist_clear(void);
+bool maclist_add(const uint8_t *mac);
+bool maclist_contains(uint64_t key);
+uint32_t maclist_count(void);
+
+// loaders, return the number of addresses added or -1 on error
+int maclist_load_file(const char *path);
+#ifdef ESP_PLATFORM
+int maclist_load_nvs(const char *key);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,245 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// streams captured frames as a libpcap file with radiotap headers, so the console output can be
+// piped straight into wireshark or tcpdump
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#if defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+#include "driver/usb_serial_jtag_vfs.h"
+#elif defined(CONFIG_ESP_CONSOLE_UART_DEFAULT) || defined(CONFIG_ESP_CONSOLE_UART_CUSTOM)
+#include "driver/uart_vfs.h"
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_pcap.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// radiotap fields we fill in, see https://www.radiotap.org/fields/defined
+//-------------------------------------------------------------------------------------------------------------------------
+#define RADIOTAP_TSFT 0
+#define RADIOTAP_FLAGS 1
+#define RADIOTAP_RATE 2
+#define RADIOTAP_CHANNEL 3
+#define RADIOTAP_DBM_ANTSIGNAL 5
+#define RADIOTAP_DBM_ANTNOISE 6
+
+#define RADIOTAP_F_FCS 0x10
+#define RADIOTAP_CHAN_2GHZ 0x0080
+
+//-------------------------------------------------------------------------------------------------------------------------
+// legacy rates from wifi_phy_rate_t in 500 kbps units, anything above 0x0f is HT/HE and has no legacy rate
+//-------------------------------------------------------------------------------------------------------------------------
+static const uint8_t legacy_rates[16] = {
+    2, 4, 11, 22, 0, 4, 11, 22, 96, 48, 24, 12, 108, 72, 36, 18
+};
+
+//-------------------------------------------------------------------------------------------------------------------------
+// rx_ctrl.timestamp is a 32 bit microsecond counter, track wraps so the capture stays monotonic
+//-------------------------------------------------------------------------------------------------------------------------
+static uint32_t last_timestamp;
+static uint64_t timestamp_high;
+
+// log level in effect before the stream silenced logging, "*" reads back as the default level
+static esp_log_level_t saved_log_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+/**
+ * Sets the console line endings
+ * @param binary Whether LF translation should be disabled
+ */
+void console_set_binary(bool binary)
+{
+#if defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+    usb_serial_jtag_vfs_set_tx_line_endings(binary ? ESP_LINE_ENDINGS_LF : ESP_LINE_ENDINGS_CRLF);
+#elif defined(CONFIG_ESP_CONSOLE_UART_DEFAULT) || defined(CONFIG_ESP_CONSOLE_UART_CUSTOM)
+    uart_vfs_dev_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM, binary ? ESP_LINE_ENDINGS_LF : ESP_LINE_ENDINGS_CRLF);
+#endif
+}
+
+/**
+ * Prepares the console for a binary stream
+ */
+void pcap_begin(void)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // any log line would corrupt the stream
+    //-------------------------------------------------------------------------------------------------------------------------
+    saved_log_level = esp_log_level_get("*");
+    esp_log_level_set("*", ESP_LOG_NONE);
+    fflush(stdout);
+    console_set_binary(true);
+    pcap_reset_clock();
+}
+
+/**
+ * Restarts timestamp wrap tracking
+ */
+void pcap_reset_clock(void)
+{
+    last_timestamp = 0;
+    timestamp_high = 0;
+}
+
+/**
+ * Returns the console to text output and logging to the level it had before the stream
+ */
+void pcap_end(void)
+{
+    fflush(stdout);
+    console_set_binary(false);
+    esp_log_level_set("*", saved_log_level);
+}
+
+/**
+ * Fills in the libpcap global header
+ * @param header Header to fill
+ */
+void pcap_fill_global_header(pcap_global_header_t *header)
+{
+    header->magic = PCAP_MAGIC;
+    header->version_major = PCAP_VERSION_MAJOR;
+    header->version_minor = PCAP_VERSION_MINOR;
+    header->thiszone = 0;
+    header->sigfigs = 0;
+    header->snaplen = RADIOTAP_MAX_LEN + SNIFFER_SLOT_PAYLOAD;
+    header->network = LINKTYPE_IEEE802_11_RADIOTAP;
+}
+
+/**
+ * Writes the libpcap global header
+ */
+void pcap_write_global_header(void)
+{
+    pcap_global_header_t header;
+    pcap_fill_global_header(&header);
+
+    fwrite(&header, sizeof(header), 1, stdout);
+    fflush(stdout);
+}
+
+/**
+ * Builds the radiotap header for a frame
+ * @param out Buffer of at least RADIOTAP_MAX_LEN bytes
+ * @param rx_ctrl Metadata from the driver
+ * @return Length of the header
+ */
+uint16_t pcap_build_radiotap(uint8_t *out, const wifi_pkt_rx_ctrl_t *rx_ctrl)
+{
+    uint32_t present = (1 << RADIOTAP_TSFT) | (1 << RADIOTAP_FLAGS) | (1 << RADIOTAP_CHANNEL) |
+                       (1 << RADIOTAP_DBM_ANTSIGNAL) | (1 << RADIOTAP_DBM_ANTNOISE);
+    uint8_t rate = rx_ctrl->rate < sizeof(legacy_rates) ? legacy_rates[rx_ctrl->rate] : 0;
+    if (rate != 0) {
+        present |= 1 << RADIOTAP_RATE;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // fields are little endian and naturally aligned, the 8 byte header keeps tsft aligned
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint16_t len = 8;
+    uint64_t tsft = rx_ctrl->timestamp;
+    memcpy(&out[len], &tsft, sizeof(tsft));
+    len += sizeof(tsft);
+
+    out[len++] = RADIOTAP_F_FCS;
+    if (rate != 0) {
+        out[len++] = rate;
+    } else {
+        out[len++] = 0; /* padding to align channel */
+    }
+
+    uint8_t channel = rx_ctrl->channel;
+    uint16_t freq = channel == 14 ? 2484 : 2407 + 5 * channel;
+    uint16_t chan_flags = RADIOTAP_CHAN_2GHZ;
+    memcpy(&out[len], &freq, sizeof(freq));
+    len += sizeof(freq);
+    memcpy(&out[len], &chan_flags, sizeof(chan_flags));
+    len += sizeof(chan_flags);
+
+    out[len++] = (uint8_t)(int8_t)rx_ctrl->rssi;
+    out[len++] = (uint8_t)(int8_t)rx_ctrl->noise_floor;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // fixed header last now that the length is known
+    //-------------------------------------------------------------------------------------------------------------------------
+    out[0] = 0; /* version */
+    out[1] = 0; /* padding */
+    memcpy(&out[2], &len, sizeof(len));
+    memcpy(&out[4], &present, sizeof(present));
+
+    return len;
+}
+
+/**
+ * Encodes one pcap record for a captured frame
+ * @param frame Frame taken from the ring
+ * @param out Buffer of at least PCAP_RECORD_MAX bytes
+ * @return Length of the record
+ */
+uint16_t pcap_encode_frame(const sniffer_frame_t *frame, uint8_t *out)
+{
+    uint8_t *radiotap = out + sizeof(pcap_record_header_t);
+    uint16_t radiotap_len = pcap_build_radiotap(radiotap, &frame->rx_ctrl);
+
+    uint32_t timestamp = frame->rx_ctrl.timestamp;
+    if (timestamp < last_timestamp) {
+        timestamp_high += 1ULL << 32;
+    }
+    last_timestamp = timestamp;
+    uint64_t us = timestamp_high | timestamp;
+
+    const pcap_record_header_t record = {
+        .ts_sec = (uint32_t)(us / 1000000),
+        .ts_usec = (uint32_t)(us % 1000000),
+        .incl_len = radiotap_len + frame->len,
+        .orig_len = radiotap_len + frame->orig_len
+    };
+
+    memcpy(out, &record, sizeof(record));
+    memcpy(radiotap + radiotap_len, frame->payload, frame->len);
+    return sizeof(record) + radiotap_len + frame->len;
+}
+
+/**
+ * Writes one pcap record for a captured frame
+ * @param frame Frame taken from the ring
+ */
+void pcap_write_frame(const sniffer_frame_t *frame)
+{
+    uint8_t record[PCAP_RECORD_MAX];
+    fwrite(record, pcap_encode_frame(frame, record), 1, stdout);
+}
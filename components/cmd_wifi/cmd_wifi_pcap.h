@@ -0,0 +1,88 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmd_wifi_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// libpcap constants, see https://www.tcpdump.org/linktypes.html
+//-------------------------------------------------------------------------------------------------------------------------
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_VERSION_MAJOR 2
+#define PCAP_VERSION_MINOR 4
+#define LINKTYPE_IEEE802_11_RADIOTAP 127
+
+// largest radiotap header pcap_build_radiotap() can produce
+#define RADIOTAP_MAX_LEN 24
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+} __attribute__((packed)) pcap_global_header_t;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} __attribute__((packed)) pcap_record_header_t;
+
+// largest record pcap_encode_frame() can produce
+#define PCAP_RECORD_MAX (sizeof(pcap_record_header_t) + RADIOTAP_MAX_LEN + SNIFFER_SLOT_PAYLOAD)
+
+// switches the console between binary and text output
+void pcap_begin(void);
+void pcap_end(void);
+
+// only turns LF to CRLF translation off or on, logging stays as it is
+void console_set_binary(bool binary);
+
+// stream writers, output goes to stdout
+void pcap_write_global_header(void);
+void pcap_write_frame(const sniffer_frame_t *frame);
+
+// buffer encoders for writers that don't go through stdout
+void pcap_fill_global_header(pcap_global_header_t *header);
+uint16_t pcap_encode_frame(const sniffer_frame_t *frame, uint8_t *out);
+
+// restarts timestamp wrap tracking for a new capture
+void pcap_reset_clock(void);
+
+// builds the radiotap header for a frame, returns its length
+uint16_t pcap_build_radiotap(uint8_t *out, const wifi_pkt_rx_ctrl_t *rx_ctrl);
+
+#ifdef __cplusplus
+}
+#endif
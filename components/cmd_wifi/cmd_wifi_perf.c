@@ -0,0 +1,153 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// per frame latency instrumentation
+//
+// a sample costs a cycle counter read, a count leading zeros and three adds, cheap enough to leave on. each stage
+// is only written by one task (the wifi task for the callback stages, the capture task for the rest), so there is no
+// locking. the console may read a histogram mid update, which skews one sample at most.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_perf.h"
+
+const char *perf_stage_name[PERF_STAGE_COUNT] = {
+    "callback",
+    "enqueue",
+    "queued",
+    "consume",
+    "output"
+};
+
+static perf_hist_t perf_hist[PERF_STAGE_COUNT];
+static perf_counters_t perf_counters;
+
+/**
+ * Records one sample
+ * @param stage Stage the sample belongs to
+ * @param cycles Duration in cpu cycles
+ */
+void perf_record(perf_stage_t stage, uint32_t cycles)
+{
+    perf_hist_t *hist = &perf_hist[stage];
+    hist->buckets[cycles != 0 ? 31 - __builtin_clz(cycles) : 0]++;
+    hist->count++;
+    hist->total += cycles;
+    if (cycles > hist->max) {
+        hist->max = cycles;
+    }
+}
+
+/**
+ * Counts a frame delivered by the driver
+ * @param len Length of the frame on air
+ */
+void perf_note_rx(uint16_t len)
+{
+    perf_counters.rx_frames++;
+    perf_counters.rx_bytes += len;
+}
+
+/**
+ * Clears every histogram and counter
+ */
+void perf_reset(void)
+{
+    memset(perf_hist, 0, sizeof(perf_hist));
+    memset(&perf_counters, 0, sizeof(perf_counters));
+    perf_counters.since = esp_timer_get_time();
+}
+
+/**
+ * Copies the histogram of a stage
+ * @param stage Stage
+ * @param hist Where to copy it
+ */
+void perf_get_hist(perf_stage_t stage, perf_hist_t *hist)
+{
+    *hist = perf_hist[stage];
+}
+
+/**
+ * Copies the throughput counters
+ * @param counters Where to copy them
+ */
+void perf_get_counters(perf_counters_t *counters)
+{
+    *counters = perf_counters;
+}
+
+/**
+ * Finds the bucket holding a percentile
+ * @param hist Histogram
+ * @param pct Percentile, 0 to 100
+ * @return Upper bound of the bucket in cycles, 0 if the histogram is empty
+ */
+uint32_t perf_percentile(const perf_hist_t *hist, uint32_t pct)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++) {
+        total += hist->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = ((uint64_t)total * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= target) {
+            //-------------------------------------------------------------------------------------------------------------------------
+            // the bucket bound can overshoot the real maximum, never report more than that
+            //-------------------------------------------------------------------------------------------------------------------------
+            uint64_t bound = (2ULL << i) - 1;
+            return bound < hist->max ? (uint32_t)bound : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/**
+ * Converts cpu cycles to microseconds
+ * @param cycles Cycles
+ * @return Microseconds
+ */
+float perf_cycles_to_us(uint64_t cycles)
+{
+    return (float)cycles / esp_rom_get_cpu_ticks_per_us();
+}
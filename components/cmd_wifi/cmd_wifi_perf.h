@@ -0,0 +1,90 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// per stage latency histograms in cpu cycles, bucket n counts samples in [2^n, 2^(n+1))
+//-------------------------------------------------------------------------------------------------------------------------
+#define PERF_BUCKETS 32
+
+typedef enum {
+    PERF_STAGE_CALLBACK,    /* whole rx callback */
+    PERF_STAGE_ENQUEUE,     /* copy into the ring */
+    PERF_STAGE_QUEUED,      /* time a frame waits in the ring */
+    PERF_STAGE_CONSUME,     /* device and AP table updates */
+    PERF_STAGE_OUTPUT,      /* formatting and writing */
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;           /* cycles */
+    uint64_t total;         /* cycles */
+    uint32_t buckets[PERF_BUCKETS];
+} perf_hist_t;
+
+typedef struct {
+    int64_t since;          /* esp_timer time of the last reset */
+    uint32_t rx_frames;     /* frames the driver delivered */
+    uint64_t rx_bytes;
+} perf_counters_t;
+
+extern const char *perf_stage_name[PERF_STAGE_COUNT];
+
+/**
+ * Reads the cycle counter
+ * @return Cycles, wraps
+ */
+static inline uint32_t perf_now(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+// records one sample, every stage has a single writer task so this doesn't lock
+void perf_record(perf_stage_t stage, uint32_t cycles);
+
+// counts a frame delivered by the driver, called from the rx callback
+void perf_note_rx(uint16_t len);
+
+void perf_reset(void);
+void perf_get_hist(perf_stage_t stage, perf_hist_t *hist);
+void perf_get_counters(perf_counters_t *counters);
+
+// upper bound of the bucket holding the given percentile, in cycles
+uint32_t perf_percentile(const perf_hist_t *hist, uint32_t pct);
+
+// converts cycles to microseconds
+float perf_cycles_to_us(uint64_t cycles);
+
+#ifdef __cplusplus
+}
+#endif
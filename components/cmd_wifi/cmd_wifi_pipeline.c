@@ -0,0 +1,198 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_pipeline.h"
+#include "cmd_wifi_mac.h"
+#include "cmd_wifi_maclist.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_devices.h"
+#include "cmd_wifi_aps.h"
+
+/**
+ * Checks whether or not any of the selected addresses of the frame is on the watchlist
+ * @param payload Raw 802.11 frame
+ * @param len Length of the frame
+ * @param match_mask MATCH_ADDR* bits of the addresses to check
+ * @return Result of whether or not mac addresses match
+ */
+bool pipeline_match_mac(const uint8_t *payload, uint16_t len, uint8_t match_mask)
+{
+    uint8_t addrs = wifi_addr_count(payload, len);
+    if ((match_mask & MATCH_ADDR1) && addrs >= 1 &&
+        maclist_contains(mac_key(&payload[MAC_ADDR1_OFFSET]))) {
+        return true;
+    }
+    if ((match_mask & MATCH_ADDR2) && addrs >= 2 &&
+        maclist_contains(mac_key(&payload[MAC_ADDR2_OFFSET]))) {
+        return true;
+    }
+    if ((match_mask & MATCH_ADDR3) && addrs >= 3 &&
+        maclist_contains(mac_key(&payload[MAC_ADDR3_OFFSET]))) {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Runs the filter expression and the watchlist against a frame
+ * @param filter Filter in effect
+ * @param frame Received frame
+ * @return Whether or not the frame should be queued
+ */
+bool pipeline_filter(const pipeline_filter_t *filter, const pipeline_frame_t *frame)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // filter expression runs on the raw header before anything is copied
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (filter->program.len > 0) {
+        const bpf_meta_t meta = {
+            .rssi = frame->rssi,
+            .channel = frame->channel,
+            .rate = frame->rate,
+            .len = frame->orig_len
+        };
+        if (!bpf_run(&filter->program, frame->payload, frame->len, &meta)) {
+            return false;
+        }
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only frames touching the watchlist are output, so don't spend a slot on anything else
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (filter->watchlist && !pipeline_match_mac(frame->payload, frame->len, filter->match_mask)) {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Updates the device and access point tables with a frame
+ * @param frame Queued frame
+ * @param now_ms Current time in ms
+ */
+void pipeline_consume(const pipeline_frame_t *frame, uint32_t now_ms)
+{
+    devices_update_frame(frame->payload, frame->len, frame->rssi, frame->channel, now_ms);
+    aps_update_frame(frame->payload, frame->len, frame->len == frame->orig_len, frame->rssi, frame->channel, now_ms);
+}
+
+/**
+ * Prints the text form of a frame
+ * @param out Stream to print to
+ * @param frame Queued frame
+ * @param packet_type Name of the driver's packet type
+ * @param watched Whether the frame matched the watchlist
+ */
+void pipeline_print_frame(FILE *out, const pipeline_frame_t *frame, const char *packet_type, bool watched)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only decode now that we know the frame is printed, truncated frames lost their FCS
+    //-------------------------------------------------------------------------------------------------------------------------
+    wifi_frame_t decoded;
+    bool valid = wifi_decode(frame->payload, frame->len, frame->len == frame->orig_len, &decoded);
+
+    char mac[MAC_STR_LEN] = "??:??:??:??:??:??";
+    if (valid && decoded.addr2 != NULL) {
+        mac_format(mac, decoded.addr2);
+    }
+
+    wifi_mgmt_info_t info;
+    bool has_info = valid && wifi_parse_mgmt(&decoded, &info);
+
+    if (watched) {
+        fprintf(out, "Filtered Mac found!\n");
+    }
+    fprintf(out, "Packet type: %s\n", packet_type);
+    if (valid) {
+        fprintf(out, "Packet Subtype: %s%s\n", wifi_subtype_name(decoded.type, decoded.subtype), decoded.retry ? " (retry)" : "");
+    }
+    fprintf(out, "Packet Length: %i\n", frame->orig_len);
+    fprintf(out, "Packet Mac Address: %s\n", mac);
+    fprintf(out, "Current Channel: %i\n", frame->channel);
+    if (has_info && info.ssid != NULL) {
+        fprintf(out, "SSID: %.*s\n", info.ssid_len, (const char *)info.ssid);
+    }
+    if (has_info && (decoded.subtype == WIFI_MGMT_BEACON || decoded.subtype == WIFI_MGMT_PROBE_RESP)) {
+        char security[48];
+        wifi_security_str(info.security, security, sizeof(security));
+        fprintf(out, "Security: %s%s%s\n", security, info.ht_cap ? " HT" : "", info.he_cap ? " HE" : "");
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Fills the receive metadata the compact and framed formats keep
+ * @param frame Queued frame
+ * @param meta Metadata to fill
+ */
+void pipeline_compact_meta(const pipeline_frame_t *frame, compact_meta_t *meta)
+{
+    meta->timestamp = frame->timestamp;
+    meta->channel = frame->channel;
+    meta->rssi = frame->rssi;
+    meta->noise = frame->noise;
+    meta->rate = frame->rate;
+}
+
+/**
+ * Prints the one line text form of a frame, a single write per frame
+ * @param out Stream to print to
+ * @param frame Queued frame
+ * @param watched Whether the frame matched the watchlist
+ */
+void pipeline_print_brief(FILE *out, const pipeline_frame_t *frame, bool watched)
+{
+    wifi_frame_t decoded;
+    bool valid = wifi_decode(frame->payload, frame->len, frame->len == frame->orig_len, &decoded);
+
+    char mac[MAC_STR_LEN] = "??:??:??:??:??:??";
+    if (valid && decoded.addr2 != NULL) {
+        mac_format(mac, decoded.addr2);
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only beacons and probe responses are parsed for the SSID, the rest of the line needs the header alone
+    //-------------------------------------------------------------------------------------------------------------------------
+    wifi_mgmt_info_t info;
+    bool has_ssid = valid && decoded.type == WIFI_TYPE_MGMT &&
+                    (decoded.subtype == WIFI_MGMT_BEACON || decoded.subtype == WIFI_MGMT_PROBE_RESP) &&
+                    wifi_parse_mgmt(&decoded, &info) && info.ssid != NULL;
+
+    const char *subtype = valid ? wifi_subtype_name(decoded.type, decoded.subtype) : "invalid";
+    if (has_ssid) {
+        fprintf(out, "%c%2u %4i %5u %s %-14s %.*s\n", watched ? '*' : ' ', frame->channel, frame->rssi, frame->orig_len, mac,
+                subtype, info.ssid_len, (const char *)info.ssid);
+    } else {
+        fprintf(out, "%c%2u %4i %5u %s %s\n", watched ? '*' : ' ', frame->channel, frame->rssi, frame->orig_len, mac, subtype);
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmd_wifi_bpf.h"
+#include "cmd_wifi_compact.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// per frame handling shared by the sniffer and the host replay harness, nothing in here depends on esp-idf
+//
+// filter:  runs in the rx callback before a frame is queued
+// consume: updates the device and access point tables, the caller holds the lock around them
+// output:  text and compact encodings of a queued frame
+//-------------------------------------------------------------------------------------------------------------------------
+
+// header addresses checked against the watchlist
+#define MATCH_ADDR1 (1 << 0)
+#define MATCH_ADDR2 (1 << 1)
+#define MATCH_ADDR3 (1 << 2)
+
+// a received frame and the receive metadata we keep
+typedef struct {
+    const uint8_t *payload;
+    uint16_t len;           /* bytes available in payload */
+    uint16_t orig_len;      /* bytes received over the air */
+    uint32_t timestamp;     /* us, wraps */
+    uint8_t channel;
+    int8_t rssi;
+    int8_t noise;
+    uint8_t rate;           /* wifi_phy_rate_t */
+} pipeline_frame_t;
+
+typedef struct {
+    bpf_program_t program;  /* empty program accepts everything */
+    bool watchlist;         /* only accept frames with a watched address */
+    uint8_t match_mask;     /* MATCH_ADDR* bits checked against the watchlist */
+} pipeline_filter_t;
+
+// checks whether any of the selected header addresses is on the watchlist
+bool pipeline_match_mac(const uint8_t *payload, uint16_t len, uint8_t match_mask);
+
+// runs the filter expression and the watchlist, returns true if the frame should be queued
+bool pipeline_filter(const pipeline_filter_t *filter, const pipeline_frame_t *frame);
+
+// updates the device and access point tables
+void pipeline_consume(const pipeline_frame_t *frame, uint32_t now_ms);
+
+// prints the text form of a frame, packet_type is the driver's packet type name
+void pipeline_print_frame(FILE *out, const pipeline_frame_t *frame, const char *packet_type, bool watched);
+
+// prints one line per frame: watchlist mark, channel, rssi, length, transmitter, subtype and SSID
+void pipeline_print_brief(FILE *out, const pipeline_frame_t *frame, bool watched);
+
+// receive metadata as kept by the compact and framed formats
+void pipeline_compact_meta(const pipeline_frame_t *frame, compact_meta_t *meta);
+
+#ifdef __cplusplus
+}
+#endif
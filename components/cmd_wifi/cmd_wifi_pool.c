@@ -0,0 +1,237 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// fixed block pool for captured frames
+//
+// every class is a static array of equal blocks with a free list threaded through a parallel index array. the free
+// list head packs the first free index in the low 16 bits and a tag in the high 16 bits. the tag changes on every
+// push and pop, so a compare and swap against a head that was popped and pushed back in the meantime fails instead
+// of linking a block that is in use (the ABA problem). nothing here blocks or touches the heap, and a full pool is a
+// NULL return the caller counts as a drop.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_pool.h"
+
+#define POOL_INDEX_MASK 0xffffu
+#define POOL_TAG_ONE 0x10000u
+#define POOL_EMPTY POOL_INDEX_MASK
+
+_Static_assert(FRAME_POOL_SMALL_SIZE < FRAME_POOL_MEDIUM_SIZE && FRAME_POOL_MEDIUM_SIZE < FRAME_POOL_LARGE_SIZE,
+               "frame pool classes must be ascending");
+_Static_assert(FRAME_POOL_SMALL_BLOCKS < POOL_EMPTY && FRAME_POOL_MEDIUM_BLOCKS < POOL_EMPTY &&
+               FRAME_POOL_LARGE_BLOCKS < POOL_EMPTY, "frame pool class too large for 16 bit indexes");
+
+typedef struct {
+    uint8_t *base;
+    uint16_t size;
+    uint16_t blocks;
+    atomic_ushort *next;    /* next free index for every block on the free list */
+    atomic_uint head;       /* tag << 16 | first free index */
+    atomic_uint in_use;
+    atomic_uint high_water;
+    atomic_uint allocs;
+    atomic_uint spills;
+    atomic_uint exhausted;
+} pool_class_t;
+
+static uint8_t small_blocks[FRAME_POOL_SMALL_BLOCKS][FRAME_POOL_SMALL_SIZE] __attribute__((aligned(4)));
+static uint8_t medium_blocks[FRAME_POOL_MEDIUM_BLOCKS][FRAME_POOL_MEDIUM_SIZE] __attribute__((aligned(4)));
+static uint8_t large_blocks[FRAME_POOL_LARGE_BLOCKS][FRAME_POOL_LARGE_SIZE] __attribute__((aligned(4)));
+
+static atomic_ushort small_next[FRAME_POOL_SMALL_BLOCKS];
+static atomic_ushort medium_next[FRAME_POOL_MEDIUM_BLOCKS];
+static atomic_ushort large_next[FRAME_POOL_LARGE_BLOCKS];
+
+static pool_class_t pool_classes[FRAME_POOL_CLASSES] = {
+    { .base = &small_blocks[0][0], .size = FRAME_POOL_SMALL_SIZE, .blocks = FRAME_POOL_SMALL_BLOCKS, .next = small_next },
+    { .base = &medium_blocks[0][0], .size = FRAME_POOL_MEDIUM_SIZE, .blocks = FRAME_POOL_MEDIUM_BLOCKS, .next = medium_next },
+    { .base = &large_blocks[0][0], .size = FRAME_POOL_LARGE_SIZE, .blocks = FRAME_POOL_LARGE_BLOCKS, .next = large_next },
+};
+
+static atomic_bool pool_ready;
+
+/**
+ * Bumps a counter
+ * @param counter Counter to bump
+ */
+static inline void count(atomic_uint *counter)
+{
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+/**
+ * Links every block of a class into its free list and clears its counters
+ * @param pool Class to reset
+ */
+static void reset_class(pool_class_t *pool)
+{
+    for (uint16_t i = 0; i < pool->blocks; i++) {
+        atomic_store_explicit(&pool->next[i], i + 1 < pool->blocks ? (uint16_t)(i + 1) : POOL_EMPTY, memory_order_relaxed);
+    }
+    atomic_store(&pool->head, 0);
+    atomic_store(&pool->in_use, 0);
+    atomic_store(&pool->high_water, 0);
+    atomic_store(&pool->allocs, 0);
+    atomic_store(&pool->spills, 0);
+    atomic_store(&pool->exhausted, 0);
+}
+
+/**
+ * Pops the first free block of a class
+ * @param pool Class to take from
+ * @return Block, or NULL if the class is empty
+ */
+static void *pop_block(pool_class_t *pool)
+{
+    unsigned head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    unsigned index;
+    unsigned swapped;
+
+    do {
+        index = head & POOL_INDEX_MASK;
+        if (index == POOL_EMPTY) {
+            return NULL;
+        }
+        swapped = ((head & ~POOL_INDEX_MASK) + POOL_TAG_ONE) |
+                  atomic_load_explicit(&pool->next[index], memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, swapped, memory_order_acquire, memory_order_acquire));
+
+    unsigned used = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    unsigned high = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (used > high &&
+           !atomic_compare_exchange_weak_explicit(&pool->high_water, &high, used, memory_order_relaxed, memory_order_relaxed)) {
+        // high was reloaded by the failed exchange
+    }
+    count(&pool->allocs);
+
+    return pool->base + (size_t)index * pool->size;
+}
+
+/**
+ * Hands out a block of at least len bytes
+ * @param len Bytes the caller will store
+ * @return Block, or NULL if no class that fits has a free block
+ */
+void *frame_pool_alloc(uint16_t len)
+{
+    if (!atomic_load_explicit(&pool_ready, memory_order_acquire)) {
+        return NULL;
+    }
+
+    pool_class_t *wanted = NULL;
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        pool_class_t *pool = &pool_classes[i];
+        if (pool->size < len) {
+            continue;
+        }
+        if (wanted == NULL) {
+            wanted = pool;
+        }
+
+        void *block = pop_block(pool);
+        if (block != NULL) {
+            if (pool != wanted) {
+                count(&wanted->spills);
+            }
+            return block;
+        }
+    }
+
+    if (wanted != NULL) {
+        count(&wanted->exhausted);
+    }
+    return NULL;
+}
+
+/**
+ * Returns a block to the class it came from
+ * @param block Block from frame_pool_alloc, NULL is ignored
+ */
+void frame_pool_free(void *block)
+{
+    if (block == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        pool_class_t *pool = &pool_classes[i];
+        uint8_t *ptr = block;
+        if (ptr < pool->base || ptr >= pool->base + (size_t)pool->blocks * pool->size) {
+            continue;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // count the block as free before it can be popped again, so in_use never overshoots the class
+        //-------------------------------------------------------------------------------------------------------------------------
+        atomic_fetch_sub_explicit(&pool->in_use, 1, memory_order_relaxed);
+
+        unsigned index = (unsigned)((ptr - pool->base) / pool->size);
+        unsigned head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+        unsigned swapped;
+        do {
+            atomic_store_explicit(&pool->next[index], head & POOL_INDEX_MASK, memory_order_relaxed);
+            swapped = ((head & ~POOL_INDEX_MASK) + POOL_TAG_ONE) | index;
+        } while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, swapped, memory_order_release, memory_order_relaxed));
+        return;
+    }
+}
+
+/**
+ * Takes a snapshot of every class
+ * @param stats Where to store the counters, one entry per class from small to large
+ */
+void frame_pool_get_stats(frame_pool_stats_t stats[FRAME_POOL_CLASSES])
+{
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        pool_class_t *pool = &pool_classes[i];
+        stats[i].size = pool->size;
+        stats[i].blocks = pool->blocks;
+        stats[i].in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+        stats[i].high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+        stats[i].allocs = atomic_load_explicit(&pool->allocs, memory_order_relaxed);
+        stats[i].spills = atomic_load_explicit(&pool->spills, memory_order_relaxed);
+        stats[i].exhausted = atomic_load_explicit(&pool->exhausted, memory_order_relaxed);
+    }
+}
+
+/**
+ * Puts every block back on its free list and clears all counters
+ */
+void frame_pool_reset(void)
+{
+    for (int i = 0; i < FRAME_POOL_CLASSES; i++) {
+        reset_class(&pool_classes[i]);
+    }
+    atomic_store_explicit(&pool_ready, true, memory_order_release);
+}
@@ -0,0 +1,71 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// pool geometry, one class per row. an allocation takes the smallest class that fits and moves up a class when that
+// one is empty, never down. sizes must be ascending and the largest must hold a full ring slot.
+//-------------------------------------------------------------------------------------------------------------------------
+#define FRAME_POOL_CLASSES 3
+
+#define FRAME_POOL_SMALL_SIZE 128     /* control, null data, most probe requests */
+#define FRAME_POOL_SMALL_BLOCKS 24
+#define FRAME_POOL_MEDIUM_SIZE 256    /* short beacons and probe responses, deauth, EAPOL */
+#define FRAME_POOL_MEDIUM_BLOCKS 8
+#define FRAME_POOL_LARGE_SIZE 512     /* everything else, truncated to SNIFFER_SLOT_PAYLOAD */
+#define FRAME_POOL_LARGE_BLOCKS 32
+
+#define FRAME_POOL_BLOCKS (FRAME_POOL_SMALL_BLOCKS + FRAME_POOL_MEDIUM_BLOCKS + FRAME_POOL_LARGE_BLOCKS)
+#define FRAME_POOL_BYTES (FRAME_POOL_SMALL_SIZE * FRAME_POOL_SMALL_BLOCKS + \
+                          FRAME_POOL_MEDIUM_SIZE * FRAME_POOL_MEDIUM_BLOCKS + \
+                          FRAME_POOL_LARGE_SIZE * FRAME_POOL_LARGE_BLOCKS)
+
+typedef struct {
+    uint16_t size;          /* bytes per block */
+    uint16_t blocks;
+    uint16_t in_use;
+    uint16_t high_water;
+    uint32_t allocs;        /* blocks handed out from this class */
+    uint32_t spills;        /* allocations that wanted this class but got a larger one */
+    uint32_t exhausted;     /* allocations that found this class and every larger one empty */
+} frame_pool_stats_t;
+
+// lock free and O(1), any task or the rx callback may allocate and free
+void *frame_pool_alloc(uint16_t len);
+void frame_pool_free(void *block);
+
+void frame_pool_get_stats(frame_pool_stats_t stats[FRAME_POOL_CLASSES]);
+
+// only safe while no blocks are handed out or being allocated
+void frame_pool_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
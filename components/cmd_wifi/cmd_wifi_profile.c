@@ -0,0 +1,246 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// capture profiles in nvs
+//
+// a profile is one blob keyed by its name, so saving replaces it in a single nvs write and a profile is never half
+// written. the version and size in front of the blob are checked on load.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// nvs libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "nvs.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_profile.h"
+
+/**
+ * Checks that a name fits in an nvs key and can't be taken for the autostart entry
+ * @param name Profile name
+ * @return True if usable
+ */
+static bool profile_name_valid(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 0 && len <= PROFILE_NAME_LEN && strcmp(name, PROFILE_AUTOSTART_KEY) != 0;
+}
+
+/**
+ * Reads a profile
+ * @param name Profile name
+ * @param config Where to store it
+ * @return ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_INVALID_VERSION or an nvs error
+ */
+esp_err_t profile_load(const char *name, sniffer_config_t *config)
+{
+    if (!profile_name_valid(name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    size_t len = 0;
+    err = nvs_get_blob(nvs, name, NULL, &len);
+    if (err == ESP_OK && len != sizeof(sniffer_config_t)) {
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    if (err == ESP_OK) {
+        err = nvs_get_blob(nvs, name, config, &len);
+    }
+    nvs_close(nvs);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err == ESP_OK && (config->version != SNIFFER_CONFIG_VERSION || config->size != sizeof(sniffer_config_t))) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (err == ESP_OK) {
+        //-------------------------------------------------------------------------------------------------------------------------
+        // strings come back terminated whatever was stored
+        //-------------------------------------------------------------------------------------------------------------------------
+        config->macfile[SNIFFER_CONFIG_PATH_LEN - 1] = '\0';
+        config->macnvs[SNIFFER_CONFIG_KEY_LEN - 1] = '\0';
+        config->filter[SNIFFER_CONFIG_FILTER_LEN - 1] = '\0';
+        if (config->mac_count > SNIFFER_CONFIG_MACS) {
+            config->mac_count = SNIFFER_CONFIG_MACS;
+        }
+    }
+    return err;
+}
+
+/**
+ * Writes a profile, replacing one with the same name
+ * @param name Profile name
+ * @param config Settings, version and size are filled in here
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad name or an nvs error
+ */
+esp_err_t profile_save(const char *name, const sniffer_config_t *config)
+{
+    if (!profile_name_valid(name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sniffer_config_t blob = *config;
+    blob.version = SNIFFER_CONFIG_VERSION;
+    blob.size = sizeof(sniffer_config_t);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs, name, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+/**
+ * Removes a profile, and the autostart entry if it named it
+ * @param name Profile name
+ * @return ESP_OK, ESP_ERR_NOT_FOUND or an nvs error
+ */
+esp_err_t profile_delete(const char *name)
+{
+    if (!profile_name_valid(name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char autostart[PROFILE_NAME_LEN + 1];
+    if (profile_get_autostart(autostart, sizeof(autostart)) == ESP_OK && strcmp(autostart, name) == 0) {
+        profile_set_autostart(NULL);
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+    }
+    err = nvs_erase_key(nvs, name);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+}
+
+/**
+ * Reads the name of the profile started at boot
+ * @param name Where to store the name, empty if none
+ * @param size Size of name, at least PROFILE_NAME_LEN + 1
+ * @return ESP_OK or an nvs error
+ */
+esp_err_t profile_get_autostart(char *name, size_t size)
+{
+    name[0] = '\0';
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_get_str(nvs, PROFILE_AUTOSTART_KEY, name, &size);
+    nvs_close(nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        name[0] = '\0';
+        return ESP_OK;
+    }
+    return err;
+}
+
+/**
+ * Picks the profile started at boot
+ * @param name Profile name, NULL to start nothing
+ * @return ESP_OK or an nvs error
+ */
+esp_err_t profile_set_autostart(const char *name)
+{
+    if (name != NULL && !profile_name_valid(name)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(PROFILE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (name != NULL) {
+        err = nvs_set_str(nvs, PROFILE_AUTOSTART_KEY, name);
+    } else {
+        err = nvs_erase_key(nvs, PROFILE_AUTOSTART_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+/**
+ * Lists saved profiles
+ * @param names Where to store the names
+ * @param max Capacity of names
+ * @return Number of names stored
+ */
+size_t profile_list(char names[][PROFILE_NAME_LEN + 1], size_t max)
+{
+    size_t n = 0;
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, PROFILE_NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (err == ESP_OK && n < max) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        snprintf(names[n++], PROFILE_NAME_LEN + 1, "%s", info.key);
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return n;
+}
@@ -0,0 +1,89 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// named capture profiles, each one a sniffer_config_t stored as a single blob in its own nvs namespace
+//-------------------------------------------------------------------------------------------------------------------------
+#define PROFILE_NVS_NAMESPACE "profiles"
+#define PROFILE_AUTOSTART_KEY "~autostart"  /* holds the name of the profile started at boot */
+#define PROFILE_NAME_LEN 15                 /* nvs key limit */
+#define PROFILE_MAX 16
+
+//-------------------------------------------------------------------------------------------------------------------------
+// bump the version whenever the layout or the meaning of a field changes, including the order of the output formats.
+// blobs of another version are refused rather than guessed at.
+//-------------------------------------------------------------------------------------------------------------------------
+#define SNIFFER_CONFIG_VERSION 1
+#define SNIFFER_CONFIG_MACS 16
+#define SNIFFER_CONFIG_PATH_LEN 64
+#define SNIFFER_CONFIG_KEY_LEN 16
+#define SNIFFER_CONFIG_FILTER_LEN 128
+
+// everything start takes, in the form it is applied in
+typedef struct {
+    uint16_t version;
+    uint16_t size;              /* sizeof(sniffer_config_t) when it was written */
+    uint8_t channel;            /* 0 stays on the current channel */
+    uint8_t format;             /* index into the output format names */
+    uint8_t match_mask;         /* MATCH_* */
+    uint8_t mac_count;
+    uint8_t macs[SNIFFER_CONFIG_MACS][6];
+    uint32_t type_mask;         /* WIFI_PROMIS_FILTER_MASK_*, 0 for the default of the format */
+    uint32_t ctrl_mask;         /* WIFI_PROMIS_CTRL_FILTER_MASK_* */
+    uint16_t snaplen;
+    uint16_t batch_frames;
+    uint16_t flush_ms;
+    uint8_t record_compact;
+    uint8_t reserved;
+    uint32_t rotate_kb;
+    uint32_t rotate_s;
+    char macfile[SNIFFER_CONFIG_PATH_LEN];     /* empty for none */
+    char macnvs[SNIFFER_CONFIG_KEY_LEN];
+    char filter[SNIFFER_CONFIG_FILTER_LEN];
+} sniffer_config_t;
+
+// ESP_ERR_NOT_FOUND if there is no such profile, ESP_ERR_INVALID_VERSION if it was saved by another layout
+esp_err_t profile_load(const char *name, sniffer_config_t *config);
+esp_err_t profile_save(const char *name, const sniffer_config_t *config);
+esp_err_t profile_delete(const char *name);
+
+// name is set to an empty string when nothing starts at boot, NULL clears it
+esp_err_t profile_get_autostart(char *name, size_t size);
+esp_err_t profile_set_autostart(const char *name);
+
+// fills names with up to max profile names, returns how many
+size_t profile_list(char names[][PROFILE_NAME_LEN + 1], size_t max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,594 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// records captured frames to pcap files on the FAT partition
+//
+// the capture task encodes records into one of two sector aligned buffers. full buffers are handed to a writer
+// task, so flash writes overlap with capture and every write() but the last of a file is a whole number of
+// sectors at a sector aligned offset, which lets FATFS write straight from the buffer instead of its cache.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// esp32 libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "esp_console.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_vfs_fat.h"
+#include "argtable3/argtable3.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// freeRTOS libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_record.h"
+#include "cmd_wifi_pcap.h"
+#include "cmd_wifi_compact.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// below the capture task, it only runs while the capture task waits on a buffer or idles
+//-------------------------------------------------------------------------------------------------------------------------
+#define RECORD_TASK_STACK 4096
+#define RECORD_TASK_PRIORITY 4
+
+#define RECORD_PATH_LEN (sizeof(RECORD_DIR) + sizeof(((record_stats_t *)0)->current))
+
+_Static_assert(RECORD_BUF_SIZE % RECORD_SECTOR == 0, "RECORD_BUF_SIZE must be a whole number of sectors");
+_Static_assert(PCAP_RECORD_MAX >= SNIFFER_SLOT_PAYLOAD + COMPACT_OVERHEAD_MAX, "record buffer too small for compact records");
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t len;
+    bool close;         /* close the file once this chunk is written */
+} record_chunk_t;
+
+static QueueHandle_t record_full;
+static QueueHandle_t record_free;
+static TaskHandle_t record_task;
+static uint8_t *record_buffers[RECORD_BUFFERS];
+
+//-------------------------------------------------------------------------------------------------------------------------
+// capture task side
+//-------------------------------------------------------------------------------------------------------------------------
+static uint8_t *record_fill;
+static uint32_t record_fill_len;
+static uint32_t record_file_bytes;
+static uint32_t record_file_frames;
+static int64_t record_file_started;
+static record_config_t record_config;
+static volatile bool recording;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// writer task side, the console only reads the stats
+//-------------------------------------------------------------------------------------------------------------------------
+static int record_fd = -1;
+static uint32_t record_index;
+static record_stats_t record_stats;
+static portMUX_TYPE record_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// arguments for files command
+//-------------------------------------------------------------------------------------------------------------------------
+static struct {
+    struct arg_str *dump;
+    struct arg_str *del;
+    struct arg_end *end;
+} files_args;
+
+/**
+ * Finds the index after the highest numbered recording so nothing is overwritten
+ * @return Next free index
+ */
+static uint32_t record_scan(void)
+{
+    uint32_t next = 0;
+    DIR *dir = opendir(RECORD_DIR);
+    if (dir == NULL) {
+        return 0;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint32_t index;
+        if (sscanf(entry->d_name, RECORD_PREFIX "%5"SCNu32, &index) == 1 && index >= next) {
+            next = index + 1;
+        }
+    }
+    closedir(dir);
+    return next;
+}
+
+/**
+ * Opens the next recording file
+ * @return True on success
+ */
+static bool record_open(void)
+{
+    char name[sizeof(record_stats.current)];
+    char path[RECORD_PATH_LEN];
+    snprintf(name, sizeof(name), RECORD_PREFIX "%05"PRIu32"%s", record_index++, record_config.compact ? ".cmp" : ".pcap");
+    snprintf(path, sizeof(path), RECORD_DIR "/%s", name);
+
+    record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    taskENTER_CRITICAL(&record_stats_lock);
+    if (record_fd >= 0) {
+        record_stats.files++;
+        memcpy(record_stats.current, name, sizeof(name));
+    } else {
+        record_stats.errors++;
+    }
+    taskEXIT_CRITICAL(&record_stats_lock);
+    return record_fd >= 0;
+}
+
+/**
+ * Writes full buffers handed over by the capture task
+ * @param arg Unused
+ */
+static void record_task_main(void *arg)
+{
+    record_chunk_t chunk;
+    while (true) {
+        xQueueReceive(record_full, &chunk, portMAX_DELAY);
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // after a rotation the next file is opened by the first chunk that has data for it
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (record_fd < 0 && chunk.len > 0) {
+            record_open();
+        }
+
+        if (record_fd >= 0 && chunk.len > 0) {
+            int64_t start = esp_timer_get_time();
+            ssize_t written = write(record_fd, chunk.buf, chunk.len);
+            int64_t elapsed = esp_timer_get_time() - start;
+
+            taskENTER_CRITICAL(&record_stats_lock);
+            record_stats.writes++;
+            record_stats.write_us += elapsed;
+            if (written > 0) {
+                record_stats.bytes += written;
+            }
+            if (written != (ssize_t)chunk.len) {
+                record_stats.errors++;
+            }
+            taskEXIT_CRITICAL(&record_stats_lock);
+        }
+
+        if (chunk.close && record_fd >= 0) {
+            close(record_fd);
+            record_fd = -1;
+            taskENTER_CRITICAL(&record_stats_lock);
+            record_stats.current[0] = '\0';
+            taskEXIT_CRITICAL(&record_stats_lock);
+        }
+
+        xQueueSend(record_free, &chunk.buf, portMAX_DELAY);
+    }
+}
+
+/**
+ * Hands the fill buffer to the writer and takes the other one, waiting on flash if it is still being written
+ * @param close Whether the file ends with this buffer
+ */
+static void record_submit(bool close)
+{
+    const record_chunk_t chunk = { .buf = record_fill, .len = record_fill_len, .close = close };
+    xQueueSend(record_full, &chunk, portMAX_DELAY);
+
+    if (xQueueReceive(record_free, &record_fill, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&record_stats_lock);
+        record_stats.waits++;
+        taskEXIT_CRITICAL(&record_stats_lock);
+        xQueueReceive(record_free, &record_fill, portMAX_DELAY);
+    }
+    record_fill_len = 0;
+}
+
+/**
+ * Appends bytes to the current file, records may straddle buffers so every buffer goes out full
+ * @param data Bytes to append
+ * @param len Number of bytes
+ */
+static void record_append(const uint8_t *data, uint32_t len)
+{
+    record_file_bytes += len;
+    while (len > 0) {
+        uint32_t n = RECORD_BUF_SIZE - record_fill_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(record_fill + record_fill_len, data, n);
+        record_fill_len += n;
+        data += n;
+        len -= n;
+
+        if (record_fill_len == RECORD_BUF_SIZE) {
+            record_submit(false);
+        }
+    }
+}
+
+/**
+ * Starts a file with its format header, compact files each get a fresh dictionary so they decode on their own
+ */
+static void record_start_file(void)
+{
+    record_file_bytes = 0;
+    record_file_frames = 0;
+    record_file_started = esp_timer_get_time();
+
+    if (record_config.compact) {
+        uint8_t header[COMPACT_HEADER_LEN];
+        compact_begin(record_config.snaplen);
+        record_append(header, compact_write_header(header));
+    } else {
+        pcap_global_header_t header;
+        pcap_fill_global_header(&header);
+        record_append((const uint8_t *)&header, sizeof(header));
+    }
+}
+
+/**
+ * Opens the first file of a recording session
+ * @param config Rotation limits
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the partition isn't mounted, ESP_ERR_NO_MEM or ESP_FAIL
+ */
+esp_err_t record_begin(const record_config_t *config)
+{
+    if (recording) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    DIR *dir = opendir(RECORD_DIR);
+    if (dir == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    closedir(dir);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the writer and its queues live for as long as the firmware does, the buffers only while recording
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (record_task == NULL) {
+        record_full = xQueueCreate(RECORD_BUFFERS, sizeof(record_chunk_t));
+        record_free = xQueueCreate(RECORD_BUFFERS, sizeof(uint8_t *));
+        if (record_full == NULL || record_free == NULL ||
+            xTaskCreate(&record_task_main, "record", RECORD_TASK_STACK, NULL, RECORD_TASK_PRIORITY, &record_task) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    for (int i = 0; i < RECORD_BUFFERS; i++) {
+        record_buffers[i] = heap_caps_aligned_alloc(sizeof(uint32_t), RECORD_BUF_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (record_buffers[i] == NULL) {
+            for (int j = 0; j < i; j++) {
+                heap_caps_free(record_buffers[j]);
+            }
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    taskENTER_CRITICAL(&record_stats_lock);
+    memset(&record_stats, 0, sizeof(record_stats));
+    record_stats.started = esp_timer_get_time();
+    taskEXIT_CRITICAL(&record_stats_lock);
+
+    record_config = *config;
+    record_index = record_scan();
+    if (!record_open()) {
+        for (int i = 0; i < RECORD_BUFFERS; i++) {
+            heap_caps_free(record_buffers[i]);
+        }
+        return ESP_FAIL;
+    }
+
+    xQueueReset(record_full);
+    xQueueReset(record_free);
+    for (int i = 1; i < RECORD_BUFFERS; i++) {
+        xQueueSend(record_free, &record_buffers[i], 0);
+    }
+    record_fill = record_buffers[0];
+    record_fill_len = 0;
+
+    pcap_reset_clock();
+    record_start_file();
+    recording = true;
+    return ESP_OK;
+}
+
+/**
+ * Appends a frame to the recording, rotating first if it would cross a limit
+ * @param frame Frame taken from the ring
+ */
+void record_write_frame(const sniffer_frame_t *frame)
+{
+    if (!recording) {
+        return;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // rotate before encoding, a compact record refers to the dictionary of the file it goes into. the size check
+    // uses the largest the record can get, and a file always gets at least one record
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t bound = frame->len + (record_config.compact ? COMPACT_OVERHEAD_MAX : sizeof(pcap_record_header_t) + RADIOTAP_MAX_LEN);
+    bool full = record_config.rotate_kb != 0 && record_file_frames > 0 &&
+                record_file_bytes + bound > record_config.rotate_kb * 1024;
+    bool expired = record_config.rotate_s != 0 && record_file_frames > 0 &&
+                   esp_timer_get_time() - record_file_started >= (int64_t)record_config.rotate_s * 1000000;
+    if (full || expired) {
+        record_submit(true);
+        record_start_file();
+    }
+
+    uint8_t record[PCAP_RECORD_MAX];
+    uint16_t len;
+    if (record_config.compact) {
+        const compact_meta_t meta = {
+            .timestamp = frame->rx_ctrl.timestamp,
+            .channel = frame->rx_ctrl.channel,
+            .rssi = frame->rx_ctrl.rssi,
+            .noise = frame->rx_ctrl.noise_floor,
+            .rate = frame->rx_ctrl.rate
+        };
+        len = compact_encode_frame(&meta, frame->payload, frame->len, frame->orig_len, record);
+    } else {
+        len = pcap_encode_frame(frame, record);
+    }
+
+    record_append(record, len);
+    record_file_frames++;
+}
+
+/**
+ * Flushes the last partial buffer and waits for the writer to close the file
+ */
+void record_end(void)
+{
+    if (!recording) {
+        return;
+    }
+
+    const record_chunk_t chunk = { .buf = record_fill, .len = record_fill_len, .close = true };
+    xQueueSend(record_full, &chunk, portMAX_DELAY);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // once every buffer came back the writer is idle and the file is closed
+    //-------------------------------------------------------------------------------------------------------------------------
+    for (int i = 0; i < RECORD_BUFFERS; i++) {
+        xQueueReceive(record_free, &record_buffers[i], portMAX_DELAY);
+        heap_caps_free(record_buffers[i]);
+        record_buffers[i] = NULL;
+    }
+    record_fill = NULL;
+    recording = false;
+}
+
+/**
+ * Whether a recording session is open
+ * @return True while recording
+ */
+bool record_active(void)
+{
+    return recording;
+}
+
+/**
+ * Copies the recording counters
+ * @param stats Where to copy them
+ */
+void record_get_stats(record_stats_t *stats)
+{
+    taskENTER_CRITICAL(&record_stats_lock);
+    *stats = record_stats;
+    taskEXIT_CRITICAL(&record_stats_lock);
+}
+
+/**
+ * Prints files written and flash throughput for the current or last session
+ */
+void record_print_stats(void)
+{
+    record_stats_t stats;
+    record_get_stats(&stats);
+    if (stats.started == 0) {
+        printf("Recording: none yet\n");
+        return;
+    }
+
+    printf("Recording: %s%s, %"PRIu32" file(s), %"PRIu64" KB in %"PRIu32" write(s)\n",
+           recording ? "writing " : "stopped", stats.current, stats.files, stats.bytes / 1024, stats.writes);
+    if (stats.write_us > 0) {
+        printf("Flash throughput: %.1f KB/s while writing, %.1f ms per write\n",
+               stats.bytes / 1024.0 / (stats.write_us / 1000000.0), stats.write_us / 1000.0 / stats.writes);
+    }
+    printf("Buffer waits: %"PRIu32", write errors: %"PRIu32"\n", stats.waits, stats.errors);
+}
+
+/**
+ * Checks a file name given on the command line and builds its path
+ * @param name File name without directory
+ * @param path Where to store the full path
+ * @return False if the name is unusable or is the file being recorded
+ */
+static bool files_path(const char *name, char *path)
+{
+    if (strchr(name, '/') != NULL || strlen(name) >= sizeof(record_stats.current)) {
+        printf("Invalid file name: %s\n", name);
+        return false;
+    }
+
+    record_stats_t stats;
+    record_get_stats(&stats);
+    if (recording && strcmp(name, stats.current) == 0) {
+        printf("%s is being recorded, stop first\n", name);
+        return false;
+    }
+
+    snprintf(path, RECORD_PATH_LEN, RECORD_DIR "/%s", name);
+    return true;
+}
+
+/**
+ * Streams a file over the console, a header line with its size precedes the raw bytes
+ * @param name File name
+ * @return 0 on success
+ */
+static int files_dump(const char *name)
+{
+    char path[RECORD_PATH_LEN];
+    if (!files_path(name, path)) {
+        return 1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the console switch also resets the pcap clock a recording relies on
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (recording) {
+        printf("Stop the recording before dumping\n");
+        return 1;
+    }
+
+    struct stat st;
+    FILE *f = fopen(path, "rb");
+    if (f == NULL || stat(path, &st) != 0) {
+        printf("Failed to open %s\n", path);
+        if (f != NULL) {
+            fclose(f);
+        }
+        return 1;
+    }
+
+    uint8_t *buf = malloc(RECORD_SECTOR);
+    if (buf == NULL) {
+        printf("Failed to allocate dump buffer\n");
+        fclose(f);
+        return 1;
+    }
+
+    pcap_begin();
+    printf("Dumping %s (%ld bytes)\n", name, (long)st.st_size);
+    size_t n;
+    while ((n = fread(buf, 1, RECORD_SECTOR, f)) > 0) {
+        fwrite(buf, 1, n, stdout);
+    }
+    pcap_end();
+
+    free(buf);
+    fclose(f);
+    return 0;
+}
+
+/**
+ * Lists, dumps or deletes recordings
+ * @param argc Number of arguments
+ * @param argv Arguments
+ */
+static int files_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&files_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, files_args.end, argv[0]);
+        return 1;
+    }
+
+    if (files_args.dump->count > 0) {
+        return files_dump(files_args.dump->sval[0]);
+    }
+
+    if (files_args.del->count > 0) {
+        char path[RECORD_PATH_LEN];
+        if (!files_path(files_args.del->sval[0], path)) {
+            return 1;
+        }
+        if (unlink(path) != 0) {
+            printf("Failed to delete %s\n", path);
+            return 1;
+        }
+        printf("Deleted %s\n", path);
+        return 0;
+    }
+
+    DIR *dir = opendir(RECORD_DIR);
+    if (dir == NULL) {
+        printf("%s is not mounted\n", RECORD_DIR);
+        return 1;
+    }
+
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[RECORD_PATH_LEN + 256];
+        struct stat st;
+        snprintf(path, sizeof(path), RECORD_DIR "/%s", entry->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            printf("%-24s %10ld\n", entry->d_name, (long)st.st_size);
+            count++;
+        }
+    }
+    closedir(dir);
+
+    uint64_t total = 0;
+    uint64_t free_bytes = 0;
+    if (esp_vfs_fat_info(RECORD_DIR, &total, &free_bytes) == ESP_OK) {
+        printf("%i file(s), %"PRIu64" KB free of %"PRIu64" KB\n", count, free_bytes / 1024, total / 1024);
+    }
+    record_print_stats();
+    return 0;
+}
+
+void register_files(void)
+{
+    files_args.dump = arg_str0(NULL, "dump", "<name>", "Stream a file over the console, see tools/serial_pcap.py --dump");
+    files_args.del = arg_str0(NULL, "delete", "<name>", "Delete a file");
+    files_args.end = arg_end(2);
+
+    const esp_console_cmd_t files_cmd_def = {
+        .command = "files",
+        .help = "Lists recordings in " RECORD_DIR " with free space and flash throughput, or dumps or deletes one",
+        .hint = NULL,
+        .func = &files_cmd,
+        .argtable = &files_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&files_cmd_def));
+}
@@ -0,0 +1,82 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "cmd_wifi_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// recordings go to the FAT partition mounted in main, written in whole multiples of the 4096 byte sector
+//-------------------------------------------------------------------------------------------------------------------------
+#define RECORD_DIR "/data"
+#define RECORD_PREFIX "cap"
+#define RECORD_SECTOR 4096
+#define RECORD_BUF_SIZE (4 * RECORD_SECTOR)
+#define RECORD_BUFFERS 2
+
+typedef struct {
+    uint32_t rotate_kb;     /* start a new file after this many KB, 0 for no limit */
+    uint32_t rotate_s;      /* start a new file after this many seconds, 0 for no limit */
+    bool compact;           /* write the compact format instead of pcap */
+    uint16_t snaplen;       /* compact only, see cmd_wifi_compact.h */
+} record_config_t;
+
+typedef struct {
+    uint32_t files;         /* files opened this session */
+    uint64_t bytes;         /* bytes written to flash */
+    uint64_t write_us;      /* time spent in write() */
+    uint32_t writes;
+    uint32_t errors;        /* failed opens and short writes */
+    uint32_t waits;         /* times the capture task waited on flash for a free buffer */
+    int64_t started;
+    char current[32];       /* file being written, empty when none */
+} record_stats_t;
+
+// opens the first file of a recording session
+esp_err_t record_begin(const record_config_t *config);
+
+// appends a frame, rotating files as configured, called from the capture task only
+void record_write_frame(const sniffer_frame_t *frame);
+
+// flushes the last partial buffer and waits for the file to be closed
+void record_end(void);
+
+bool record_active(void);
+void record_get_stats(record_stats_t *stats);
+
+// prints files written and flash throughput for the current or last session
+void record_print_stats(void);
+
+// registers the files command
+void register_files(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// single producer/single consumer ring between the promiscuous rx callback and the consumer task
+//
+// the producer only ever writes head and the consumer only ever writes tail, so no locks are needed.
+// the release store on head publishes the slot contents to the consumer, and the release store on
+// tail hands the slot back to the producer. slots only hold descriptors, the payload is copied into a block from
+// the frame pool that the consumer frees when it pops the slot.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+#include <stdatomic.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_ring.h"
+#include "cmd_wifi_perf.h"
+#include "cmd_wifi_pool.h"
+
+_Static_assert((SNIFFER_RING_SLOTS & (SNIFFER_RING_SLOTS - 1)) == 0, "SNIFFER_RING_SLOTS must be a power of two");
+_Static_assert(FRAME_POOL_LARGE_SIZE >= SNIFFER_SLOT_PAYLOAD, "largest frame pool class must hold a full slot");
+
+static sniffer_frame_t ring_slots[SNIFFER_RING_SLOTS];
+static atomic_uint ring_head;
+static atomic_uint ring_tail;
+
+//-------------------------------------------------------------------------------------------------------------------------
+// counters, written by the producer only
+//-------------------------------------------------------------------------------------------------------------------------
+static atomic_uint ring_pushed;
+static atomic_uint ring_dropped;
+static atomic_uint ring_truncated;
+static atomic_uint ring_high_water;
+
+/**
+ * Copies a frame into the next free slot
+ * @param pkt Packet handed to the rx callback
+ * @param type Type of packet
+ * @return False if the ring was full or the frame pool had no block for it, and the frame was dropped
+ */
+bool sniffer_ring_push(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type)
+{
+    unsigned head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    unsigned used = head - tail;
+
+    uint16_t orig_len = pkt->rx_ctrl.sig_len;
+    uint16_t len = orig_len > SNIFFER_SLOT_PAYLOAD ? SNIFFER_SLOT_PAYLOAD : orig_len;
+    uint8_t *payload = used < SNIFFER_RING_SLOTS ? frame_pool_alloc(len) : NULL;
+
+    if (payload == NULL) {
+        atomic_store_explicit(&ring_dropped, atomic_load_explicit(&ring_dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        return false;
+    }
+
+    if (len < orig_len) {
+        atomic_store_explicit(&ring_truncated, atomic_load_explicit(&ring_truncated, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+
+    sniffer_frame_t *slot = &ring_slots[head & (SNIFFER_RING_SLOTS - 1)];
+    slot->rx_ctrl = pkt->rx_ctrl;
+    slot->type = type;
+    slot->orig_len = orig_len;
+    slot->len = len;
+    slot->payload = payload;
+    memcpy(payload, pkt->payload, len);
+    slot->queued_at = perf_now();
+
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // bookkeeping after publishing so the consumer can start right away
+    //-------------------------------------------------------------------------------------------------------------------------
+    atomic_store_explicit(&ring_pushed, atomic_load_explicit(&ring_pushed, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (used + 1 > atomic_load_explicit(&ring_high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring_high_water, used + 1, memory_order_relaxed);
+    }
+
+    return true;
+}
+
+/**
+ * Returns the oldest frame in the ring without removing it
+ * @return Oldest frame, or NULL if the ring is empty
+ */
+sniffer_frame_t *sniffer_ring_peek(void)
+{
+    unsigned tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring_head, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+
+    return &ring_slots[tail & (SNIFFER_RING_SLOTS - 1)];
+}
+
+/**
+ * Frees the payload of the oldest slot and hands the slot back to the producer
+ */
+void sniffer_ring_pop(void)
+{
+    unsigned tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    sniffer_frame_t *slot = &ring_slots[tail & (SNIFFER_RING_SLOTS - 1)];
+
+    frame_pool_free(slot->payload);
+    slot->payload = NULL;
+    atomic_store_explicit(&ring_tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Returns the number of frames waiting in the ring
+ * @return Number of used slots
+ */
+uint32_t sniffer_ring_count(void)
+{
+    unsigned head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    return head - tail;
+}
+
+/**
+ * Takes a snapshot of the ring counters
+ * @param stats Where to store the counters
+ */
+void sniffer_ring_get_stats(sniffer_ring_stats_t *stats)
+{
+    stats->pushed = atomic_load_explicit(&ring_pushed, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&ring_dropped, memory_order_relaxed);
+    stats->truncated = atomic_load_explicit(&ring_truncated, memory_order_relaxed);
+    stats->used = sniffer_ring_count();
+    stats->high_water = atomic_load_explicit(&ring_high_water, memory_order_relaxed);
+}
+
+/**
+ * Empties the ring, returns every payload block to the frame pool and clears all counters
+ */
+void sniffer_ring_reset(void)
+{
+    frame_pool_reset();
+    atomic_store(&ring_head, 0);
+    atomic_store(&ring_tail, 0);
+    atomic_store(&ring_pushed, 0);
+    atomic_store(&ring_dropped, 0);
+    atomic_store(&ring_truncated, 0);
+    atomic_store(&ring_high_water, 0);
+}
@@ -0,0 +1,74 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// ring geometry, slot count must be a power of two. payloads live in the frame pool, so a slot is only a descriptor
+//-------------------------------------------------------------------------------------------------------------------------
+#define SNIFFER_RING_SLOTS 64
+#define SNIFFER_SLOT_PAYLOAD 512
+
+// a captured frame, payload is truncated to SNIFFER_SLOT_PAYLOAD bytes and sized to the smallest pool block that fits
+typedef struct {
+    wifi_pkt_rx_ctrl_t rx_ctrl;
+    wifi_promiscuous_pkt_type_t type;
+    uint16_t len;       /* bytes stored in payload */
+    uint16_t orig_len;  /* bytes received over the air */
+    uint32_t queued_at; /* cycle count when pushed, for latency accounting */
+    uint8_t *payload;   /* frame pool block, returned by sniffer_ring_pop */
+} sniffer_frame_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped;   /* ring full or frame pool exhausted */
+    uint32_t truncated;
+    uint32_t used;
+    uint32_t high_water;
+} sniffer_ring_stats_t;
+
+// producer side, only ever called from the promiscuous rx callback
+bool sniffer_ring_push(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type);
+
+// consumer side, only ever called from the consumer task
+sniffer_frame_t *sniffer_ring_peek(void);
+void sniffer_ring_pop(void);
+
+// either side
+uint32_t sniffer_ring_count(void);
+void sniffer_ring_get_stats(sniffer_ring_stats_t *stats);
+
+// consumer side, only safe while the rx callback is unregistered
+void sniffer_ring_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,314 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <string.h>
+#include <stdatomic.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_survey.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// phy timing, 802.11-2020 clauses 15 to 19
+//-------------------------------------------------------------------------------------------------------------------------
+#define DSSS_LONG_PREAMBLE_US 192
+#define DSSS_SHORT_PREAMBLE_US 96
+#define OFDM_PREAMBLE_US 20
+#define HT_PREAMBLE_US 36           /* mixed format, one spatial stream */
+#define OFDM_SERVICE_TAIL_BITS 22
+#define OFDM_SYMBOL_Q4 64           /* 4 us */
+#define HT_SGI_SYMBOL_Q4 58         /* 3.6 us */
+
+// legacy rates from wifi_phy_rate_t in 500 kbps units, the first 8 are DSSS/CCK
+static const uint8_t survey_legacy_rates[16] = {
+    2, 4, 11, 22, 0, 4, 11, 22, 96, 48, 24, 12, 108, 72, 36, 18
+};
+
+// HT 20 MHz data bits per symbol for MCS0-7
+static const uint16_t survey_ht_dbps[8] = {
+    26, 52, 78, 104, 156, 208, 234, 260
+};
+
+#define RATE_6M 0x0b
+#define RATE_MCS0_LGI 0x10
+#define RATE_MCS0_SGI 0x18
+#define RATE_MCS7_SGI 0x1f
+
+typedef struct {
+    uint32_t second;            /* which second the bin holds */
+    uint32_t airtime;           /* 1/16 us */
+    uint16_t listen_ms;
+    uint16_t frames;
+} survey_bin_t;
+
+typedef struct {
+    uint64_t airtime;           /* 1/16 us */
+    uint64_t listen_ms;
+    uint32_t frames;
+    survey_bin_t bins[SURVEY_BINS];
+} survey_channel_t;
+
+// written by the rx callback, airtime and frames are emptied by survey_collect
+typedef struct {
+    atomic_uint airtime;        /* 1/16 us */
+    atomic_uint frames;
+    atomic_uint rssi[SURVEY_RSSI_BUCKETS];
+} survey_heard_t;
+
+static survey_channel_t survey_channels[SURVEY_CHANNELS];
+static survey_heard_t survey_heard[SURVEY_CHANNELS];
+static uint8_t survey_tuned;
+static uint32_t survey_tuned_at;
+
+/**
+ * Forgets everything, the current channel keeps being listened to
+ */
+void survey_clear(void)
+{
+    memset(survey_channels, 0, sizeof(survey_channels));
+    for (int i = 0; i < SURVEY_CHANNELS; i++) {
+        survey_heard_t *heard = &survey_heard[i];
+        atomic_store_explicit(&heard->airtime, 0, memory_order_relaxed);
+        atomic_store_explicit(&heard->frames, 0, memory_order_relaxed);
+        for (int j = 0; j < SURVEY_RSSI_BUCKETS; j++) {
+            atomic_store_explicit(&heard->rssi[j], 0, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Returns the bin of a channel for a second, recycling it if it held an older second
+ * @param ch Channel state
+ * @param second Second
+ * @return Bin
+ */
+static survey_bin_t *survey_bin(survey_channel_t *ch, uint32_t second)
+{
+    survey_bin_t *bin = &ch->bins[second % SURVEY_BINS];
+    if (bin->second != second) {
+        memset(bin, 0, sizeof(*bin));
+        bin->second = second;
+    }
+    return bin;
+}
+
+/**
+ * Adds listening time to a channel, split over the seconds it covers
+ * @param channel Channel 1..SURVEY_CHANNELS
+ * @param from_ms Start
+ * @param to_ms End
+ */
+static void survey_add_listen(uint8_t channel, uint32_t from_ms, uint32_t to_ms)
+{
+    survey_channel_t *ch = &survey_channels[channel - 1];
+    uint32_t duration = to_ms - from_ms;
+    ch->listen_ms += duration;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // only the part that can still be in the window goes into bins
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (duration > SURVEY_BINS * 1000) {
+        from_ms = to_ms - SURVEY_BINS * 1000;
+    }
+    while (from_ms != to_ms) {
+        uint32_t second = from_ms / 1000;
+        uint32_t end = (second + 1) * 1000;
+        if (end - from_ms > to_ms - from_ms) {
+            end = to_ms;
+        }
+        survey_bin(ch, second)->listen_ms += end - from_ms;
+        from_ms = end;
+    }
+}
+
+/**
+ * Records a channel change
+ * @param channel New channel, 0 when the radio stopped listening
+ * @param now_ms Current time in ms
+ */
+void survey_tune(uint8_t channel, uint32_t now_ms)
+{
+    survey_collect(now_ms);
+    if (survey_tuned != 0) {
+        survey_add_listen(survey_tuned, survey_tuned_at, now_ms);
+    }
+    survey_tuned = channel <= SURVEY_CHANNELS ? channel : 0;
+    survey_tuned_at = now_ms;
+}
+
+/**
+ * Estimates how long a frame occupied the medium
+ * @param rate wifi_phy_rate_t of the frame, unknown rates count as 6 Mbps
+ * @param len Length on air including the FCS
+ * @return Airtime in 1/16 us
+ */
+uint32_t survey_airtime(uint8_t rate, uint16_t len)
+{
+    uint32_t bits = 8u * len;
+
+    if (rate >= RATE_MCS0_LGI && rate <= RATE_MCS7_SGI) {
+        uint32_t dbps = survey_ht_dbps[rate & 7];
+        uint32_t symbols = (OFDM_SERVICE_TAIL_BITS + bits + dbps - 1) / dbps;
+        return (HT_PREAMBLE_US << SURVEY_AIRTIME_SHIFT) +
+               symbols * (rate >= RATE_MCS0_SGI ? HT_SGI_SYMBOL_Q4 : OFDM_SYMBOL_Q4);
+    }
+
+    if (rate >= sizeof(survey_legacy_rates) || survey_legacy_rates[rate] == 0) {
+        rate = RATE_6M;
+    }
+    uint32_t units = survey_legacy_rates[rate];
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // DSSS/CCK sends bits back to back, a bit takes 2 / units us
+    //-------------------------------------------------------------------------------------------------------------------------
+    if (rate < 8) {
+        uint32_t preamble = rate < 4 ? DSSS_LONG_PREAMBLE_US : DSSS_SHORT_PREAMBLE_US;
+        return (preamble << SURVEY_AIRTIME_SHIFT) + ((bits << (SURVEY_AIRTIME_SHIFT + 1)) + units - 1) / units;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // OFDM packs 4 us symbols of rate_mbps * 4 = 2 * units bits
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t dbps = 2 * units;
+    uint32_t symbols = (OFDM_SERVICE_TAIL_BITS + bits + dbps - 1) / dbps;
+    return (OFDM_PREAMBLE_US << SURVEY_AIRTIME_SHIFT) + symbols * OFDM_SYMBOL_Q4;
+}
+
+/**
+ * Accounts one frame, only touches atomics so the rx callback can call it for every frame
+ * @param channel Channel it was heard on
+ * @param rssi RSSI
+ * @param rate wifi_phy_rate_t of the frame
+ * @param len Length on air including the FCS
+ */
+void survey_add_frame(uint8_t channel, int8_t rssi, uint8_t rate, uint16_t len)
+{
+    if (channel == 0 || channel > SURVEY_CHANNELS) {
+        return;
+    }
+    survey_heard_t *heard = &survey_heard[channel - 1];
+
+    int bucket = (rssi - SURVEY_RSSI_MIN) / SURVEY_RSSI_STEP;
+    if (bucket < 0) {
+        bucket = 0;
+    } else if (bucket >= SURVEY_RSSI_BUCKETS) {
+        bucket = SURVEY_RSSI_BUCKETS - 1;
+    }
+
+    atomic_fetch_add_explicit(&heard->airtime, survey_airtime(rate, len), memory_order_relaxed);
+    atomic_fetch_add_explicit(&heard->frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&heard->rssi[bucket], 1, memory_order_relaxed);
+}
+
+/**
+ * Moves the frames added since the last call into the totals and the bin of the current second
+ * @param now_ms Current time in ms
+ */
+void survey_collect(uint32_t now_ms)
+{
+    for (int i = 0; i < SURVEY_CHANNELS; i++) {
+        survey_heard_t *heard = &survey_heard[i];
+        if (atomic_load_explicit(&heard->frames, memory_order_relaxed) == 0) {
+            continue;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // a frame landing between the two exchanges has its airtime counted now and itself on the next call
+        //-------------------------------------------------------------------------------------------------------------------------
+        uint32_t frames = atomic_exchange_explicit(&heard->frames, 0, memory_order_relaxed);
+        uint32_t airtime = atomic_exchange_explicit(&heard->airtime, 0, memory_order_relaxed);
+
+        survey_channel_t *ch = &survey_channels[i];
+        ch->airtime += airtime;
+        ch->frames += frames;
+
+        survey_bin_t *bin = survey_bin(ch, now_ms / 1000);
+        bin->airtime += airtime;
+        bin->frames = frames < (uint32_t)(UINT16_MAX - bin->frames) ? bin->frames + frames : UINT16_MAX;
+    }
+}
+
+/**
+ * Airtime over listening time
+ * @param airtime Airtime in 1/16 us
+ * @param listen_ms Listening time
+ * @return Permille, capped at 1000
+ */
+static uint16_t survey_permille(uint64_t airtime, uint64_t listen_ms)
+{
+    if (listen_ms == 0) {
+        return 0;
+    }
+    uint64_t permille = airtime / (listen_ms << SURVEY_AIRTIME_SHIFT);
+    return permille < 1000 ? (uint16_t)permille : 1000;
+}
+
+/**
+ * Fills the report of a channel
+ * @param channel Channel 1..SURVEY_CHANNELS
+ * @param now_ms Current time in ms, listening up to now is counted
+ * @param report Report to fill
+ * @return False if the channel was neither heard nor listened to
+ */
+bool survey_report(uint8_t channel, uint32_t now_ms, survey_report_t *report)
+{
+    if (channel == 0 || channel > SURVEY_CHANNELS) {
+        return false;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // close the running listening interval and collect new frames so the current channel is up to date
+    //-------------------------------------------------------------------------------------------------------------------------
+    survey_tune(survey_tuned, now_ms);
+
+    const survey_channel_t *ch = &survey_channels[channel - 1];
+    if (ch->frames == 0 && ch->listen_ms == 0) {
+        return false;
+    }
+
+    report->listen_ms = ch->listen_ms;
+    report->airtime_us = ch->airtime >> SURVEY_AIRTIME_SHIFT;
+    report->frames = ch->frames;
+    report->utilisation = survey_permille(ch->airtime, ch->listen_ms);
+    for (int i = 0; i < SURVEY_RSSI_BUCKETS; i++) {
+        report->rssi[i] = atomic_load_explicit(&survey_heard[channel - 1].rssi[i], memory_order_relaxed);
+    }
+
+    report->peak = 0;
+    uint32_t now_second = now_ms / 1000;
+    for (int i = 0; i < SURVEY_BINS; i++) {
+        const survey_bin_t *bin = &ch->bins[i];
+        if (now_second - bin->second >= SURVEY_BINS || bin->listen_ms < SURVEY_PEAK_MIN_LISTEN_MS) {
+            continue;
+        }
+        uint16_t permille = survey_permille(bin->airtime, bin->listen_ms);
+        if (permille > report->peak) {
+            report->peak = permille;
+        }
+    }
+    return true;
+}
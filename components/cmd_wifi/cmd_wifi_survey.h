@@ -0,0 +1,81 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------------------------------
+// per channel airtime and rssi survey
+//
+// airtime is estimated from the length and rate of every received frame, whatever the filters, and kept in 1/16 us
+// units. frames are counted lock free from the rx callback and collected into the tables later. listening time comes
+// from channel changes, so utilisation stays right while hopping. the last SURVEY_BINS seconds are also kept per second
+// for the busiest second.
+//-------------------------------------------------------------------------------------------------------------------------
+#define SURVEY_CHANNELS 14
+#define SURVEY_BINS 32
+#define SURVEY_AIRTIME_SHIFT 4          /* airtime fixed point, 1/16 us */
+
+// rssi histogram, SURVEY_RSSI_STEP dB wide buckets from SURVEY_RSSI_MIN, the ends catch everything beyond
+#define SURVEY_RSSI_BUCKETS 16
+#define SURVEY_RSSI_MIN -100
+#define SURVEY_RSSI_STEP 5
+
+// seconds with less listening than this are left out of the peak, a 20 ms dwell says little about a second
+#define SURVEY_PEAK_MIN_LISTEN_MS 100
+
+typedef struct {
+    uint64_t listen_ms;
+    uint64_t airtime_us;
+    uint32_t frames;
+    uint16_t utilisation;       /* permille of listening time */
+    uint16_t peak;              /* permille, busiest second in the window */
+    uint32_t rssi[SURVEY_RSSI_BUCKETS];
+} survey_report_t;
+
+void survey_clear(void);
+
+// records that the radio is now on channel, 0 when it stopped listening
+void survey_tune(uint8_t channel, uint32_t now_ms);
+
+// accounts one frame, len is the length on air including the FCS. lock free, safe to call from the rx callback
+void survey_add_frame(uint8_t channel, int8_t rssi, uint8_t rate, uint16_t len);
+
+// moves the frames added since the last call into the tables, at least once a second to keep the busiest second right
+void survey_collect(uint32_t now_ms);
+
+// estimated airtime of a frame in 1/16 us
+uint32_t survey_airtime(uint8_t rate, uint16_t len);
+
+// fills a report for channel 1..SURVEY_CHANNELS, returns false if nothing was heard or listened to on it
+bool survey_report(uint8_t channel, uint32_t now_ms, survey_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
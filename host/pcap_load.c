@@ -0,0 +1,280 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// pcap reader shared by the replay driver and the host tests
+//
+// reads classic pcap files in either byte order and timestamp resolution, with raw 802.11 or radiotap link types,
+// and hands every frame over with the receive metadata the sniffer keeps.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "pcap_load.h"
+#include "cmd_wifi_decode.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// pcap constants, see https://www.tcpdump.org/linktypes.html
+//-------------------------------------------------------------------------------------------------------------------------
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_GLOBAL_HEADER_LEN 24
+#define PCAP_RECORD_HEADER_LEN 16
+#define LINKTYPE_IEEE802_11 105
+#define LINKTYPE_IEEE802_11_RADIOTAP 127
+
+#define RADIOTAP_F_FCS 0x10
+
+//-------------------------------------------------------------------------------------------------------------------------
+// legacy rates from wifi_phy_rate_t in 500 kbps units, same table the pcap writer uses
+//-------------------------------------------------------------------------------------------------------------------------
+static const uint8_t legacy_rates[16] = {
+    2, 4, 11, 22, 0, 4, 11, 22, 96, 48, 24, 12, 108, 72, 36, 18
+};
+
+static inline uint16_t rd16(const uint8_t *p, bool swap)
+{
+    return swap ? (uint16_t)(p[0] << 8 | p[1]) : (uint16_t)(p[1] << 8 | p[0]);
+}
+
+static inline uint32_t rd32(const uint8_t *p, bool swap)
+{
+    return swap ? (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]
+                : (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+/**
+ * Maps a radiotap rate back to wifi_phy_rate_t
+ * @param rate Rate in 500 kbps units
+ * @return Rate index, 0 if the rate isn't a legacy rate
+ */
+static uint8_t rate_index(uint8_t rate)
+{
+    for (uint8_t i = 0; i < sizeof(legacy_rates); i++) {
+        if (legacy_rates[i] == rate && rate != 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Maps a frequency to its channel number
+ * @param freq Frequency in MHz
+ * @return Channel, 0 if unknown
+ */
+static uint8_t freq_channel(uint16_t freq)
+{
+    if (freq == 2484) {
+        return 14;
+    }
+    if (freq >= 2412 && freq <= 2472) {
+        return (freq - 2407) / 5;
+    }
+    if (freq >= 5000 && freq <= 5900) {
+        return (freq - 5000) / 5;
+    }
+    return 0;
+}
+
+/**
+ * Reads the fields the sniffer keeps out of a radiotap header, fields after antenna noise are skipped
+ * @param buf Start of the radiotap header
+ * @param caplen Bytes captured for the record
+ * @param frame Frame whose metadata is filled in
+ * @param has_fcs Set if the frame carries its FCS
+ * @param has_tsft Set if the header had a timestamp
+ * @return Length of the radiotap header, 0 if it is malformed
+ */
+static uint16_t parse_radiotap(const uint8_t *buf, uint32_t caplen, pipeline_frame_t *frame, bool *has_fcs, bool *has_tsft)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // field alignment and size by presence bit: tsft, flags, rate, channel, fhss, antenna signal, antenna noise
+    //-------------------------------------------------------------------------------------------------------------------------
+    static const uint8_t field_align[7] = {8, 1, 1, 2, 2, 1, 1};
+    static const uint8_t field_size[7] = {8, 1, 1, 4, 2, 1, 1};
+
+    if (caplen < 8 || buf[0] != 0) {
+        return 0;
+    }
+    uint16_t len = rd16(&buf[2], false);
+    if (len < 8 || len > caplen) {
+        return 0;
+    }
+
+    uint32_t present = rd32(&buf[4], false);
+    uint32_t off = 8;
+    for (uint32_t word = present; word & (1u << 31); off += 4) {
+        if (off + 4 > len) {
+            return 0;
+        }
+        word = rd32(&buf[off], false);
+    }
+
+    for (int bit = 0; bit < 7; bit++) {
+        if (!(present & (1u << bit))) {
+            continue;
+        }
+        off = (off + field_align[bit] - 1) & ~(uint32_t)(field_align[bit] - 1);
+        if (off + field_size[bit] > len) {
+            break;
+        }
+        switch (bit) {
+            case 0:
+                frame->timestamp = rd32(&buf[off], false);
+                *has_tsft = true;
+                break;
+            case 1:
+                *has_fcs = (buf[off] & RADIOTAP_F_FCS) != 0;
+                break;
+            case 2:
+                frame->rate = rate_index(buf[off]);
+                break;
+            case 3:
+                frame->channel = freq_channel(rd16(&buf[off], false));
+                break;
+            case 5:
+                frame->rssi = (int8_t)buf[off];
+                break;
+            case 6:
+                frame->noise = (int8_t)buf[off];
+                break;
+        }
+        off += field_size[bit];
+    }
+    return len;
+}
+
+/**
+ * Loads every 802.11 frame of a pcap file, the file stays in memory for the frames to point into
+ * @param path File to load
+ * @param max_len Bytes of each frame kept, longer frames are truncated like the capture ring does
+ * @param add Called for every frame, loading stops if it returns false
+ * @param ctx Passed to add
+ * @return Number of frames loaded or -1 on error
+ */
+long pcap_load(const char *path, uint16_t max_len, pcap_frame_cb_t add, void *ctx)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = size > 0 ? malloc(size) : NULL;
+    if (buf == NULL || fread(buf, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        fclose(f);
+        free(buf);
+        return -1;
+    }
+    fclose(f);
+
+    if (size < PCAP_GLOBAL_HEADER_LEN) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        free(buf);
+        return -1;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // both byte orders and both timestamp resolutions, the sniffer itself writes little endian microseconds
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t magic = rd32(buf, false);
+    bool swap = false;
+    bool nanos = false;
+    if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+        nanos = magic == PCAP_MAGIC_NS;
+    } else if (rd32(buf, true) == PCAP_MAGIC_US || rd32(buf, true) == PCAP_MAGIC_NS) {
+        swap = true;
+        nanos = rd32(buf, true) == PCAP_MAGIC_NS;
+    } else {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        free(buf);
+        return -1;
+    }
+
+    uint32_t linktype = rd32(&buf[20], swap);
+    if (linktype != LINKTYPE_IEEE802_11 && linktype != LINKTYPE_IEEE802_11_RADIOTAP) {
+        fprintf(stderr, "%s: unsupported link type %"PRIu32", need 802.11 or radiotap\n", path, linktype);
+        free(buf);
+        return -1;
+    }
+
+    long loaded = 0;
+    long off = PCAP_GLOBAL_HEADER_LEN;
+    while (off + PCAP_RECORD_HEADER_LEN <= size) {
+        uint32_t ts_sec = rd32(&buf[off], swap);
+        uint32_t ts_frac = rd32(&buf[off + 4], swap);
+        uint32_t incl_len = rd32(&buf[off + 8], swap);
+        uint32_t orig_len = rd32(&buf[off + 12], swap);
+        off += PCAP_RECORD_HEADER_LEN;
+        if (incl_len > (uint32_t)(size - off)) {
+            fprintf(stderr, "%s: truncated record at offset %ld\n", path, off);
+            break;
+        }
+
+        pipeline_frame_t frame = {0};
+        const uint8_t *data = &buf[off];
+        uint16_t header = 0;
+        bool has_fcs = false;
+        bool has_tsft = false;
+        if (linktype == LINKTYPE_IEEE802_11_RADIOTAP) {
+            header = parse_radiotap(data, incl_len, &frame, &has_fcs, &has_tsft);
+            if (header == 0) {
+                off += incl_len;
+                continue;
+            }
+        }
+        off += incl_len;
+
+        if (!has_tsft) {
+            uint64_t us = (uint64_t)ts_sec * 1000000 + (nanos ? ts_frac / 1000 : ts_frac);
+            frame.timestamp = (uint32_t)us;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // orig_len counts the FCS on the device, so frames captured without one look truncated and nothing is stripped
+        //-------------------------------------------------------------------------------------------------------------------------
+        uint32_t captured = incl_len - header;
+        uint32_t wire = (orig_len > header ? orig_len - header : captured) + (has_fcs ? 0 : WIFI_FCS_LEN);
+        frame.payload = data + header;
+        frame.len = captured < max_len ? captured : max_len;
+        frame.orig_len = wire < UINT16_MAX ? wire : UINT16_MAX;
+
+        if (!add(&frame, ctx)) {
+            return -1;
+        }
+        loaded++;
+    }
+    return loaded;
+}
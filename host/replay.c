@@ -0,0 +1,465 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+//-------------------------------------------------------------------------------------------------------------------------
+// host replay driver
+//
+// feeds pcap files through the same filter, table and output code the sniffer runs, so throughput can be measured
+// and output compared on a linux box. frames are loaded into memory first and truncated like the capture ring does,
+// then every pass runs filter -> consume -> output over all of them and reports frames/s.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_pipeline.h"
+#include "cmd_wifi_mac.h"
+#include "cmd_wifi_maclist.h"
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_devices.h"
+#include "cmd_wifi_aps.h"
+#include "cmd_wifi_survey.h"
+#include "cmd_wifi_detect.h"
+#include "cmd_wifi_eapol.h"
+#include "cmd_wifi_compact.h"
+#include "cmd_wifi_batch.h"
+#include "pcap_load.h"
+
+// SNIFFER_SLOT_PAYLOAD, frames longer than a ring slot are truncated the same way
+#define REPLAY_SLOT_PAYLOAD 512
+
+typedef enum {
+    REPLAY_STATS,
+    REPLAY_TEXT,
+    REPLAY_COMPACT,
+    REPLAY_FRAMED,
+    REPLAY_HC22000,
+    REPLAY_UNKNOWN
+} replay_format_t;
+
+static const char *replay_format_name[] = {
+    "stats",
+    "text",
+    "compact",
+    "framed",
+    "hc22000"
+};
+
+static pipeline_frame_t *frames;
+static size_t frame_count;
+static size_t frame_capacity;
+static uint64_t frame_bytes;
+
+// text format detail, the firmware picks it in menuconfig
+static bool text_brief;
+
+// output of the first pass, later passes write to the null sink
+static uint64_t output_bytes;
+static uint32_t output_crc;
+
+/**
+ * Monotonic clock
+ * @return Nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Appends a frame to the replay set
+ * @param frame Frame to append
+ * @param ctx Unused
+ * @return False if out of memory
+ */
+static bool add_frame(const pipeline_frame_t *frame, void *ctx)
+{
+    if (frame_count == frame_capacity) {
+        size_t capacity = frame_capacity > 0 ? frame_capacity * 2 : 4096;
+        pipeline_frame_t *grown = realloc(frames, capacity * sizeof(*frames));
+        if (grown == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return false;
+        }
+        frames = grown;
+        frame_capacity = capacity;
+    }
+    frames[frame_count++] = *frame;
+    frame_bytes += frame->orig_len;
+    return true;
+}
+
+/**
+ * Writes encoded output and keeps a fingerprint of the first pass
+ * @param out Sink
+ * @param data Bytes to write
+ * @param len Number of bytes
+ * @param first Whether this is the first pass
+ */
+static void emit(FILE *out, const uint8_t *data, size_t len, bool first)
+{
+    fwrite(data, len, 1, out);
+    if (first) {
+        output_bytes += len;
+        output_crc = batch_crc32(output_crc, data, len);
+    }
+}
+
+/**
+ * Name of the driver packet type a frame would have been delivered as
+ * @param frame Frame
+ * @return Same strings as get_type()
+ */
+static const char *packet_type(const pipeline_frame_t *frame)
+{
+    if (frame->len < 1) {
+        return "Unknown Packet";
+    }
+    switch ((frame->payload[0] >> 2) & 0x3) {
+        case WIFI_TYPE_MGMT:
+            return "Management Packet";
+        case WIFI_TYPE_CTRL:
+            return "Control Packet";
+        case WIFI_TYPE_DATA:
+            return "Data Packet";
+        default:
+            return "Misc Packet";
+    }
+}
+
+/**
+ * Runs every loaded frame through the pipeline once
+ * @param filter Filter in effect
+ * @param format Output format
+ * @param out Output sink
+ * @param first Whether this is the first pass
+ * @param batch_frames Frames per batch for the framed format
+ * @param snaplen Snaplen for the compact and framed formats
+ * @return Number of frames accepted by the filter
+ */
+static size_t run_pass(const pipeline_filter_t *filter, replay_format_t format, FILE *out, bool first,
+                       uint16_t batch_frames, uint16_t snaplen)
+{
+    //-------------------------------------------------------------------------------------------------------------------------
+    // every pass starts from empty tables and a fresh stream so they all do the same work
+    //-------------------------------------------------------------------------------------------------------------------------
+    devices_clear();
+    aps_clear();
+    survey_clear();
+    detect_clear();
+    eapol_clear();
+    uint8_t tuned = 0;
+    uint32_t now_ms = 0;
+    uint8_t record[REPLAY_SLOT_PAYLOAD + COMPACT_OVERHEAD_MAX];
+    if (format == REPLAY_COMPACT) {
+        compact_begin(snaplen);
+        emit(out, record, compact_write_header(record), first);
+    } else if (format == REPLAY_FRAMED) {
+        batch_begin(batch_frames, snaplen);
+    }
+
+    size_t accepted = 0;
+    for (size_t i = 0; i < frame_count; i++) {
+        const pipeline_frame_t *frame = &frames[i];
+        now_ms = frame->timestamp / 1000;
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // a capture has no record of the radio retuning, take the channel of each frame as where it listened
+        //-------------------------------------------------------------------------------------------------------------------------
+        if (frame->channel != tuned) {
+            tuned = frame->channel;
+            survey_tune(tuned, now_ms);
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // the flood detector and the survey run ahead of the filters, as in the rx callback
+        //-------------------------------------------------------------------------------------------------------------------------
+        detect_frame(frame->payload, frame->len, now_ms);
+        survey_add_frame(frame->channel, frame->rssi, frame->rate, frame->orig_len);
+        survey_collect(now_ms);
+
+        if (!pipeline_filter(filter, frame)) {
+            continue;
+        }
+        accepted++;
+        pipeline_consume(frame, now_ms);
+
+        compact_meta_t meta;
+        const uint8_t *batch;
+        char line[EAPOL_LINE_MAX];
+        switch (format) {
+            case REPLAY_TEXT:
+                if (text_brief) {
+                    pipeline_print_brief(out, frame, filter->watchlist);
+                } else {
+                    pipeline_print_frame(out, frame, packet_type(frame), filter->watchlist);
+                }
+                break;
+            case REPLAY_COMPACT:
+                pipeline_compact_meta(frame, &meta);
+                emit(out, record, compact_encode_frame(&meta, frame->payload, frame->len, frame->orig_len, record), first);
+                break;
+            case REPLAY_FRAMED:
+                pipeline_compact_meta(frame, &meta);
+                if (batch_add(&meta, frame->payload, frame->len, frame->orig_len)) {
+                    emit(out, batch, batch_seal(&batch), first);
+                }
+                break;
+            case REPLAY_HC22000:
+                eapol_update_frame(frame->payload, frame->len, frame->len == frame->orig_len, now_ms);
+                while (eapol_next_line(line, sizeof(line))) {
+                    size_t n = strlen(line);
+                    line[n++] = '\n';
+                    emit(out, (const uint8_t *)line, n, first);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    survey_tune(0, now_ms);
+
+    if (format == REPLAY_FRAMED && batch_pending() > 0) {
+        const uint8_t *batch;
+        emit(out, batch, batch_seal(&batch), first);
+    }
+    fflush(out);
+    return accepted;
+}
+
+/**
+ * Prints usage
+ * @param name Program name
+ */
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] file.pcap...\n"
+            "  --format <stats|text|compact|framed|hc22000>  Output format (default stats)\n"
+            "  --filter <expr>                               Filter expression, same syntax as start --filter\n"
+            "  --mac <mac_address>                           Mac Address to watch for, can be repeated\n"
+            "  --macfile <path>                              Load watched Mac Addresses from a file, one per line\n"
+            "  --match <addr1|addr2|addr3|any>               Header addresses checked against the watchlist (default addr2)\n"
+            "  --snaplen <bytes>                             Bytes kept per frame in compact and framed output (default 0)\n"
+            "  --batch <frames>                              Frames per batch in framed output (default %i)\n"
+            "  --repeat <n>                                  Number of timed passes (default 5)\n"
+            "  --out <path>                                  Write the output of the first pass to a file\n"
+            "  --brief                                       One line per frame in text output, as CONFIG_SNIFFER_TEXT_BRIEF\n",
+            name, BATCH_DEFAULT_FRAMES);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"format", required_argument, NULL, 'f'},
+        {"filter", required_argument, NULL, 'e'},
+        {"mac", required_argument, NULL, 'm'},
+        {"macfile", required_argument, NULL, 'l'},
+        {"match", required_argument, NULL, 'a'},
+        {"snaplen", required_argument, NULL, 's'},
+        {"batch", required_argument, NULL, 'b'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"out", required_argument, NULL, 'o'},
+        {"brief", no_argument, NULL, 't'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+
+    pipeline_filter_t filter = { .match_mask = MATCH_ADDR2 };
+    replay_format_t format = REPLAY_STATS;
+    const char *out_path = NULL;
+    int repeat = 5;
+    int snaplen = COMPACT_SNAPLEN_HEADER;
+    int batch_frames = BATCH_DEFAULT_FRAMES;
+    char err[64];
+    uint8_t mac[MAC_LEN];
+
+    maclist_clear();
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'f':
+                format = REPLAY_UNKNOWN;
+                for (int i = 0; i < REPLAY_UNKNOWN; i++) {
+                    if (strcmp(optarg, replay_format_name[i]) == 0) {
+                        format = i;
+                    }
+                }
+                if (format == REPLAY_UNKNOWN) {
+                    fprintf(stderr, "Unknown format: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'e':
+                if (!bpf_compile(optarg, &filter.program, err, sizeof(err))) {
+                    fprintf(stderr, "Invalid filter: %s\n", err);
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (!mac_parse(optarg, mac) || !maclist_add(mac)) {
+                    fprintf(stderr, "Invalid Mac Address: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                if (maclist_load_file(optarg) < 0) {
+                    return 1;
+                }
+                break;
+            case 'a':
+                if (strcmp(optarg, "any") == 0) {
+                    filter.match_mask = MATCH_ADDR1 | MATCH_ADDR2 | MATCH_ADDR3;
+                } else {
+                    filter.match_mask = (strstr(optarg, "addr1") ? MATCH_ADDR1 : 0) |
+                                        (strstr(optarg, "addr2") ? MATCH_ADDR2 : 0) |
+                                        (strstr(optarg, "addr3") ? MATCH_ADDR3 : 0);
+                }
+                if (filter.match_mask == 0) {
+                    fprintf(stderr, "Invalid match: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                snaplen = atoi(optarg);
+                break;
+            case 'b':
+                batch_frames = atoi(optarg);
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 't':
+                text_brief = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind >= argc || repeat < 1 || snaplen < 0 || snaplen > REPLAY_SLOT_PAYLOAD ||
+        batch_frames < 1 || batch_frames > UINT16_MAX) {
+        usage(argv[0]);
+        return 1;
+    }
+    filter.watchlist = maclist_count() > 0;
+
+    for (int i = optind; i < argc; i++) {
+        if (pcap_load(argv[i], REPLAY_SLOT_PAYLOAD, &add_frame, NULL) < 0) {
+            return 1;
+        }
+    }
+    printf("Loaded %zu frames (%.1f KB) from %i file(s)\n", frame_count, frame_bytes / 1024.0, argc - optind);
+    if (frame_count == 0) {
+        return 1;
+    }
+
+    FILE *sink = fopen("/dev/null", "wb");
+    FILE *out = out_path != NULL ? fopen(out_path, "wb") : sink;
+    if (sink == NULL || out == NULL) {
+        fprintf(stderr, "Failed to open output\n");
+        return 1;
+    }
+
+    size_t accepted = 0;
+    double best = 0;
+    double total = 0;
+    for (int pass = 0; pass < repeat; pass++) {
+        uint64_t start = now_ns();
+        accepted = run_pass(&filter, format, pass == 0 ? out : sink, pass == 0, batch_frames, snaplen);
+        double elapsed = (now_ns() - start) / 1e9;
+        double rate = elapsed > 0 ? frame_count / elapsed : 0;
+        printf("Pass %i: %.3f ms, %.0f frames/s, %.1f MB/s\n", pass + 1, elapsed * 1000, rate,
+               elapsed > 0 ? frame_bytes / elapsed / 1e6 : 0);
+        best = rate > best ? rate : best;
+        total += elapsed;
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // everything below is deterministic for a given input and options, diff it to catch regressions
+    //-------------------------------------------------------------------------------------------------------------------------
+    uint32_t ap_frames;
+    uint32_t ap_parses;
+    aps_get_totals(&ap_frames, &ap_parses);
+    printf("Format: %s\n", replay_format_name[format]);
+    printf("Frames accepted: %zu/%zu\n", accepted, frame_count);
+    printf("Devices: %"PRIu32" (%"PRIu32" evicted)\n", devices_count(), devices_evictions());
+    printf("Access points: %"PRIu32" (%"PRIu32" evicted), %"PRIu32" beacons and probe responses, %"PRIu32" parses\n",
+           aps_count(), aps_evictions(), ap_frames, ap_parses);
+    for (uint8_t channel = 1; channel <= SURVEY_CHANNELS; channel++) {
+        survey_report_t report;
+        if (survey_report(channel, 0, &report)) {
+            printf("Channel %u: %"PRIu32" frames, %"PRIu64" ms airtime in %"PRIu64" ms, %.1f%% utilisation\n", channel,
+                   report.frames, report.airtime_us / 1000, report.listen_ms, report.utilisation / 10.0);
+        }
+    }
+    uint32_t detected;
+    uint32_t raised;
+    detect_get_totals(&detected, &raised);
+    printf("Flood detector: %"PRIu32" frames, %"PRIu32" events\n", detected, raised);
+    detect_event_t events[DETECT_LOG];
+    size_t n_events = detect_recent(events, DETECT_LOG, 0);
+    for (size_t i = 0; i < n_events; i++) {
+        char mac[MAC_STR_LEN];
+        mac_format(mac, events[i].mac);
+        printf("  %u: %s flood, %s %s, %u frames/s\n", events[i].seq, detect_kind_name[events[i].kind],
+               detect_role_name[events[i].role], mac, events[i].rate);
+    }
+    if (format == REPLAY_HC22000) {
+        eapol_stats_t eapol_stats;
+        eapol_get_stats(&eapol_stats);
+        printf("EAPOL-Key frames: %"PRIu32", handshakes: %"PRIu32", PMKIDs: %"PRIu32", duplicates: %"PRIu32", no ESSID: %"PRIu32"\n",
+               eapol_stats.keys, eapol_stats.handshakes, eapol_stats.pmkids, eapol_stats.duplicates,
+               eapol_stats.pending + eapol_stats.dropped);
+    }
+    if (format == REPLAY_COMPACT || format == REPLAY_FRAMED || format == REPLAY_HC22000) {
+        printf("Output: %"PRIu64" bytes, crc32 %08"PRIx32"\n", output_bytes, output_crc);
+    }
+    printf("Mean: %.0f frames/s, best: %.0f frames/s\n", frame_count * repeat / total, best);
+
+    if (out != sink) {
+        fclose(out);
+    }
+    fclose(sink);
+    return 0;
+}
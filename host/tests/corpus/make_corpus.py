@@ -0,0 +1,331 @@
+#!/usr/bin/env python3
+#
+# esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+# Copyright (C) 2024 dj1ch
+#
+# Distributed under the MIT License. See `LICENSE` for more information.
+#
+# Writes the pcap files the host tests replay. The frames follow the byte layout of frames
+# captured off the air: radiotap headers as the sniffer writes them, the FCS, element lists as
+# access points send them. Everything is seeded, so running this again gives the same files.
+#
+# reference.pcap  three seconds of traffic on channels 1, 6 and 11: beacons from WPA2, open,
+#                 WPA3 and hidden networks, probes, QoS and null data, control frames, a deauth
+#                 flood, a WPA2 4-way handshake with PMKID (passphrase "password123"), and a
+#                 few frames cut short by the capture
+# eapol.pcap      PMKIDs from five networks whose beacons turn up late, more than the capture queue
+#                 holds, and a retransmission of the one that was pushed out (passphrase "password123")
+# decode.pcap     one frame per header layout and element list corner case test_decode.c looks at,
+#                 in the order listed in decode() below
+#
+# usage: python3 host/tests/corpus/make_corpus.py [output directory]
+#
+
+import hashlib
+import hmac
+import os
+import random
+import struct
+import sys
+import zlib
+
+LINKTYPE_RADIOTAP = 127
+RADIOTAP_PRESENT = 0x6f     # tsft, flags, rate, channel, antenna signal, antenna noise
+RADIOTAP_F_FCS = 0x10
+CHANNEL_FREQ = {1: 2412, 6: 2437, 11: 2462}
+CHANNEL_2GHZ_OFDM = 0x00c0
+
+
+def mac(text):
+    return bytes.fromhex(text.replace(":", ""))
+
+
+BROADCAST = mac("ff:ff:ff:ff:ff:ff")
+
+
+class Capture:
+    """Collects radiotap records in capture order."""
+
+    def __init__(self):
+        self.records = []
+
+    def add(self, t_us, channel, rssi, frame, rate=2, fcs=True, snap=None):
+        if fcs:
+            frame += struct.pack("<I", zlib.crc32(frame))
+        radiotap = struct.pack("<BBHI", 0, 0, 24, RADIOTAP_PRESENT)
+        radiotap += struct.pack("<QBBHHbb", t_us, RADIOTAP_F_FCS if fcs else 0, rate,
+                                CHANNEL_FREQ[channel], CHANNEL_2GHZ_OFDM, rssi, -95)
+        data = radiotap + frame
+        captured = data if snap is None else data[:len(radiotap) + snap]
+        self.records.append((t_us, captured, len(data)))
+
+    def write(self, path):
+        with open(path, "wb") as f:
+            f.write(struct.pack("<IHHiIII", 0xa1b2c3d4, 2, 4, 0, 0, 65535, LINKTYPE_RADIOTAP))
+            for t_us, data, orig_len in sorted(self.records, key=lambda r: r[0]):
+                f.write(struct.pack("<IIII", t_us // 1000000, t_us % 1000000, len(data), orig_len))
+                f.write(data)
+
+
+#-------------------------------------------------------------------------------------------------------------------------
+# frame builders
+#-------------------------------------------------------------------------------------------------------------------------
+def header(fc, addr1, addr2=None, addr3=None, seq=0, duration=0, flags=0, addr4=None):
+    out = struct.pack("<BBH", fc, flags, duration) + addr1
+    if addr2 is not None:
+        out += addr2
+    if addr3 is not None:
+        out += addr3 + struct.pack("<H", seq << 4)
+    if addr4 is not None:
+        out += addr4
+    return out
+
+
+def ie(eid, body):
+    return bytes([eid, len(body)]) + body
+
+
+RATES = ie(1, bytes([0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24]))
+EXT_RATES = ie(50, bytes([0x30, 0x48, 0x60, 0x6c]))
+HT_CAP = ie(45, bytes.fromhex("ad0117ffff000000000000000000000000000000000000000000"))
+HE_CAP = ie(255, bytes([35]) + bytes.fromhex("01000802000000000000fafffaff"))
+RSN_PSK = ie(48, bytes.fromhex("0100000fac040100000fac040100000fac020000"))
+OPEN = 0x0421               # ESS, short preamble, short slot time
+PRIVACY = 0x0431
+RSN_SAE = ie(48, bytes.fromhex("0100000fac040100000fac040100000fac08c000"))
+
+
+def beacon(bssid, ssid, channel, seq, t_us, elements, capability, subtype=0x80, dest=BROADCAST):
+    body = struct.pack("<QHH", t_us, 100, capability) + ie(0, ssid) + RATES + ie(3, bytes([channel]))
+    return header(subtype, dest, bssid, bssid, seq) + body + EXT_RATES + elements
+
+
+def probe_request(sta, ssid, seq):
+    return header(0x40, BROADCAST, sta, BROADCAST, seq) + ie(0, ssid) + RATES + EXT_RATES + HT_CAP
+
+
+def deauth(dest, source, bssid, seq, reason=7):
+    return header(0xc0, dest, source, bssid, seq, duration=314) + struct.pack("<H", reason)
+
+
+def qos_data(to_ap, sta, bssid, seq, body, protected=True):
+    flags = (0x01 if to_ap else 0x02) | (0x40 if protected else 0)
+    addr1, addr2 = (bssid, sta) if to_ap else (sta, bssid)
+    return header(0x88, addr1, addr2, bssid, seq, duration=44, flags=flags) + struct.pack("<H", 0) + body
+
+
+def null_data(sta, bssid, seq, power_save):
+    return header(0x48, bssid, sta, bssid, seq, duration=44, flags=0x01 | (0x10 if power_save else 0))
+
+
+def ack(dest):
+    return header(0xd4, dest)
+
+
+def rts(dest, source):
+    return header(0xb4, dest, source, duration=200)
+
+
+def cts(dest):
+    return header(0xc4, dest, duration=150)
+
+
+#-------------------------------------------------------------------------------------------------------------------------
+# a WPA2-PSK 4-way handshake whose MIC and PMKID check out against the passphrase
+#-------------------------------------------------------------------------------------------------------------------------
+def handshake(rng, ap, sta, ssid, passphrase):
+    pmk = hashlib.pbkdf2_hmac("sha1", passphrase, ssid, 4096, 32)
+    anonce = bytes(rng.getrandbits(8) for _ in range(32))
+    snonce = bytes(rng.getrandbits(8) for _ in range(32))
+    salt = min(ap, sta) + max(ap, sta) + min(anonce, snonce) + max(anonce, snonce)
+    ptk = b""
+    i = 0
+    while len(ptk) < 16:
+        ptk += hmac.new(pmk, b"Pairwise key expansion\0" + salt + bytes([i]), hashlib.sha1).digest()
+        i += 1
+    kck = ptk[:16]
+    pmkid = hmac.new(pmk, b"PMK Name" + ap + sta, hashlib.sha1).digest()[:16]
+
+    def key(info, replay, nonce, data, mic_key=None):
+        body = struct.pack(">BHHQ", 2, info, 16, replay) + nonce + bytes(16 + 8 + 8 + 16)
+        body += struct.pack(">H", len(data)) + data
+        eapol = struct.pack(">BBH", 2, 3, len(body)) + body
+        if mic_key is not None:
+            mic = hmac.new(mic_key, eapol, hashlib.sha1).digest()[:16]
+            eapol = eapol[:81] + mic + eapol[97:]
+        return eapol
+
+    def data(from_ap, eapol, seq):
+        addr1, addr2 = (sta, ap) if from_ap else (ap, sta)
+        llc = bytes.fromhex("aaaa03000000888e")
+        return header(0x08, addr1, addr2, ap, seq, duration=44, flags=0x02 if from_ap else 0x01) + llc + eapol
+
+    m1 = key(0x008a, 1, anonce, bytes.fromhex("dd14000fac04") + pmkid)
+    m2 = key(0x010a, 1, snonce, RSN_PSK, kck)
+    m3 = key(0x13ca, 2, anonce, bytes(24), kck)
+    m4 = key(0x030a, 2, bytes(32), b"", kck)
+    return [data(True, m1, 10), data(False, m2, 20), data(True, m3, 11), data(False, m4, 21)]
+
+
+def reference(rng):
+    cap = Capture()
+    home = mac("02:11:22:33:44:01")
+    cafe = mac("02:11:22:33:44:06")
+    lab = mac("02:11:22:33:44:0b")
+    hidden = mac("02:11:22:33:44:66")
+    test_ap = mac("02:00:00:aa:00:01")
+    phone = mac("ac:de:48:00:11:22")
+    laptop = mac("3c:22:fb:12:34:56")
+    test_sta = mac("02:00:00:bb:00:02")
+    spoofed = mac("de:ad:be:ef:00:01")
+
+    networks = [
+        (home, b"homenet", 1, RSN_PSK + HT_CAP, -48, PRIVACY),
+        (cafe, b"cafe-guest", 6, HT_CAP, -67, OPEN),
+        (hidden, b"", 6, RSN_PSK + HT_CAP, -72, PRIVACY),
+        (lab, b"lab-sae", 11, RSN_SAE + HT_CAP + HE_CAP, -58, PRIVACY),
+        (test_ap, b"testnet", 6, RSN_PSK, -55, PRIVACY),
+    ]
+    for n, (bssid, ssid, channel, elements, rssi, capability) in enumerate(networks):
+        for i in range(30):
+            t = 102400 * i + 7000 * n
+            cap.add(t, channel, rssi + rng.randint(-3, 3), beacon(bssid, ssid, channel, 100 + i, t, elements, capability))
+
+    # probes from the phone on every channel, answered by the access point on each
+    for i, channel in enumerate((1, 6, 11)):
+        t = 400000 + 250000 * i
+        cap.add(t, channel, -61, probe_request(phone, b"", 200 + i))
+        cap.add(t + 900, channel, -61, probe_request(phone, b"homenet", 203 + i))
+        bssid, ssid, _, elements, rssi, capability = [n for n in networks if n[2] == channel][0]
+        probe_response = beacon(bssid, ssid, channel, 300 + i, t, elements, capability, subtype=0x50, dest=phone)
+        cap.add(t + 1500, channel, rssi, probe_response, rate=11)
+        cap.add(t + 1600, channel, -61, ack(bssid))
+
+    # the laptop on homenet: RTS/CTS protected QoS data both ways, ACKs, power save nulls
+    for i in range(40):
+        t = 1000000 + 12000 * i
+        cap.add(t, 1, -52, rts(home, laptop), rate=11)
+        cap.add(t + 60, 1, -48, cts(laptop), rate=11)
+        size = rng.choice((60, 120, 600, 1400))
+        body = bytes(rng.getrandbits(8) for _ in range(size))
+        cap.add(t + 120, 1, -52, qos_data(True, laptop, home, 400 + i, body), rate=8)
+        cap.add(t + 800, 1, -48, ack(laptop), rate=11)
+        cap.add(t + 900, 1, -48, qos_data(False, laptop, home, 500 + i, body[:size // 2]), rate=8)
+        cap.add(t + 1500, 1, -52, ack(home), rate=11)
+    cap.add(1500000, 1, -52, null_data(laptop, home, 600, True))
+    cap.add(1600000, 1, -52, null_data(laptop, home, 601, False))
+
+    # deauth flood against homenet from a spoofed transmitter, 40 frames in a second
+    for i in range(40):
+        cap.add(2000000 + 25000 * i, 1, -40, deauth(BROADCAST, spoofed, home, 700 + i))
+
+    # the 4-way handshake on testnet, with the start of it sent twice as a client does on a retry
+    frames = handshake(rng, test_ap, test_sta, b"testnet", b"password123")
+    for i, frame in enumerate(frames + frames[:2]):
+        cap.add(2200000 + 3000 * i, 6, -55 if i % 2 == 0 else -63, frame, rate=11)
+
+    # cut short by the capture: a snaplen of 64 on a large data frame and on a beacon
+    body = bytes(rng.getrandbits(8) for _ in range(1200))
+    cap.add(2900000, 1, -52, qos_data(True, laptop, home, 800, body), rate=8, snap=64)
+    cap.add(2900500, 11, -58, beacon(lab, b"lab-sae", 11, 801, 2900500, RSN_SAE + HT_CAP + HE_CAP, PRIVACY), snap=40)
+    return cap
+
+
+#-------------------------------------------------------------------------------------------------------------------------
+# captures waiting for their ESSID: five PMKIDs fill the four entry queue and push out the first, beacons for the
+# other four arrive, then the first network sends message 1 again and its beacon follows
+#-------------------------------------------------------------------------------------------------------------------------
+def eapol(rng):
+    cap = Capture()
+    sta = mac("02:00:00:bb:00:02")
+    networks = [(mac("02:00:00:aa:00:%02x" % (i + 1)), b"late-%d" % (i + 1)) for i in range(5)]
+    first = None
+    for i, (ap, ssid) in enumerate(networks):
+        m1 = handshake(rng, ap, sta, ssid, b"password123")[0]
+        first = first or m1
+        cap.add(100000 * i, 6, -60, m1, rate=11)
+    for i, (ap, ssid) in enumerate(networks[1:]):
+        cap.add(600000 + 100000 * i, 6, -60, beacon(ap, ssid, 6, 1, 0, RSN_PSK, PRIVACY))
+    ap, ssid = networks[0]
+    cap.add(1100000, 6, -60, first, rate=11)
+    cap.add(1200000, 6, -60, beacon(ap, ssid, 6, 1, 0, RSN_PSK, PRIVACY))
+    return cap
+
+
+#-------------------------------------------------------------------------------------------------------------------------
+# decoder corner cases, test_decode.c refers to them by index
+#-------------------------------------------------------------------------------------------------------------------------
+def decode(rng):
+    cap = Capture()
+    ap = mac("02:11:22:33:44:01")
+    sta = mac("3c:22:fb:12:34:56")
+    wds = mac("02:11:22:33:44:99")
+    wpa_psk = ie(221, bytes.fromhex("0050f20101000050f20201000050f20201000050f202"))
+    rsn_owe = ie(48, bytes.fromhex("0100000fac040100000fac040100000fac120000"))
+    body = bytes(rng.getrandbits(8) for _ in range(48))
+
+    def fixed(capability):
+        return struct.pack("<QHH", 0x1122334455667788, 100, capability)
+
+    frames = [
+        # 0: beacon with every element the parser reads
+        beacon(ap, b"homenet", 3, 1, 0, RSN_PSK + wpa_psk + HT_CAP + HE_CAP, PRIVACY),
+        # 1: qos data with an HT control field
+        header(0x88, ap, sta, ap, 2, flags=0x01 | 0x80) + struct.pack("<HI", 0x0005, 0x0c000001) + body,
+        # 2: four address qos data between two access points
+        header(0x88, wds, ap, wds, 3, flags=0x03, addr4=sta) + struct.pack("<H", 0x0006) + body,
+        # 3: order bit on non-qos data, no HT control field
+        header(0x08, ap, sta, ap, 4, flags=0x01 | 0x80) + body,
+        # 4: action frame with an HT control field
+        header(0xd0, sta, ap, ap, 5, flags=0x80) + struct.pack("<I", 0xdeadbeef) + bytes([3, 0, 1]),
+        # 5: ack, short control header
+        ack(sta),
+        # 6: rts carries the transmitter
+        rts(ap, sta),
+        # 7: runt, one byte short of the shortest header
+        bytes([0xd4, 0x00, 0, 0]) + sta[:5],
+        # 8: extension frame type
+        bytes([0x0c, 0x00, 0, 0]) + sta + bytes(8),
+        # 9: probe request with the wildcard SSID
+        probe_request(sta, b"", 6),
+        # 10: last element claims more bytes than the frame has
+        header(0x80, BROADCAST, ap, ap, 7) + fixed(PRIVACY) + ie(0, b"overrun") + ie(3, bytes([11]))
+        + bytes([48, 40]) + RSN_PSK[2:12],
+        # 11: SSID element longer than 32 bytes, the elements after it still count
+        header(0x80, BROADCAST, ap, ap, 8) + fixed(OPEN) + ie(0, b"x" * 33) + ie(3, bytes([6])),
+        # 12: beacon body shorter than its fixed fields
+        header(0x80, BROADCAST, ap, ap, 9) + fixed(OPEN)[:8],
+        # 13: RSN element with a pairwise cipher count that runs past the element
+        header(0x80, BROADCAST, ap, ap, 10) + fixed(PRIVACY) + ie(0, b"badrsn")
+        + ie(48, bytes.fromhex("0100000fac04ffff000fac04")),
+        # 14: RSN element of a single byte
+        header(0x80, BROADCAST, ap, ap, 11) + fixed(PRIVACY) + ie(0, b"tinyrsn") + ie(48, bytes([1])),
+        # 15: protected management frame, its body can't be read
+        header(0x00, ap, sta, ap, 12, flags=0x40) + bytes(16),
+        # 16: association request for an OWE network
+        header(0x00, ap, sta, ap, 13) + struct.pack("<HH", 0x0411, 10) + ie(0, b"owe") + rsn_owe,
+        # 17: reassociation request, fixed fields name the current access point
+        header(0x20, ap, sta, ap, 14) + struct.pack("<HH", 0x0411, 10) + wds + ie(0, b"homenet") + RSN_SAE,
+        # 18: empty record
+        b"",
+    ]
+    for i, frame in enumerate(frames):
+        cap.add(1000 * i, 1, -50, frame, fcs=len(frame) >= 10)
+
+    # 19: four address qos header cut short by the capture
+    cap.add(19000, 1, -50, frames[2], snap=28)
+    # 20: beacon cut short inside its SSID element
+    cap.add(20000, 1, -50, frames[0], snap=40)
+    return cap
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    reference(random.Random(17)).write(os.path.join(out_dir, "reference.pcap"))
+    eapol(random.Random(21)).write(os.path.join(out_dir, "eapol.pcap"))
+    decode(random.Random(11)).write(os.path.join(out_dir, "decode.pcap"))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
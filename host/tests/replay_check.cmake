@@ -0,0 +1,37 @@
+# Runs replay once over a capture and compares what it wrote, and what it printed, with the
+# expected files. The timing lines are left out of the comparison.
+#   cmake -DREPLAY=<replay> -DPCAP=<capture> -DEXPECTED=<dir/name> -DWORK=<dir/name> \
+#         [-DARGS="--format;text"] -P replay_check.cmake
+# With REPLAY_UPDATE=1 in the environment the expected files are rewritten instead.
+foreach(var REPLAY PCAP EXPECTED WORK)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "replay_check: ${var} not set")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND ${REPLAY} --repeat 1 ${ARGS} --out ${WORK}.out ${PCAP}
+    OUTPUT_VARIABLE log
+    ERROR_VARIABLE log
+    RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "replay exited with ${rc}:\n${log}")
+endif()
+string(REGEX REPLACE "(Pass [0-9]+|Mean):[^\n]*\n" "" log "${log}")
+file(WRITE ${WORK}.log "${log}")
+
+if("$ENV{REPLAY_UPDATE}" STREQUAL "1")
+    configure_file(${WORK}.out ${EXPECTED}.out COPYONLY)
+    configure_file(${WORK}.log ${EXPECTED}.log COPYONLY)
+    message(STATUS "updated ${EXPECTED}.out and ${EXPECTED}.log")
+    return()
+endif()
+
+foreach(ext out log)
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}.${ext} ${EXPECTED}.${ext}
+        RESULT_VARIABLE differ)
+    if(differ)
+        message(FATAL_ERROR "${WORK}.${ext} differs from ${EXPECTED}.${ext}")
+    endif()
+endforeach()
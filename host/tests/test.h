@@ -0,0 +1,92 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "pcap_load.h"
+
+//-------------------------------------------------------------------------------------------------------------------------
+// tiny helpers shared by the host tests: a CHECK that counts failures instead of stopping, and a loader that keeps
+// every frame of a pcap in an array so a test can look at frames by index
+//-------------------------------------------------------------------------------------------------------------------------
+
+static int test_failures = 0;
+
+#define CHECK(cond, ...)                                                    \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__);                                            \
+            printf("\n");                                                   \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+// exit status for main, prints a summary
+#define TEST_RESULT(name) \
+    (printf("%s: %s\n", (name), test_failures ? "FAILED" : "passed"), test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+typedef struct {
+    pipeline_frame_t *frames;
+    size_t count;
+    size_t capacity;
+} test_frames_t;
+
+/**
+ * Appends a loaded frame, used as the pcap_load callback
+ * @param frame Frame
+ * @param ctx test_frames_t
+ * @return False when out of memory
+ */
+static inline bool test_add_frame(const pipeline_frame_t *frame, void *ctx)
+{
+    test_frames_t *list = ctx;
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        pipeline_frame_t *frames = realloc(list->frames, capacity * sizeof(*frames));
+        if (frames == NULL) {
+            return false;
+        }
+        list->frames = frames;
+        list->capacity = capacity;
+    }
+    list->frames[list->count++] = *frame;
+    return true;
+}
+
+/**
+ * Loads every frame of a capture, exits if it can't be read
+ * @param path pcap file
+ * @param max_len Bytes kept per frame
+ * @param list Where to store the frames
+ */
+static inline void test_load(const char *path, uint16_t max_len, test_frames_t *list)
+{
+    if (pcap_load(path, max_len, &test_add_frame, list) < 0) {
+        printf("Can't load %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,271 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+
+//-------------------------------------------------------------------------------------------------------------------------
+// filter expression tests: compile errors and limits, then match counts over the reference capture. the counts follow
+// from how make_corpus.py builds reference.pcap, see the comments next to them.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_bpf.h"
+#include "cmd_wifi_pipeline.h"
+#include "test.h"
+
+typedef struct {
+    const char *expr;
+    const char *err;    /* NULL if the expression compiles */
+} compile_case_t;
+
+static const compile_case_t compile_cases[] = {
+    { "", NULL },
+    { "   ", NULL },
+    { "type mgmt and subtype beacon and rssi > -70 and addr2 == aa:bb:cc:dd:ee:ff", NULL },
+    { "!(type ctrl) && (channel >= 1 || len < 100)", NULL },
+    { "type = 2 and subtype != 8", NULL },
+    { "addr aa:bb:cc:dd:ee:ff", NULL },
+    { "((((((( retry )))))))", NULL },
+    { "(((((((( retry ))))))))", "filter nested too deeply near 'retry'" },
+    { "not not not not not not not tods", NULL },
+    { "not not not not not not not not tods", "filter nested too deeply near 'tods'" },
+    { "ssid == homenet", "unknown field near 'ssid'" },
+    { "rssi", "expected comparison near 'end of filter'" },
+    { "rssi > strong", "expected number near 'strong'" },
+    { "type beacon", "expected frame type near 'beacon'" },
+    { "subtype mgmt", "expected frame subtype near 'mgmt'" },
+    { "addr2 > aa:bb:cc:dd:ee:ff", "addresses only support == and != near 'aa:bb:cc:dd:ee:ff'" },
+    { "addr1 == aa:bb:cc", "expected mac address near 'aa:bb:cc'" },
+    { "(tods or fromds", "expected ')' near 'end of filter'" },
+    { "tods fromds", "unexpected token near 'fromds'" },
+    { "tods )", "unexpected token near ')'" },
+    { "tods and", "unknown field near 'end of filter'" },
+    { "$", "unknown field near '$'" },
+};
+
+/**
+ * Checks the messages and programs the compiler produces
+ */
+static void test_compile(void)
+{
+    for (size_t i = 0; i < sizeof(compile_cases) / sizeof(compile_cases[0]); i++) {
+        const compile_case_t *c = &compile_cases[i];
+        bpf_program_t prog;
+        char err[96] = "";
+
+        bool ok = bpf_compile(c->expr, &prog, err, sizeof(err));
+        if (c->err == NULL) {
+            CHECK(ok, "\"%s\": %s", c->expr, err);
+        } else {
+            CHECK(!ok, "\"%s\" compiled", c->expr);
+            CHECK(strcmp(err, c->err) == 0, "\"%s\": got \"%s\", want \"%s\"", c->expr, err, c->err);
+            CHECK(prog.len == 0, "\"%s\" left %u instructions behind", c->expr, prog.len);
+        }
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // 16 tests and 15 ands fill the program, one more test doesn't fit
+    //-------------------------------------------------------------------------------------------------------------------------
+    char expr[512] = "retry";
+    for (int i = 1; i < 16; i++) {
+        strcat(expr, " and retry");
+    }
+    bpf_program_t prog;
+    char err[96] = "";
+    CHECK(bpf_compile(expr, &prog, err, sizeof(err)), "16 tests: %s", err);
+    CHECK(prog.len == 31, "16 tests gave %u instructions", prog.len);
+
+    strcat(expr, " and retry");
+    CHECK(!bpf_compile(expr, &prog, err, sizeof(err)), "17 tests compiled");
+    CHECK(strcmp(err, "filter too long near 'end of filter'") == 0, "17 tests: %s", err);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // a short error buffer still gets a terminated message
+    //-------------------------------------------------------------------------------------------------------------------------
+    char small[8];
+    memset(small, 'x', sizeof(small));
+    CHECK(!bpf_compile("bogus", &prog, small, sizeof(small)), "bogus compiled");
+    CHECK(strcmp(small, "unknown") == 0, "short buffer: %.8s", small);
+}
+
+typedef struct {
+    const char *expr;
+    size_t matches;
+} run_case_t;
+
+// reference.pcap has 452 frames: 150 beacons and 6 probe requests, 3 probe responses with their acks, 40 rounds of
+// rts, cts, qos data and ack each way between the laptop and homenet, 2 nulls, 40 deauths, 6 handshake frames and
+// 2 frames cut short by the capture (a qos data frame and a beacon)
+static const run_case_t run_cases[] = {
+    { "", 452 },
+    { "type mgmt", 200 },
+    { "type ctrl", 163 },
+    { "type data", 89 },
+    { "type mgmt or type ctrl or type data", 452 },
+    { "subtype beacon", 151 },
+    { "subtype probereq or subtype proberesp", 9 },
+    { "subtype deauth and addr2 == de:ad:be:ef:00:01 and addr1 == ff:ff:ff:ff:ff:ff", 40 },
+    { "channel == 6", 100 },
+    { "channel != 1 and channel != 6", 35 },
+    { "rssi >= -40", 40 },
+    { "protected", 81 },
+    { "tods and not protected", 5 },                /* 2 nulls, handshake messages 2, 4 and 2 again */
+    { "fromds", 43 },                               /* 40 qos data, handshake messages 1, 3 and 1 again */
+    { "subtype qosdata and tods", 41 },
+    { "subtype null", 2 },
+    { "subtype ack or subtype cts", 123 },
+    { "len < 20", 123 },                            /* acks and ctss are 14 bytes plus the FCS */
+    { "addr1 == 3c:22:fb:12:34:56", 120 },          /* ctss, acks and qos data to the laptop */
+    { "addr 02:00:00:aa:00:01", 36 },               /* testnet beacons and the handshake */
+    { "addr != 02:11:22:33:44:01 and type mgmt", 129 },  /* not homenet beacons, its probe response or the deauths */
+    { "(channel == 1 or channel == 11) and not (type ctrl or subtype beacon)", 129 },
+};
+
+/**
+ * Runs programs over every frame of the reference capture and counts the matches
+ * @param list Frames
+ */
+static void test_run(const test_frames_t *list)
+{
+    CHECK(list->count == 452, "loaded %zu frames", list->count);
+
+    for (size_t i = 0; i < sizeof(run_cases) / sizeof(run_cases[0]); i++) {
+        const run_case_t *c = &run_cases[i];
+        bpf_program_t prog;
+        char err[96] = "";
+        if (!bpf_compile(c->expr, &prog, err, sizeof(err))) {
+            CHECK(false, "\"%s\": %s", c->expr, err);
+            continue;
+        }
+
+        //-------------------------------------------------------------------------------------------------------------------------
+        // same metadata pipeline_filter hands over
+        //-------------------------------------------------------------------------------------------------------------------------
+        size_t matches = 0;
+        for (size_t f = 0; f < list->count; f++) {
+            const pipeline_frame_t *frame = &list->frames[f];
+            const bpf_meta_t meta = {
+                .rssi = frame->rssi,
+                .channel = frame->channel,
+                .rate = frame->rate,
+                .len = frame->orig_len
+            };
+            matches += bpf_run(&prog, frame->payload, frame->len, &meta);
+        }
+        CHECK(matches == c->matches, "\"%s\": %zu matches, want %zu", c->expr, matches, c->matches);
+    }
+}
+
+/**
+ * Checks that tests on fields a short frame doesn't carry are false
+ * @param list Frames, the first one is a homenet beacon
+ */
+static void test_short_frame(const test_frames_t *list)
+{
+    const pipeline_frame_t *beacon = &list->frames[0];
+    const bpf_meta_t meta = { .rssi = beacon->rssi, .channel = beacon->channel, .len = beacon->orig_len };
+    bpf_program_t prog;
+    char err[96];
+
+    CHECK(bpf_compile("addr2 == 02:11:22:33:44:01", &prog, err, sizeof(err)), "%s", err);
+    CHECK(bpf_run(&prog, beacon->payload, beacon->len, &meta), "whole beacon");
+    CHECK(!bpf_run(&prog, beacon->payload, 15, &meta), "addr2 cut short");
+
+    CHECK(bpf_compile("addr1 == ff:ff:ff:ff:ff:ff", &prog, err, sizeof(err)), "%s", err);
+    CHECK(bpf_run(&prog, beacon->payload, 10, &meta), "addr1 just fits");
+    CHECK(!bpf_run(&prog, beacon->payload, 9, &meta), "addr1 cut short");
+
+    CHECK(bpf_compile("not subtype beacon", &prog, err, sizeof(err)), "%s", err);
+    CHECK(!bpf_run(&prog, beacon->payload, 2, &meta), "frame control is enough");
+    CHECK(bpf_run(&prog, beacon->payload, 1, &meta), "no frame control, the test is false and not inverts it");
+
+    CHECK(bpf_compile("channel == 1", &prog, err, sizeof(err)), "%s", err);
+    CHECK(bpf_run(&prog, beacon->payload, 0, &meta), "metadata doesn't need the frame");
+}
+
+/**
+ * Checks that address tests follow the layout of control frames rather than fixed offsets
+ */
+static void test_ctrl_addrs(void)
+{
+    // block ack from 02:00:00:aa:00:01 to 02:00:00:bb:00:02, the ba control, ssn and bitmap sit where addr3 would be
+    static const uint8_t block_ack[32] = {
+        0x94, 0x00, 0x00, 0x00,
+        0x02, 0x00, 0x00, 0xbb, 0x00, 0x02,
+        0x02, 0x00, 0x00, 0xaa, 0x00, 0x01,
+        0x05, 0x00, 0x10, 0x00, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+    // cts to 02:00:00:bb:00:02 with trailing bytes where addr2 would be
+    static const uint8_t cts[20] = {
+        0xc4, 0x00, 0x00, 0x00,
+        0x02, 0x00, 0x00, 0xbb, 0x00, 0x02,
+        0x05, 0x00, 0x10, 0x00, 0xff, 0xff,
+        0x00, 0x00, 0x00, 0x00
+    };
+    const bpf_meta_t meta = { .channel = 6, .len = sizeof(block_ack) };
+    bpf_program_t prog;
+    char err[96];
+
+    CHECK(bpf_compile("addr2 == 02:00:00:aa:00:01", &prog, err, sizeof(err)), "%s", err);
+    CHECK(bpf_run(&prog, block_ack, sizeof(block_ack), &meta), "block ack carries the transmitter");
+
+    CHECK(bpf_compile("addr3 == 05:00:10:00:ff:ff", &prog, err, sizeof(err)), "%s", err);
+    CHECK(!bpf_run(&prog, block_ack, sizeof(block_ack), &meta), "block ack has no addr3");
+    CHECK(bpf_compile("addr3 != 02:00:00:aa:00:01", &prog, err, sizeof(err)), "%s", err);
+    CHECK(!bpf_run(&prog, block_ack, sizeof(block_ack), &meta), "addr3 != on a block ack");
+    CHECK(bpf_compile("addr 05:00:10:00:ff:ff", &prog, err, sizeof(err)), "%s", err);
+    CHECK(!bpf_run(&prog, block_ack, sizeof(block_ack), &meta), "any address skips the missing addr3");
+
+    CHECK(bpf_compile("addr2 == 05:00:10:00:ff:ff", &prog, err, sizeof(err)), "%s", err);
+    CHECK(!bpf_run(&prog, cts, sizeof(cts), &meta), "cts has no addr2");
+    CHECK(bpf_compile("addr1 == 02:00:00:bb:00:02", &prog, err, sizeof(err)), "%s", err);
+    CHECK(bpf_run(&prog, cts, sizeof(cts), &meta), "cts carries the receiver");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        printf("Usage: %s reference.pcap\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // static like the frame table in replay, the frames point into the loaded file until exit
+    static test_frames_t list;
+    test_load(argv[1], UINT16_MAX, &list);
+
+    test_compile();
+    test_run(&list);
+    test_short_frame(&list);
+    test_ctrl_addrs();
+
+    return TEST_RESULT("bpf");
+}
@@ -0,0 +1,221 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+
+//-------------------------------------------------------------------------------------------------------------------------
+// decoder tests over decode.pcap, one frame per header layout or element list corner case. frame indexes match the
+// list in make_corpus.py.
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_decode.h"
+#include "cmd_wifi_pipeline.h"
+#include "test.h"
+
+#define DECODE_FRAMES 21
+
+static const uint8_t ap[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x01 };
+static const uint8_t sta[6] = { 0x3c, 0x22, 0xfb, 0x12, 0x34, 0x56 };
+static const uint8_t wds[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x99 };
+
+static test_frames_t list;
+
+/**
+ * Decodes a frame of the corpus the way the pipeline does
+ * @param index Frame index
+ * @param wf Where to store the decoded frame
+ * @return Result of wifi_decode
+ */
+static bool decode(size_t index, wifi_frame_t *wf)
+{
+    const pipeline_frame_t *frame = &list.frames[index];
+    return wifi_decode(frame->payload, frame->len, frame->len == frame->orig_len, wf);
+}
+
+/**
+ * Decodes a management frame and parses its elements
+ * @param index Frame index
+ * @param info Where to store the summary
+ * @return Result of wifi_parse_mgmt, false if the header didn't decode
+ */
+static bool parse(size_t index, wifi_mgmt_info_t *info)
+{
+    wifi_frame_t wf;
+    memset(info, 0, sizeof(*info));
+    if (!decode(index, &wf)) {
+        CHECK(false, "frame %zu doesn't decode", index);
+        return false;
+    }
+    return wifi_parse_mgmt(&wf, info);
+}
+
+/**
+ * Checks an SSID from the summary
+ * @param info Summary
+ * @param ssid Expected SSID, NULL if none should be found
+ * @return Whether it matched
+ */
+static bool ssid_is(const wifi_mgmt_info_t *info, const char *ssid)
+{
+    if (ssid == NULL) {
+        return info->ssid == NULL;
+    }
+    return info->ssid != NULL && info->ssid_len == strlen(ssid) && memcmp(info->ssid, ssid, info->ssid_len) == 0;
+}
+
+/**
+ * Header layouts: qos, HT control, four addresses, short control headers
+ */
+static void test_headers(void)
+{
+    wifi_frame_t wf;
+
+    CHECK(decode(0, &wf), "beacon");
+    CHECK(wf.type == WIFI_TYPE_MGMT && wf.subtype == WIFI_MGMT_BEACON, "beacon type %u/%u", wf.type, wf.subtype);
+    CHECK(wf.hdr_len == 24 && wf.has_seq && wf.seq == 1 && !wf.has_qos && !wf.has_htc, "beacon header");
+    CHECK(wf.addr2 != NULL && memcmp(wf.addr2, ap, 6) == 0 && wf.addr4 == NULL, "beacon addresses");
+    CHECK(wf.body_len == list.frames[0].len - 24 - WIFI_FCS_LEN, "beacon body %u, the FCS isn't body", wf.body_len);
+
+    CHECK(decode(1, &wf), "qos data with HT control");
+    CHECK(wf.has_qos && wf.qos == 0x0005 && wf.to_ds && !wf.from_ds, "qos %04x", wf.qos);
+    CHECK(wf.order && wf.has_htc && wf.htc == 0x0c000001, "htc %08x", (unsigned)wf.htc);
+    CHECK(wf.hdr_len == 30 && wf.body_len == 48, "hdr %u body %u", wf.hdr_len, wf.body_len);
+
+    CHECK(decode(2, &wf), "four address qos data");
+    CHECK(wf.to_ds && wf.from_ds && wf.addr4 != NULL && memcmp(wf.addr4, sta, 6) == 0, "addr4");
+    CHECK(memcmp(wf.addr1, wds, 6) == 0 && memcmp(wf.addr2, ap, 6) == 0, "addr1, addr2");
+    CHECK(wf.has_qos && wf.qos == 0x0006 && !wf.has_htc, "qos %04x", wf.qos);
+    CHECK(wf.hdr_len == 32 && wf.body_len == 48, "hdr %u body %u", wf.hdr_len, wf.body_len);
+
+    CHECK(decode(3, &wf), "data with the order bit");
+    CHECK(wf.order && !wf.has_htc && wf.hdr_len == 24 && wf.body_len == 48, "hdr %u", wf.hdr_len);
+
+    CHECK(decode(4, &wf), "action with HT control");
+    CHECK(wf.subtype == WIFI_MGMT_ACTION && wf.has_htc && wf.htc == 0xdeadbeef, "htc %08x", (unsigned)wf.htc);
+    CHECK(wf.hdr_len == 28 && wf.body_len == 3 && wf.body[0] == 3, "hdr %u body %u", wf.hdr_len, wf.body_len);
+
+    CHECK(decode(5, &wf), "ack");
+    CHECK(wf.type == WIFI_TYPE_CTRL && wf.hdr_len == 10 && wf.body_len == 0, "ack hdr %u", wf.hdr_len);
+    CHECK(memcmp(wf.addr1, sta, 6) == 0 && wf.addr2 == NULL && wf.addr3 == NULL && !wf.has_seq, "ack addresses");
+
+    CHECK(decode(6, &wf), "rts");
+    CHECK(wf.hdr_len == 16 && wf.addr2 != NULL && memcmp(wf.addr2, sta, 6) == 0 && wf.addr3 == NULL, "rts");
+    CHECK(wf.duration == 200, "rts duration %u", wf.duration);
+
+    CHECK(!decode(7, &wf), "runt decoded");
+    CHECK(!decode(8, &wf), "extension frame decoded");
+    CHECK(!decode(18, &wf), "empty record decoded");
+    CHECK(!decode(19, &wf), "four address header cut short decoded");
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // without its FCS a frame cut short keeps every captured byte as body
+    //-------------------------------------------------------------------------------------------------------------------------
+    CHECK(decode(20, &wf), "beacon cut short");
+    CHECK(wf.body_len == 16, "cut beacon body %u", wf.body_len);
+}
+
+/**
+ * Element parsing: security, capabilities and malformed element lists
+ */
+static void test_elements(void)
+{
+    wifi_mgmt_info_t info;
+    char sec[48];
+
+    CHECK(parse(0, &info), "beacon");
+    CHECK(ssid_is(&info, "homenet"), "beacon SSID");
+    CHECK(info.channel == 3 && info.beacon_interval == 100 && info.capability == 0x0431, "channel %u", info.channel);
+    CHECK(info.security == (WIFI_SEC_WPA | WIFI_SEC_WPA2 | WIFI_SEC_PSK), "security %02x", info.security);
+    CHECK(info.rsn != NULL && info.rsn_len == 20, "rsn %u", info.rsn_len);
+    CHECK(info.ht_cap != NULL && info.ht_cap_len == 26, "ht %u", info.ht_cap_len);
+    CHECK(info.he_cap != NULL && info.he_cap_len == 14 && info.he_cap[0] == 0x01, "he %u", info.he_cap_len);
+    wifi_security_str(info.security, sec, sizeof(sec));
+    CHECK(strcmp(sec, "WPA/WPA2/PSK") == 0, "security string %s", sec);
+
+    CHECK(parse(9, &info), "probe request");
+    CHECK(info.ssid != NULL && info.ssid_len == 0, "wildcard SSID");
+    CHECK(info.ht_cap_len == 26 && info.security == WIFI_SEC_OPEN, "probe request security %02x", info.security);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the overrunning RSN element is dropped, so the privacy bit makes it WEP
+    //-------------------------------------------------------------------------------------------------------------------------
+    CHECK(parse(10, &info), "element overrun");
+    CHECK(ssid_is(&info, "overrun") && info.channel == 11, "elements before the overrun");
+    CHECK(info.rsn == NULL && info.security == WIFI_SEC_WEP, "overrun security %02x", info.security);
+
+    CHECK(parse(11, &info), "long SSID");
+    CHECK(ssid_is(&info, NULL) && info.channel == 6 && info.security == WIFI_SEC_OPEN, "long SSID skipped");
+
+    CHECK(!parse(12, &info), "short fixed fields parsed");
+
+    CHECK(parse(13, &info), "pairwise count overrun");
+    CHECK(ssid_is(&info, "badrsn") && info.security == WIFI_SEC_WPA2, "security %02x", info.security);
+
+    CHECK(parse(14, &info), "one byte RSN");
+    CHECK(ssid_is(&info, "tinyrsn") && info.rsn_len == 1 && info.security == WIFI_SEC_WPA2, "security %02x",
+          info.security);
+
+    CHECK(!parse(15, &info), "protected management frame parsed");
+
+    CHECK(parse(16, &info), "association request");
+    CHECK(ssid_is(&info, "owe") && info.security == (WIFI_SEC_WPA2 | WIFI_SEC_OWE), "security %02x", info.security);
+    CHECK(info.beacon_interval == 0 && info.capability == 0, "no beacon fields in an association request");
+
+    CHECK(parse(17, &info), "reassociation request");
+    CHECK(ssid_is(&info, "homenet") && info.security == (WIFI_SEC_WPA2 | WIFI_SEC_SAE), "security %02x",
+          info.security);
+
+    CHECK(parse(20, &info), "beacon cut short");
+    CHECK(ssid_is(&info, NULL) && info.channel == 0, "no SSID from a cut element");
+
+    wifi_frame_t wf;
+    CHECK(decode(1, &wf) && !wifi_parse_mgmt(&wf, &info), "data frame parsed as management");
+    CHECK(decode(4, &wf) && !wifi_parse_mgmt(&wf, &info), "action frame has no elements");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        printf("Usage: %s decode.pcap\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    test_load(argv[1], UINT16_MAX, &list);
+    if (list.count != DECODE_FRAMES) {
+        printf("%s has %zu frames, expected %d\n", argv[1], list.count, DECODE_FRAMES);
+        return EXIT_FAILURE;
+    }
+
+    test_headers();
+    test_elements();
+    return TEST_RESULT("decode");
+}
@@ -0,0 +1,285 @@
+/*
+ * esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+ * Copyright (C) 2024 dj1ch
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE 
+ * SOFTWARE.
+*/
+
+
+//-------------------------------------------------------------------------------------------------------------------------
+// frame pool tests: class selection, spills into larger classes, exhaustion, counters, and a multi threaded run that
+// checks no block is ever handed out twice
+//-------------------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------------------
+// standard c libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+//-------------------------------------------------------------------------------------------------------------------------
+// cli libraries
+//-------------------------------------------------------------------------------------------------------------------------
+#include "cmd_wifi_pool.h"
+#include "test.h"
+
+#define STRESS_THREADS 4
+#define STRESS_ROUNDS 200000
+#define STRESS_HELD 8
+
+static const uint16_t class_blocks[FRAME_POOL_CLASSES] = {
+    FRAME_POOL_SMALL_BLOCKS, FRAME_POOL_MEDIUM_BLOCKS, FRAME_POOL_LARGE_BLOCKS
+};
+
+/**
+ * Reads the pool counters
+ * @param stats Where to store them
+ */
+static void get_stats(frame_pool_stats_t stats[FRAME_POOL_CLASSES])
+{
+    memset(stats, 0, sizeof(frame_pool_stats_t) * FRAME_POOL_CLASSES);
+    frame_pool_get_stats(stats);
+}
+
+/**
+ * Allocations go to the smallest class that fits, oversized requests fail without counting
+ */
+static void test_classes(void)
+{
+    CHECK(frame_pool_alloc(1) == NULL, "allocation before the first reset");
+    frame_pool_reset();
+
+    frame_pool_stats_t stats[FRAME_POOL_CLASSES];
+    get_stats(stats);
+    CHECK(stats[0].size == FRAME_POOL_SMALL_SIZE && stats[1].size == FRAME_POOL_MEDIUM_SIZE &&
+          stats[2].size == FRAME_POOL_LARGE_SIZE, "class sizes");
+
+    const uint16_t lens[] = { 0, 1, FRAME_POOL_SMALL_SIZE, FRAME_POOL_SMALL_SIZE + 1, FRAME_POOL_MEDIUM_SIZE,
+                              FRAME_POOL_MEDIUM_SIZE + 1, FRAME_POOL_LARGE_SIZE };
+    const int want[] = { 0, 0, 0, 1, 1, 2, 2 };
+    void *blocks[sizeof(lens) / sizeof(lens[0])];
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        get_stats(stats);
+        uint32_t before = stats[want[i]].allocs;
+        blocks[i] = frame_pool_alloc(lens[i]);
+        get_stats(stats);
+        CHECK(blocks[i] != NULL && stats[want[i]].allocs == before + 1, "%u bytes should come from class %d",
+              lens[i], want[i]);
+        CHECK(((uintptr_t)blocks[i] & 3) == 0, "%u bytes: block not aligned", lens[i]);
+    }
+
+    CHECK(frame_pool_alloc(FRAME_POOL_LARGE_SIZE + 1) == NULL, "oversized allocation");
+    get_stats(stats);
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        CHECK(stats[c].spills == 0 && stats[c].exhausted == 0, "class %d counted an oversized allocation", c);
+    }
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // free lists are LIFO, the block just freed is the next one handed out
+    //-------------------------------------------------------------------------------------------------------------------------
+    frame_pool_free(blocks[1]);
+    void *again = frame_pool_alloc(10);
+    CHECK(again == blocks[1], "freed block not reused");
+    blocks[1] = again;
+
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        frame_pool_free(blocks[i]);
+    }
+    frame_pool_free(NULL);
+    get_stats(stats);
+    CHECK(stats[0].in_use == 0 && stats[1].in_use == 0 && stats[2].in_use == 0, "blocks still in use");
+    CHECK(stats[0].high_water == 3 && stats[1].high_water == 2 && stats[2].high_water == 2, "high water %u %u %u",
+          stats[0].high_water, stats[1].high_water, stats[2].high_water);
+}
+
+/**
+ * Small requests spill into the medium and large classes once their own class is empty, then the pool runs dry
+ */
+static void test_spills(void)
+{
+    static void *held[FRAME_POOL_BLOCKS];
+    frame_pool_reset();
+
+    for (int i = 0; i < FRAME_POOL_BLOCKS; i++) {
+        held[i] = frame_pool_alloc(64);
+        CHECK(held[i] != NULL, "block %d of %d", i, FRAME_POOL_BLOCKS);
+        for (int j = 0; j < i; j++) {
+            CHECK(held[i] != held[j], "block %d handed out twice", j);
+        }
+    }
+    CHECK(frame_pool_alloc(64) == NULL, "allocation from a full pool");
+    CHECK(frame_pool_alloc(FRAME_POOL_LARGE_SIZE) == NULL, "large allocation from a full pool");
+
+    frame_pool_stats_t stats[FRAME_POOL_CLASSES];
+    get_stats(stats);
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        CHECK(stats[c].in_use == class_blocks[c] && stats[c].high_water == class_blocks[c] &&
+              stats[c].allocs == class_blocks[c], "class %d: %u in use, high water %u", c, stats[c].in_use,
+              stats[c].high_water);
+    }
+    CHECK(stats[0].spills == FRAME_POOL_MEDIUM_BLOCKS + FRAME_POOL_LARGE_BLOCKS, "small spills %u", stats[0].spills);
+    CHECK(stats[0].exhausted == 1 && stats[2].exhausted == 1, "exhausted %u %u", stats[0].exhausted,
+          stats[2].exhausted);
+    CHECK(stats[1].spills == 0 && stats[2].spills == 0 && stats[1].exhausted == 0, "only the wanted class counts");
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // a freed large block serves a small request again
+    //-------------------------------------------------------------------------------------------------------------------------
+    void *large = held[FRAME_POOL_BLOCKS - 1];
+    frame_pool_free(large);
+    CHECK(frame_pool_alloc(1) == large, "small request didn't get the free large block");
+
+    for (int i = 0; i < FRAME_POOL_BLOCKS; i++) {
+        frame_pool_free(held[i]);
+    }
+    get_stats(stats);
+    CHECK(stats[0].in_use == 0 && stats[1].in_use == 0 && stats[2].in_use == 0, "blocks still in use");
+
+    frame_pool_reset();
+    get_stats(stats);
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        CHECK(stats[c].high_water == 0 && stats[c].allocs == 0 && stats[c].spills == 0 && stats[c].exhausted == 0,
+              "class %d counters survived the reset", c);
+    }
+}
+
+typedef struct {
+    unsigned seed;
+    unsigned long corrupted;
+    unsigned long failed;
+} stress_t;
+
+typedef struct {
+    uint8_t *block;
+    uint16_t len;
+    uint32_t stamp;
+} held_t;
+
+/**
+ * Writes a stamp at both ends of a block
+ * @param h Held block
+ */
+static void stamp(const held_t *h)
+{
+    memcpy(h->block, &h->stamp, sizeof(h->stamp));
+    memcpy(h->block + h->len - sizeof(h->stamp), &h->stamp, sizeof(h->stamp));
+}
+
+/**
+ * Checks that nobody else wrote into a block while it was held
+ * @param h Held block
+ * @return Whether both stamps are intact
+ */
+static bool stamped(const held_t *h)
+{
+    return memcmp(h->block, &h->stamp, sizeof(h->stamp)) == 0 &&
+           memcmp(h->block + h->len - sizeof(h->stamp), &h->stamp, sizeof(h->stamp)) == 0;
+}
+
+/**
+ * Allocates and frees random sizes, holding a few blocks at a time like the ring does
+ * @param arg stress_t
+ * @return NULL
+ */
+static void *stress_thread(void *arg)
+{
+    stress_t *st = arg;
+    held_t held[STRESS_HELD] = { 0 };
+
+    for (uint32_t round = 0; round < STRESS_ROUNDS; round++) {
+        held_t *h = &held[rand_r(&st->seed) % STRESS_HELD];
+        if (h->block != NULL) {
+            st->corrupted += !stamped(h);
+            frame_pool_free(h->block);
+            h->block = NULL;
+            continue;
+        }
+
+        h->len = 8 + rand_r(&st->seed) % (FRAME_POOL_LARGE_SIZE - 8 + 1);
+        h->block = frame_pool_alloc(h->len);
+        if (h->block == NULL) {
+            st->failed++;
+            continue;
+        }
+        h->stamp = st->seed ^ round;
+        stamp(h);
+    }
+
+    for (int i = 0; i < STRESS_HELD; i++) {
+        if (held[i].block != NULL) {
+            st->corrupted += !stamped(&held[i]);
+            frame_pool_free(held[i].block);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Several threads share the pool, holding up to 32 of its 64 blocks
+ */
+static void test_stress(void)
+{
+    pthread_t threads[STRESS_THREADS];
+    stress_t state[STRESS_THREADS];
+
+    frame_pool_reset();
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        state[i] = (stress_t){ .seed = 1234u + i };
+        CHECK(pthread_create(&threads[i], NULL, &stress_thread, &state[i]) == 0, "thread %d", i);
+    }
+    for (int i = 0; i < STRESS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        CHECK(state[i].corrupted == 0, "thread %d saw %lu blocks written by someone else", i, state[i].corrupted);
+        CHECK(state[i].failed == 0, "thread %d: %lu allocations failed with blocks to spare", i, state[i].failed);
+    }
+
+    frame_pool_stats_t stats[FRAME_POOL_CLASSES];
+    get_stats(stats);
+    uint32_t allocs = 0;
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        CHECK(stats[c].in_use == 0, "class %d: %u blocks in use after the run", c, stats[c].in_use);
+        CHECK(stats[c].high_water <= class_blocks[c], "class %d: high water %u", c, stats[c].high_water);
+        allocs += stats[c].allocs;
+    }
+    CHECK(allocs > STRESS_THREADS * STRESS_ROUNDS / 4, "only %u allocations", allocs);
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // every block made it back onto a free list exactly once
+    //-------------------------------------------------------------------------------------------------------------------------
+    static void *all[FRAME_POOL_BLOCKS];
+    for (int i = 0; i < FRAME_POOL_BLOCKS; i++) {
+        all[i] = frame_pool_alloc(1);
+        CHECK(all[i] != NULL, "block %d missing after the run", i);
+        for (int j = 0; j < i; j++) {
+            CHECK(all[i] != all[j], "block on a free list twice");
+        }
+    }
+    CHECK(frame_pool_alloc(1) == NULL, "more blocks than the pool has");
+}
+
+int main(void)
+{
+    test_classes();
+    test_spills();
+    test_stress();
+    return TEST_RESULT("pool");
+}
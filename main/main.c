@@ -97,28 +97,39 @@ const char* TAG = "esp32c6";
 #endif
 #endif
 
-#if CONFIG_STORE_HISTORY
 // filesystem
 void fs_init(void);
-#endif // CONFIG_STORE_HISTORY
 
 // nvs
 void nvs_init(void);
 
-#if CONFIG_STORE_HISTORY
+//-------------------------------------------------------------------------------------------------------------------------
+// the console comes up in its own task once capture is running, below the sniffer tasks
+//-------------------------------------------------------------------------------------------------------------------------
+#define CONSOLE_TASK_STACK 4096
+#define CONSOLE_TASK_PRIORITY 1
+
+// set when the autostart profile records to flash or sends framed batches and has to wait for the console task
+static bool autostart_deferred;
 
+//-------------------------------------------------------------------------------------------------------------------------
+// holds console history and recordings made with start --format record
+//-------------------------------------------------------------------------------------------------------------------------
 #define MOUNT_PATH "/data"
+#if CONFIG_STORE_HISTORY
 #define HISTORY_PATH MOUNT_PATH "/history.txt"
+#endif // CONFIG_STORE_HISTORY
 
 /**
- * Initializes NVS (if needed)
+ * Mounts the wear levelled FAT partition
  */
 void fs_init(void)
 {
     static wl_handle_t wl_handle;
     const esp_vfs_fat_mount_config_t mount_config = {
             .max_files = 4,
-            .format_if_mount_failed = true
+            .format_if_mount_failed = true,
+            .allocation_unit_size = CONFIG_WL_SECTOR_SIZE
     };
     esp_err_t err = esp_vfs_fat_spiflash_mount_rw_wl(MOUNT_PATH, "storage", &mount_config, &wl_handle);
     if (err != ESP_OK) {
@@ -126,7 +137,6 @@ void fs_init(void)
         return;
     }
 }
-#endif // CONFIG_STORE_HISTORY
 
 /**
  * Initializes NVS
@@ -141,23 +151,82 @@ void nvs_init(void)
     ESP_ERROR_CHECK(err);
 }
 
+/**
+ * Mounts the FAT partition and brings up the REPL, after capture has started
+ * @param arg Unused
+ */
+static void console_task(void *arg)
+{
+    fs_init();
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // configure REPL
+    //-------------------------------------------------------------------------------------------------------------------------
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = PROMPT_STRING "> ";
+    repl_config.max_cmdline_length = 256;
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // commands
+    //-------------------------------------------------------------------------------------------------------------------------
+    esp_console_register_help_command();
+    register_system_common();
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // register nvs after initializing it
+    //-------------------------------------------------------------------------------------------------------------------------
+    register_nvs();
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // initialize repl
+    // i expect you to be using JTAG, but ofc you can use UART if you'd like
+    //-------------------------------------------------------------------------------------------------------------------------
+    #if defined(CONFIG_ESP_CONSOLE_UART_DEFAULT) || defined(CONFIG_ESP_CONSOLE_UART_CUSTOM)
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
+
+    #elif defined(CONFIG_ESP_CONSOLE_USB_CDC)
+    esp_console_dev_usb_cdc_config_t hw_config = ESP_CONSOLE_DEV_CDC_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_usb_cdc(&hw_config, &repl_config, &repl));
+
+    #elif defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl));
+    ESP_ERROR_CHECK(esp_console_start_repl(repl));
+
+    #else
+    #error Unsupported console type
+    #endif
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // record and framed profiles start once the partition is mounted and the REPL has configured the console
+    //-------------------------------------------------------------------------------------------------------------------------
+    #if SOC_WIFI_SUPPORTED
+    if (autostart_deferred) {
+        sniffer_autostart(true);
+    }
+    #endif
+
+    //-------------------------------------------------------------------------------------------------------------------------
+    // the REPL has its own task
+    //-------------------------------------------------------------------------------------------------------------------------
+    vTaskDelete(NULL);
+}
+
 void app_main(void)
 {
     //-------------------------------------------------------------------------------------------------------------------------
-    // init NVS and fs if needed
+    // init NVS, the wifi driver and profiles need it. the FAT partition waits for the console task
     //-------------------------------------------------------------------------------------------------------------------------
     nvs_init();
-    #if CONFIG_STORE_HISTORY
-    fs_init();
-    #endif
 
     //-------------------------------------------------------------------------------------------------------------------------
     // this issue kind of saved my life: http://forum.esp32.com/viewtopic.php?t=39038
     // here you will see the 10 billion (boilerplate) tests I needed to do
+    //
+    // log levels come from menuconfig, warnings and errors only by default so boot isn't spent printing
     //-------------------------------------------------------------------------------------------------------------------------
-
-    esp_log_level_set("*", ESP_LOG_VERBOSE);
-
     // configs
     wifi_init_config_t wifi_cfg = WIFI_INIT_CONFIG_DEFAULT();
     wifi_country_t ctry_cfg = {.cc="US", .schan = 1, .nchan = 13};
@@ -207,50 +276,20 @@ void app_main(void)
     //-------------------------------------------------------------------------------------------------------------------------
     ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
 
-    //-------------------------------------------------------------------------------------------------------------------------
-    // configure REPL
-    //-------------------------------------------------------------------------------------------------------------------------
-    esp_console_repl_t *repl = NULL;
-    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
-    repl_config.prompt = PROMPT_STRING "> ";
-    repl_config.max_cmdline_length = 256;
-
-    //-------------------------------------------------------------------------------------------------------------------------
-    // commands
-    //-------------------------------------------------------------------------------------------------------------------------
-    esp_console_register_help_command();
-    register_system_common();
-
     //-------------------------------------------------------------------------------------------------------------------------
     // why do i need to do this to myself
     //-------------------------------------------------------------------------------------------------------------------------
     #if SOC_WIFI_SUPPORTED
     register_wifi();
-    #endif
-
-    //-------------------------------------------------------------------------------------------------------------------------
-    // register nvs after initializing it
-    //-------------------------------------------------------------------------------------------------------------------------
-    register_nvs();
 
     //-------------------------------------------------------------------------------------------------------------------------
-    // initialize repl
-    // i expect you to be using JTAG, but ofc you can use UART if you'd like
+    // a profile saved with profile save --autostart starts capturing now, before the console is up, unless it records
+    // to flash or sends framed batches
     //-------------------------------------------------------------------------------------------------------------------------
-    #if defined(CONFIG_ESP_CONSOLE_UART_DEFAULT) || defined(CONFIG_ESP_CONSOLE_UART_CUSTOM)
-    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_console_new_repl_uart(&hw_config, &repl_config, &repl));
-
-    #elif defined(CONFIG_ESP_CONSOLE_USB_CDC)
-    esp_console_dev_usb_cdc_config_t hw_config = ESP_CONSOLE_DEV_CDC_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_console_new_repl_usb_cdc(&hw_config, &repl_config, &repl));
-
-    #elif defined(CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG)
-    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl));
-    ESP_ERROR_CHECK(esp_console_start_repl(repl));
-
-    #else
-    #error Unsupported console type
+    autostart_deferred = sniffer_autostart(false) == ESP_ERR_INVALID_STATE;
     #endif
+
+    if (xTaskCreate(&console_task, "console", CONSOLE_TASK_STACK, NULL, CONSOLE_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create console task");
+    }
 }
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+#
+# esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+# Copyright (C) 2024 dj1ch
+#
+# Distributed under the MIT License. See `LICENSE` for more information.
+#
+# Expands a compact capture (start --format compact, or a .cmp recording) back into a
+# libpcap file with the same radiotap header the sniffer writes in pcap mode.
+# See components/cmd_wifi/cmd_wifi_compact.h for the format.
+#
+# usage: python3 tools/compact2pcap.py capture.cmp > capture.pcap
+#        python3 tools/serial_pcap.py /dev/ttyACM0 --compact | python3 tools/compact2pcap.py | wireshark -k -i -
+#
+
+import struct
+import sys
+
+COMPACT_MAGIC = b"ESPC"
+COMPACT_VERSION = 1
+DICT_ENTRIES = 1024
+MAC_LEN = 6
+
+LINKTYPE_IEEE802_11_RADIOTAP = 127
+RADIOTAP_MAX_LEN = 24
+
+# wifi_phy_rate_t to 500 kbps units, same table as cmd_wifi_pcap.c
+LEGACY_RATES = [2, 4, 11, 22, 0, 4, 11, 22, 96, 48, 24, 12, 108, 72, 36, 18]
+
+
+class Truncated(Exception):
+    pass
+
+
+class Reader:
+    def __init__(self, stream):
+        self.stream = stream
+        self.pushback = b""
+
+    def read(self, n):
+        data = self.pushback[:n]
+        self.pushback = self.pushback[n:]
+        if len(data) < n:
+            data += self.stream.read(n - len(data))
+        if len(data) != n:
+            raise Truncated()
+        return data
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            byte = self.read(1)[0]
+            value |= (byte & 0x7F) << shift
+            if byte < 0x80:
+                return value
+            shift += 7
+
+
+def addr_slots(frame, incl_len):
+    """Mirrors compact_addr_slots()."""
+    if incl_len < 2:
+        return []
+    ftype = (frame[0] >> 2) & 0x3
+    subtype = frame[0] >> 4
+    if ftype == 0:
+        slots = [4, 10, 16]
+    elif ftype == 1:
+        slots = [4] if subtype in (0xC, 0xD) else [4, 10]
+    elif ftype == 2:
+        slots = [4, 10, 16, 24] if (frame[1] & 0x3) == 0x3 else [4, 10, 16]
+    else:
+        slots = []
+    return [offset for offset in slots if offset + MAC_LEN <= incl_len]
+
+
+def radiotap(tsft, channel, rssi, noise, rate, fcs):
+    """Mirrors pcap_build_radiotap()."""
+    present = (1 << 0) | (1 << 1) | (1 << 3) | (1 << 5) | (1 << 6)
+    legacy = LEGACY_RATES[rate] if rate < len(LEGACY_RATES) else 0
+    if legacy:
+        present |= 1 << 2
+    freq = 2484 if channel == 14 else 2407 + 5 * channel
+    body = struct.pack("<QBBHHbb", tsft, 0x10 if fcs else 0, legacy, freq, 0x0080, rssi, noise)
+    return struct.pack("<BBHI", 0, 0, 8 + len(body), present) + body
+
+
+def write_pcap_header(out):
+    out.write(struct.pack("<IHHiIII", 0xA1B2C3D4, 2, 4, 0, 0, RADIOTAP_MAX_LEN + 2346, LINKTYPE_IEEE802_11_RADIOTAP))
+
+
+class Decoder:
+    """Decodes compact records, the dictionary and timestamp carry over between calls."""
+
+    def __init__(self):
+        self.reset()
+        self.timestamp = 0
+
+    def reset(self):
+        """Empties the dictionary and restarts timestamp deltas, as at the start of a file or batch."""
+        self.macs = []
+        self.base = None
+
+    def record(self, reader):
+        """Reads one record, returns (timestamp, channel, rssi, noise, rate, orig_len, frame)."""
+        delta = reader.varint()
+        # the first record after a reset carries an absolute 32 bit timestamp, keep the 64 bit timeline going
+        if self.base is None:
+            wrap = (delta - (self.timestamp & 0xFFFFFFFF)) & 0xFFFFFFFF
+            self.base = True
+            self.timestamp += wrap
+        else:
+            self.timestamp += delta
+        channel, rssi, noise, rate = struct.unpack("<BbbB", reader.read(4))
+        orig_len = reader.varint()
+        incl_len = reader.varint()
+
+        # everything before the first address is literal and carries the frame control field
+        frame = bytearray(reader.read(min(4, incl_len)))
+        for offset in addr_slots(frame, incl_len):
+            frame += reader.read(offset - len(frame))
+            code = reader.varint()
+            if code == 0:
+                mac = reader.read(MAC_LEN)
+                if len(self.macs) < DICT_ENTRIES:
+                    self.macs.append(mac)
+            else:
+                mac = self.macs[code - 1]
+            frame += mac
+        frame += reader.read(incl_len - len(frame))
+        return self.timestamp, channel, rssi, noise, rate, orig_len, bytes(frame)
+
+
+def write_pcap_record(out, timestamp, channel, rssi, noise, rate, orig_len, frame):
+    rt = radiotap(timestamp, channel, rssi, noise, rate, len(frame) == orig_len)
+    out.write(struct.pack("<IIII", timestamp // 1000000, timestamp % 1000000, len(rt) + len(frame), len(rt) + orig_len))
+    out.write(rt)
+    out.write(frame)
+
+
+def convert(src, out):
+    reader = Reader(src)
+    header = reader.read(8)
+    if header[:4] != COMPACT_MAGIC:
+        sys.stderr.write("not a compact capture\n")
+        return 1
+    if header[4] != COMPACT_VERSION:
+        sys.stderr.write("unsupported compact version %d\n" % header[4])
+        return 1
+
+    write_pcap_header(out)
+    decoder = Decoder()
+    frames = 0
+    while True:
+        try:
+            first = src.read(1)
+            if not first:
+                break
+            reader.pushback = first
+            write_pcap_record(out, *decoder.record(reader))
+            frames += 1
+        except Truncated:
+            sys.stderr.write("capture ends in a partial record\n")
+            break
+
+    out.flush()
+    sys.stderr.write("%d frame(s)\n" % frames)
+    return 0
+
+
+def main():
+    if len(sys.argv) > 2:
+        sys.stderr.write("usage: %s [capture.cmp] > capture.pcap\n" % sys.argv[0])
+        return 1
+    if len(sys.argv) == 2:
+        with open(sys.argv[1], "rb") as src:
+            return convert(src, sys.stdout.buffer)
+    return convert(sys.stdin.buffer, sys.stdout.buffer)
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+#
+# esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+# Copyright (C) 2024 dj1ch
+#
+# Distributed under the MIT License. See `LICENSE` for more information.
+#
+# Starts a framed capture (start --format framed) and decodes the batches into pcap on stdout.
+# Console text between batches, such as command replies and log lines, goes to stderr, and lines
+# typed on stdin are sent to the sniffer, so the REPL stays usable while capturing.
+# See components/cmd_wifi/cmd_wifi_batch.h for the framing. --attach decodes a framed capture that
+# is already running, such as a profile started at boot, without sending start. Every batch stands
+# on its own, so decoding picks up at the next batch.
+#
+# usage: python3 tools/serial_frames.py /dev/ttyACM0 [start args...] | wireshark -k -i -
+#        python3 tools/serial_frames.py /dev/ttyACM0 --attach | wireshark -k -i -
+#        python3 tools/serial_frames.py --file capture.bin > capture.pcap
+#
+
+import io
+import struct
+import sys
+import threading
+import zlib
+
+from compact2pcap import Decoder, Reader, Truncated, write_pcap_header, write_pcap_record
+
+SYNC = b"\xa5\x5a"
+VERSION = 1
+PAYLOAD_COMPACT = 1
+HEADER_LEN = 10
+TRAILER_LEN = 4
+MAX_PAYLOAD = 4096
+
+
+class Deframer:
+    """Splits a byte stream into batches and console text."""
+
+    def __init__(self, out, text):
+        self.buf = bytearray()
+        self.out = out
+        self.text = text
+        self.decoder = Decoder()
+        self.expected_seq = None
+        self.batches = 0
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                # keep a trailing sync byte that may be completed by the next read
+                keep = 1 if self.buf.endswith(SYNC[:1]) else 0
+                self.emit_text(self.buf[:len(self.buf) - keep])
+                del self.buf[:len(self.buf) - keep]
+                return
+            self.emit_text(self.buf[:start])
+            del self.buf[:start]
+
+            if len(self.buf) < HEADER_LEN:
+                return
+            version, ptype, seq, count, length = struct.unpack("<BBHHH", self.buf[2:HEADER_LEN])
+            if version != VERSION or ptype != PAYLOAD_COMPACT or length > MAX_PAYLOAD:
+                self.skip()
+                continue
+            total = HEADER_LEN + length + TRAILER_LEN
+            if len(self.buf) < total:
+                return
+            crc = struct.unpack("<I", self.buf[total - TRAILER_LEN:total])[0]
+            if zlib.crc32(bytes(self.buf[:total - TRAILER_LEN])) != crc:
+                self.bad += 1
+                self.skip()
+                continue
+
+            self.batch(seq, count, bytes(self.buf[HEADER_LEN:total - TRAILER_LEN]))
+            del self.buf[:total]
+
+    def skip(self):
+        """Not a batch after all, the sync bytes were console text."""
+        self.emit_text(self.buf[:1])
+        del self.buf[:1]
+
+    def emit_text(self, data):
+        if data:
+            self.text.write(data.decode(errors="replace"))
+            self.text.flush()
+
+    def batch(self, seq, count, payload):
+        if self.expected_seq is not None and seq != self.expected_seq:
+            self.lost += (seq - self.expected_seq) & 0xFFFF
+        self.expected_seq = (seq + 1) & 0xFFFF
+
+        self.decoder.reset()
+        reader = Reader(io.BytesIO(payload))
+        try:
+            for _ in range(count):
+                write_pcap_record(self.out, *self.decoder.record(reader))
+                self.frames += 1
+        except Truncated:
+            self.bad += 1
+        self.batches += 1
+        self.out.flush()
+
+    def summary(self):
+        return "%d batch(es), %d frame(s), %d bad, %d lost" % (self.batches, self.frames, self.bad, self.lost)
+
+
+def forward_stdin(port):
+    for line in sys.stdin:
+        port.write(line.rstrip("\r\n").encode() + b"\r\n")
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s <port> [start args...]\n" % sys.argv[0])
+        sys.stderr.write("       %s <port> --attach\n" % sys.argv[0])
+        sys.stderr.write("       %s --file <capture>\n" % sys.argv[0])
+        return 1
+
+    out = sys.stdout.buffer
+    write_pcap_header(out)
+    deframer = Deframer(out, sys.stderr)
+
+    if sys.argv[1] == "--file":
+        with open(sys.argv[2], "rb") as src:
+            deframer.feed(src.read())
+        sys.stderr.write("\n" + deframer.summary() + "\n")
+        return 0
+
+    import serial
+
+    port = serial.Serial(sys.argv[1], 115200, timeout=1)
+    if sys.argv[2:] != ["--attach"]:
+        command = " ".join(["start", "--format", "framed"] + sys.argv[2:])
+        port.write(command.encode() + b"\r\n")
+    threading.Thread(target=forward_stdin, args=(port,), daemon=True).start()
+
+    try:
+        while True:
+            chunk = port.read(port.in_waiting or 1)
+            if chunk:
+                deframer.feed(chunk)
+    finally:
+        sys.stderr.write("\n" + deframer.summary() + "\n")
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+#
+# esp32c6-sniffer: a proof of concept ESP32C6 sniffer
+# Copyright (C) 2024 dj1ch
+#
+# Distributed under the MIT License. See `LICENSE` for more information.
+#
+# Starts a pcap capture on the sniffer and forwards the stream to stdout, skipping the
+# command echo that precedes the pcap global header. A pcap stream can't be joined halfway as its
+# global header has already gone out, so a session that is still running (e.g. left behind by an
+# earlier run) is stopped first and its tail discarded.
+#
+# usage: python3 tools/serial_pcap.py /dev/ttyACM0 [start args...] | wireshark -k -i -
+#        python3 tools/serial_pcap.py /dev/ttyACM0 --dump cap00000.pcap > cap00000.pcap
+#        python3 tools/serial_pcap.py /dev/ttyACM0 --compact [start args...] | python3 tools/compact2pcap.py
+#
+
+import re
+import sys
+import time
+
+import serial
+
+PCAP_MAGIC = b"\xd4\xc3\xb2\xa1"
+COMPACT_MAGIC = b"ESPC"
+
+# longer than the sniffer waits for a text or stream session to close
+STOP_SETTLE_S = 1.0
+
+
+def dump(port, name):
+    """Pulls a recording off /data, the device prints its size before the raw bytes."""
+    port.write(("files --dump " + name).encode() + b"\r\n")
+
+    while True:
+        line = port.readline()
+        if not line:
+            sys.stderr.write("no response from device\n")
+            return 1
+        match = re.search(rb"Dumping \S+ \((\d+) bytes\)", line)
+        if match:
+            break
+        if b"Failed" in line or b"Invalid" in line or b"Stop the recording" in line:
+            sys.stderr.write(line.decode(errors="replace"))
+            return 1
+
+    remaining = int(match.group(1))
+    out = sys.stdout.buffer
+    while remaining > 0:
+        chunk = port.read(min(remaining, 4096))
+        if not chunk:
+            sys.stderr.write("timed out with %d bytes left\n" % remaining)
+            return 1
+        out.write(chunk)
+        remaining -= len(chunk)
+    out.flush()
+    return 0
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s <port> [start args...]\n" % sys.argv[0])
+        sys.stderr.write("       %s <port> --dump <name>\n" % sys.argv[0])
+        sys.stderr.write("       %s <port> --compact [start args...]\n" % sys.argv[0])
+        return 1
+
+    port = serial.Serial(sys.argv[1], 115200, timeout=1)
+    if len(sys.argv) == 4 and sys.argv[2] == "--dump":
+        return dump(port, sys.argv[3])
+
+    args = sys.argv[2:]
+    fmt, magic = "pcap", PCAP_MAGIC
+    if args and args[0] == "--compact":
+        fmt, magic = "compact", COMPACT_MAGIC
+        args = args[1:]
+
+    # "Sniffer is not running" when nothing was, either way the reply is dropped with the old stream
+    port.write(b"stop\r\n")
+    time.sleep(STOP_SETTLE_S)
+    port.reset_input_buffer()
+
+    command = " ".join(["start", "--format", fmt] + args)
+    port.write(command.encode() + b"\r\n")
+
+    # everything before the magic is the REPL echoing the command back
+    window = b""
+    while not window.endswith(magic):
+        window = (window + port.read(1))[-len(magic):]
+
+    out = sys.stdout.buffer
+    out.write(magic)
+    while True:
+        chunk = port.read(port.in_waiting or 1)
+        if chunk:
+            out.write(chunk)
+            out.flush()
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass